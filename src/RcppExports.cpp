@@ -350,6 +350,19 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// calc_kinship_bychr
+List calc_kinship_bychr(const List& probs, const bool bychr, const int n_threads);
+RcppExport SEXP _qtl2_calc_kinship_bychr(SEXP probsSEXP, SEXP bychrSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type bychr(bychrSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calc_kinship_bychr(probs, bychr, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // crosstype_supported
 bool crosstype_supported(const String& crosstype);
 RcppExport SEXP _qtl2_crosstype_supported(SEXP crosstypeSEXP) {
@@ -438,6 +451,125 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// compact_genoprob
+List compact_genoprob(const NumericVector& prob_array);
+RcppExport SEXP _qtl2_compact_genoprob(SEXP prob_arraySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type prob_array(prob_arraySEXP);
+    rcpp_result_gen = Rcpp::wrap(compact_genoprob(prob_array));
+    return rcpp_result_gen;
+END_RCPP
+}
+// expand_genoprob
+NumericVector expand_genoprob(const List& probs);
+RcppExport SEXP _qtl2_expand_genoprob(SEXP probsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    rcpp_result_gen = Rcpp::wrap(expand_genoprob(probs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// subset_compact_genoprob
+List subset_compact_genoprob(const List& probs, const IntegerVector& ind, const IntegerVector& gen, const IntegerVector& pos);
+RcppExport SEXP _qtl2_subset_compact_genoprob(SEXP probsSEXP, SEXP indSEXP, SEXP genSEXP, SEXP posSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type ind(indSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type gen(genSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type pos(posSEXP);
+    rcpp_result_gen = Rcpp::wrap(subset_compact_genoprob(probs, ind, gen, pos));
+    return rcpp_result_gen;
+END_RCPP
+}
+// compact_genoprob_colsums
+NumericVector compact_genoprob_colsums(const List& probs);
+RcppExport SEXP _qtl2_compact_genoprob_colsums(SEXP probsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    rcpp_result_gen = Rcpp::wrap(compact_genoprob_colsums(probs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// interp_compact_genoprob_onechr
+List interp_compact_genoprob_onechr(const List& probs, const NumericVector& map, const IntegerVector& pos_index);
+RcppExport SEXP _qtl2_interp_compact_genoprob_onechr(SEXP probsSEXP, SEXP mapSEXP, SEXP pos_indexSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type map(mapSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type pos_index(pos_indexSEXP);
+    rcpp_result_gen = Rcpp::wrap(interp_compact_genoprob_onechr(probs, map, pos_index));
+    return rcpp_result_gen;
+END_RCPP
+}
+// compact_genoprob_to_alleleprob
+List compact_genoprob_to_alleleprob(const String& crosstype, const List& probs, const bool is_x_chr);
+RcppExport SEXP _qtl2_compact_genoprob_to_alleleprob(SEXP crosstypeSEXP, SEXP probsSEXP, SEXP is_x_chrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const String& >::type crosstype(crosstypeSEXP);
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type is_x_chr(is_x_chrSEXP);
+    rcpp_result_gen = Rcpp::wrap(compact_genoprob_to_alleleprob(crosstype, probs, is_x_chr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// compact_genoprob_to_snpprob
+NumericVector compact_genoprob_to_snpprob(const List& probs, const IntegerVector& sdp, const IntegerVector& interval, const LogicalVector& on_map, const int prob_type);
+RcppExport SEXP _qtl2_compact_genoprob_to_snpprob(SEXP probsSEXP, SEXP sdpSEXP, SEXP intervalSEXP, SEXP on_mapSEXP, SEXP prob_typeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type sdp(sdpSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type interval(intervalSEXP);
+    Rcpp::traits::input_parameter< const LogicalVector& >::type on_map(on_mapSEXP);
+    Rcpp::traits::input_parameter< const int >::type prob_type(prob_typeSEXP);
+    rcpp_result_gen = Rcpp::wrap(compact_genoprob_to_snpprob(probs, sdp, interval, on_map, prob_type));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calc_kinship_compact_bychr
+List calc_kinship_compact_bychr(const List& probs, const String& crosstype, const LogicalVector& is_x_chr, const bool bychr, const int n_threads);
+RcppExport SEXP _qtl2_calc_kinship_compact_bychr(SEXP probsSEXP, SEXP crosstypeSEXP, SEXP is_x_chrSEXP, SEXP bychrSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const String& >::type crosstype(crosstypeSEXP);
+    Rcpp::traits::input_parameter< const LogicalVector& >::type is_x_chr(is_x_chrSEXP);
+    Rcpp::traits::input_parameter< const bool >::type bychr(bychrSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calc_kinship_compact_bychr(probs, crosstype, is_x_chr, bychr, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_hk_onechr_compact
+NumericMatrix scan_hk_onechr_compact(const List& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericVector& weights, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_onechr_compact(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP weightsSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_compact(genoprobs, pheno, addcovar, weights, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // compare_geno
 IntegerMatrix compare_geno(const IntegerMatrix& geno);
 RcppExport SEXP _qtl2_compare_geno(SEXP genoSEXP) {
@@ -870,8 +1002,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // calc_genoprob2
-NumericVector calc_genoprob2(const String& crosstype, const IntegerMatrix& genotypes, const IntegerMatrix& founder_geno, const bool is_X_chr, const bool is_female, const IntegerVector& cross_info, const NumericVector& rec_frac, const IntegerVector& marker_index, const double error_prob);
-RcppExport SEXP _qtl2_calc_genoprob2(SEXP crosstypeSEXP, SEXP genotypesSEXP, SEXP founder_genoSEXP, SEXP is_X_chrSEXP, SEXP is_femaleSEXP, SEXP cross_infoSEXP, SEXP rec_fracSEXP, SEXP marker_indexSEXP, SEXP error_probSEXP) {
+NumericVector calc_genoprob2(const String& crosstype, const IntegerMatrix& genotypes, const IntegerMatrix& founder_geno, const bool is_X_chr, const bool is_female, const IntegerVector& cross_info, const NumericVector& rec_frac, const IntegerVector& marker_index, const double error_prob, const bool scaled_hmm, const int n_threads);
+RcppExport SEXP _qtl2_calc_genoprob2(SEXP crosstypeSEXP, SEXP genotypesSEXP, SEXP founder_genoSEXP, SEXP is_X_chrSEXP, SEXP is_femaleSEXP, SEXP cross_infoSEXP, SEXP rec_fracSEXP, SEXP marker_indexSEXP, SEXP error_probSEXP, SEXP scaled_hmmSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -884,7 +1016,9 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const NumericVector& >::type rec_frac(rec_fracSEXP);
     Rcpp::traits::input_parameter< const IntegerVector& >::type marker_index(marker_indexSEXP);
     Rcpp::traits::input_parameter< const double >::type error_prob(error_probSEXP);
-    rcpp_result_gen = Rcpp::wrap(calc_genoprob2(crosstype, genotypes, founder_geno, is_X_chr, is_female, cross_info, rec_frac, marker_index, error_prob));
+    Rcpp::traits::input_parameter< const bool >::type scaled_hmm(scaled_hmmSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calc_genoprob2(crosstype, genotypes, founder_geno, is_X_chr, is_female, cross_info, rec_frac, marker_index, error_prob, scaled_hmm, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -910,8 +1044,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // est_map2
-NumericVector est_map2(const String& crosstype, const IntegerMatrix& genotypes, const IntegerMatrix& founder_geno, const bool is_X_chr, const LogicalVector& is_female, const IntegerMatrix& cross_info, const IntegerVector& cross_group, const IntegerVector& unique_cross_group, const NumericVector& rec_frac, const double error_prob, const int max_iterations, const double tol, const bool verbose);
-RcppExport SEXP _qtl2_est_map2(SEXP crosstypeSEXP, SEXP genotypesSEXP, SEXP founder_genoSEXP, SEXP is_X_chrSEXP, SEXP is_femaleSEXP, SEXP cross_infoSEXP, SEXP cross_groupSEXP, SEXP unique_cross_groupSEXP, SEXP rec_fracSEXP, SEXP error_probSEXP, SEXP max_iterationsSEXP, SEXP tolSEXP, SEXP verboseSEXP) {
+NumericVector est_map2(const String& crosstype, const IntegerMatrix& genotypes, const IntegerMatrix& founder_geno, const bool is_X_chr, const LogicalVector& is_female, const IntegerMatrix& cross_info, const IntegerVector& cross_group, const IntegerVector& unique_cross_group, const NumericVector& rec_frac, const double error_prob, const int max_iterations, const double tol, const bool verbose, const bool scaled_hmm, const bool accel_em, const int n_threads);
+RcppExport SEXP _qtl2_est_map2(SEXP crosstypeSEXP, SEXP genotypesSEXP, SEXP founder_genoSEXP, SEXP is_X_chrSEXP, SEXP is_femaleSEXP, SEXP cross_infoSEXP, SEXP cross_groupSEXP, SEXP unique_cross_groupSEXP, SEXP rec_fracSEXP, SEXP error_probSEXP, SEXP max_iterationsSEXP, SEXP tolSEXP, SEXP verboseSEXP, SEXP scaled_hmmSEXP, SEXP accel_emSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -928,7 +1062,10 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const int >::type max_iterations(max_iterationsSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
     Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
-    rcpp_result_gen = Rcpp::wrap(est_map2(crosstype, genotypes, founder_geno, is_X_chr, is_female, cross_info, cross_group, unique_cross_group, rec_frac, error_prob, max_iterations, tol, verbose));
+    Rcpp::traits::input_parameter< const bool >::type scaled_hmm(scaled_hmmSEXP);
+    Rcpp::traits::input_parameter< const bool >::type accel_em(accel_emSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(est_map2(crosstype, genotypes, founder_geno, is_X_chr, is_female, cross_info, cross_group, unique_cross_group, rec_frac, error_prob, max_iterations, tol, verbose, scaled_hmm, accel_em, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1034,6 +1171,21 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// index_snps_bychr
+IntegerVector index_snps_bychr(const IntegerVector& chr_start, const IntegerVector& interval, const LogicalVector& on_map, const IntegerVector& sdp, const int n_threads);
+RcppExport SEXP _qtl2_index_snps_bychr(SEXP chr_startSEXP, SEXP intervalSEXP, SEXP on_mapSEXP, SEXP sdpSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const IntegerVector& >::type chr_start(chr_startSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type interval(intervalSEXP);
+    Rcpp::traits::input_parameter< const LogicalVector& >::type on_map(on_mapSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type sdp(sdpSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(index_snps_bychr(chr_start, interval, on_map, sdp, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // interp_genoprob_onechr
 NumericVector interp_genoprob_onechr(const NumericVector& genoprob, const NumericVector& map, const IntegerVector& pos_index);
 RcppExport SEXP _qtl2_interp_genoprob_onechr(SEXP genoprobSEXP, SEXP mapSEXP, SEXP pos_indexSEXP) {
@@ -1138,6 +1290,20 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// calc_rss_linreg_3d
+NumericMatrix calc_rss_linreg_3d(const NumericVector& P, const NumericMatrix& Y, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_calc_rss_linreg_3d(SEXP PSEXP, SEXP YSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type P(PSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calc_rss_linreg_3d(P, Y, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // fit_linreg
 List fit_linreg(const NumericMatrix& X, const NumericVector& y, const bool se, const bool var, const double tol);
 RcppExport SEXP _qtl2_fit_linreg(SEXP XSEXP, SEXP ySEXP, SEXP seSEXP, SEXP varSEXP, SEXP tolSEXP) {
@@ -1332,6 +1498,20 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// calc_mvrss_eigenqr_3d
+NumericMatrix calc_mvrss_eigenqr_3d(const NumericVector& X, const NumericMatrix& Y, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_calc_mvrss_eigenqr_3d(SEXP XSEXP, SEXP YSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calc_mvrss_eigenqr_3d(X, Y, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // Rcpp_eigen_decomp
 List Rcpp_eigen_decomp(const NumericMatrix& A);
 RcppExport SEXP _qtl2_Rcpp_eigen_decomp(SEXP ASEXP) {
@@ -1343,6 +1523,20 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// Rcpp_eigen_decomp_randomized
+List Rcpp_eigen_decomp_randomized(const NumericMatrix& A, const int rank, const int oversample, const int n_power);
+RcppExport SEXP _qtl2_Rcpp_eigen_decomp_randomized(SEXP ASEXP, SEXP rankSEXP, SEXP oversampleSEXP, SEXP n_powerSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const int >::type rank(rankSEXP);
+    Rcpp::traits::input_parameter< const int >::type oversample(oversampleSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_power(n_powerSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_eigen_decomp_randomized(A, rank, oversample, n_power));
+    return rcpp_result_gen;
+END_RCPP
+}
 // Rcpp_eigen_rotation
 List Rcpp_eigen_rotation(const NumericMatrix& K, const NumericMatrix& y, const NumericMatrix& X);
 RcppExport SEXP _qtl2_Rcpp_eigen_rotation(SEXP KSEXP, SEXP ySEXP, SEXP XSEXP) {
@@ -1417,8 +1611,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // Rcpp_fitLMM_mat
-List Rcpp_fitLMM_mat(const NumericVector& Kva, const NumericMatrix& Y, const NumericMatrix& X, const bool reml, const bool check_boundary, const double logdetXpX, const double tol);
-RcppExport SEXP _qtl2_Rcpp_fitLMM_mat(SEXP KvaSEXP, SEXP YSEXP, SEXP XSEXP, SEXP remlSEXP, SEXP check_boundarySEXP, SEXP logdetXpXSEXP, SEXP tolSEXP) {
+List Rcpp_fitLMM_mat(const NumericVector& Kva, const NumericMatrix& Y, const NumericMatrix& X, const bool reml, const bool check_boundary, const double logdetXpX, const double tol, const int n_grid, const int n_threads);
+RcppExport SEXP _qtl2_Rcpp_fitLMM_mat(SEXP KvaSEXP, SEXP YSEXP, SEXP XSEXP, SEXP remlSEXP, SEXP check_boundarySEXP, SEXP logdetXpXSEXP, SEXP tolSEXP, SEXP n_gridSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1429,7 +1623,9 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const bool >::type check_boundary(check_boundarySEXP);
     Rcpp::traits::input_parameter< const double >::type logdetXpX(logdetXpXSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_fitLMM_mat(Kva, Y, X, reml, check_boundary, logdetXpX, tol));
+    Rcpp::traits::input_parameter< const int >::type n_grid(n_gridSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_fitLMM_mat(Kva, Y, X, reml, check_boundary, logdetXpX, tol, n_grid, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1699,8 +1895,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // scan_binary_onechr
-NumericMatrix scan_binary_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const int maxit, const double tol, const double qr_tol, const double eta_max);
-RcppExport SEXP _qtl2_scan_binary_onechr(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP maxitSEXP, SEXP tolSEXP, SEXP qr_tolSEXP, SEXP eta_maxSEXP) {
+NumericMatrix scan_binary_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const int maxit, const double tol, const double qr_tol, const double eta_max, const bool warm_start, const double prescreen_lod, const int n_threads);
+RcppExport SEXP _qtl2_scan_binary_onechr(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP maxitSEXP, SEXP tolSEXP, SEXP qr_tolSEXP, SEXP eta_maxSEXP, SEXP warm_startSEXP, SEXP prescreen_lodSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1711,13 +1907,16 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
     Rcpp::traits::input_parameter< const double >::type qr_tol(qr_tolSEXP);
     Rcpp::traits::input_parameter< const double >::type eta_max(eta_maxSEXP);
-    rcpp_result_gen = Rcpp::wrap(scan_binary_onechr(genoprobs, pheno, addcovar, maxit, tol, qr_tol, eta_max));
+    Rcpp::traits::input_parameter< const bool >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< const double >::type prescreen_lod(prescreen_lodSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_binary_onechr(genoprobs, pheno, addcovar, maxit, tol, qr_tol, eta_max, warm_start, prescreen_lod, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // scan_binary_onechr_weighted
-NumericMatrix scan_binary_onechr_weighted(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericVector& weights, const int maxit, const double tol, const double qr_tol, const double eta_max);
-RcppExport SEXP _qtl2_scan_binary_onechr_weighted(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP weightsSEXP, SEXP maxitSEXP, SEXP tolSEXP, SEXP qr_tolSEXP, SEXP eta_maxSEXP) {
+NumericMatrix scan_binary_onechr_weighted(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericVector& weights, const int maxit, const double tol, const double qr_tol, const double eta_max, const bool warm_start, const double prescreen_lod, const int n_threads);
+RcppExport SEXP _qtl2_scan_binary_onechr_weighted(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP weightsSEXP, SEXP maxitSEXP, SEXP tolSEXP, SEXP qr_tolSEXP, SEXP eta_maxSEXP, SEXP warm_startSEXP, SEXP prescreen_lodSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1729,7 +1928,10 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
     Rcpp::traits::input_parameter< const double >::type qr_tol(qr_tolSEXP);
     Rcpp::traits::input_parameter< const double >::type eta_max(eta_maxSEXP);
-    rcpp_result_gen = Rcpp::wrap(scan_binary_onechr_weighted(genoprobs, pheno, addcovar, weights, maxit, tol, qr_tol, eta_max));
+    Rcpp::traits::input_parameter< const bool >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< const double >::type prescreen_lod(prescreen_lodSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_binary_onechr_weighted(genoprobs, pheno, addcovar, weights, maxit, tol, qr_tol, eta_max, warm_start, prescreen_lod, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1806,21 +2008,22 @@ BEGIN_RCPP
 END_RCPP
 }
 // scan_hk_onechr_nocovar
-NumericMatrix scan_hk_onechr_nocovar(const NumericVector& genoprobs, const NumericMatrix& pheno, const double tol);
-RcppExport SEXP _qtl2_scan_hk_onechr_nocovar(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP tolSEXP) {
+NumericMatrix scan_hk_onechr_nocovar(const NumericVector& genoprobs, const NumericMatrix& pheno, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_onechr_nocovar(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
     Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_nocovar(genoprobs, pheno, tol));
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_nocovar(genoprobs, pheno, tol, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // scan_hk_onechr
-NumericMatrix scan_hk_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const double tol);
-RcppExport SEXP _qtl2_scan_hk_onechr(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP tolSEXP) {
+NumericMatrix scan_hk_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_onechr(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1828,13 +2031,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
     Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr(genoprobs, pheno, addcovar, tol));
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr(genoprobs, pheno, addcovar, tol, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // scan_hk_onechr_weighted
-NumericMatrix scan_hk_onechr_weighted(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericVector& weights, const double tol);
-RcppExport SEXP _qtl2_scan_hk_onechr_weighted(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP weightsSEXP, SEXP tolSEXP) {
+NumericMatrix scan_hk_onechr_weighted(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericVector& weights, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_onechr_weighted(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP weightsSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1843,7 +2047,23 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
     Rcpp::traits::input_parameter< const NumericVector& >::type weights(weightsSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_weighted(genoprobs, pheno, addcovar, weights, tol));
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_weighted(genoprobs, pheno, addcovar, weights, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_hk_onechr_perm
+NumericMatrix scan_hk_onechr_perm(const NumericVector& genoprobs, const NumericMatrix& pheno, const IntegerMatrix& perms, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_onechr_perm(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP permsSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const IntegerMatrix& >::type perms(permsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_perm(genoprobs, pheno, perms, tol, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1909,9 +2129,39 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// rotate_genoprobs
+NumericVector rotate_genoprobs(const NumericVector& genoprobs, const NumericMatrix& eigenvec, const int n_threads);
+RcppExport SEXP _qtl2_rotate_genoprobs(SEXP genoprobsSEXP, SEXP eigenvecSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type eigenvec(eigenvecSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(rotate_genoprobs(genoprobs, eigenvec, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_pg_onechr_rotated
+NumericMatrix scan_pg_onechr_rotated(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericMatrix& eigenvec, const NumericMatrix& weights, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_pg_onechr_rotated(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP eigenvecSEXP, SEXP weightsSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type eigenvec(eigenvecSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_pg_onechr_rotated(genoprobs, pheno, addcovar, eigenvec, weights, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // scan_pg_onechr
-NumericVector scan_pg_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericMatrix& eigenvec, const NumericVector& weights, const double tol);
-RcppExport SEXP _qtl2_scan_pg_onechr(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP eigenvecSEXP, SEXP weightsSEXP, SEXP tolSEXP) {
+NumericVector scan_pg_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericMatrix& eigenvec, const NumericVector& weights, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_pg_onechr(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP eigenvecSEXP, SEXP weightsSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1921,7 +2171,28 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const NumericMatrix& >::type eigenvec(eigenvecSEXP);
     Rcpp::traits::input_parameter< const NumericVector& >::type weights(weightsSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(scan_pg_onechr(genoprobs, pheno, addcovar, eigenvec, weights, tol));
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_pg_onechr(genoprobs, pheno, addcovar, eigenvec, weights, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_pg_onechr_hsq
+List scan_pg_onechr_hsq(const NumericVector& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericMatrix& eigenvec, const NumericVector& eigenval, const NumericVector& hsq, const bool reml, const bool check_boundary, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_pg_onechr_hsq(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP eigenvecSEXP, SEXP eigenvalSEXP, SEXP hsqSEXP, SEXP remlSEXP, SEXP check_boundarySEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type eigenvec(eigenvecSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type eigenval(eigenvalSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type hsq(hsqSEXP);
+    Rcpp::traits::input_parameter< const bool >::type reml(remlSEXP);
+    Rcpp::traits::input_parameter< const bool >::type check_boundary(check_boundarySEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_pg_onechr_hsq(genoprobs, pheno, addcovar, eigenvec, eigenval, hsq, reml, check_boundary, tol, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1960,8 +2231,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // scanblup
-List scanblup(const NumericVector& genoprobs, const NumericVector& pheno, const NumericMatrix& addcovar, const bool se, const bool reml, const double tol);
-RcppExport SEXP _qtl2_scanblup(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP seSEXP, SEXP remlSEXP, SEXP tolSEXP) {
+List scanblup(const NumericVector& genoprobs, const NumericVector& pheno, const NumericMatrix& addcovar, const bool se, const bool reml, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scanblup(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP seSEXP, SEXP remlSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -1971,7 +2242,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const bool >::type se(seSEXP);
     Rcpp::traits::input_parameter< const bool >::type reml(remlSEXP);
     Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(scanblup(genoprobs, pheno, addcovar, se, reml, tol));
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scanblup(genoprobs, pheno, addcovar, se, reml, tol, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -2177,6 +2449,67 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// prep_hk_onechr
+List prep_hk_onechr(const NumericVector& genoprobs, const NumericMatrix& addcovar, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_prep_hk_onechr(SEXP genoprobsSEXP, SEXP addcovarSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(prep_hk_onechr(genoprobs, addcovar, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_hk_prepped
+NumericMatrix scan_hk_prepped(const NumericVector& Q, const NumericMatrix& pheno, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_prepped(SEXP QSEXP, SEXP phenoSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type Q(QSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_prepped(Q, pheno, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scancoef_hk_prepped
+List scancoef_hk_prepped(const NumericVector& Q, const NumericVector& R, const IntegerMatrix& pivot, const IntegerVector& rank, const NumericVector& pheno, const bool se);
+RcppExport SEXP _qtl2_scancoef_hk_prepped(SEXP QSEXP, SEXP RSEXP, SEXP pivotSEXP, SEXP rankSEXP, SEXP phenoSEXP, SEXP seSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type Q(QSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type R(RSEXP);
+    Rcpp::traits::input_parameter< const IntegerMatrix& >::type pivot(pivotSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type rank(rankSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const bool >::type se(seSEXP);
+    rcpp_result_gen = Rcpp::wrap(scancoef_hk_prepped(Q, R, pivot, rank, pheno, se));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_hk_snps
+NumericMatrix scan_hk_snps(const NumericVector& genoprobs, const NumericMatrix& pheno, const IntegerVector& sdp, const IntegerVector& interval, const LogicalVector& on_map, const int prob_type, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_snps(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP sdpSEXP, SEXP intervalSEXP, SEXP on_mapSEXP, SEXP prob_typeSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type sdp(sdpSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type interval(intervalSEXP);
+    Rcpp::traits::input_parameter< const LogicalVector& >::type on_map(on_mapSEXP);
+    Rcpp::traits::input_parameter< const int >::type prob_type(prob_typeSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_snps(genoprobs, pheno, sdp, interval, on_map, prob_type, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // calc_sdp
 IntegerVector calc_sdp(const IntegerMatrix& geno);
 RcppExport SEXP _qtl2_calc_sdp(SEXP genoSEXP) {
@@ -2266,6 +2599,87 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// sparsify_genoprob
+List sparsify_genoprob(const NumericVector& prob_array, double value_threshold, double column_threshold);
+RcppExport SEXP _qtl2_sparsify_genoprob(SEXP prob_arraySEXP, SEXP value_thresholdSEXP, SEXP column_thresholdSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const NumericVector& >::type prob_array(prob_arraySEXP);
+    Rcpp::traits::input_parameter< double >::type value_threshold(value_thresholdSEXP);
+    Rcpp::traits::input_parameter< double >::type column_threshold(column_thresholdSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparsify_genoprob(prob_array, value_threshold, column_threshold));
+    return rcpp_result_gen;
+END_RCPP
+}
+// densify_genoprob
+NumericVector densify_genoprob(const List& probs);
+RcppExport SEXP _qtl2_densify_genoprob(SEXP probsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    rcpp_result_gen = Rcpp::wrap(densify_genoprob(probs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sparse_genoprob_to_alleleprob
+List sparse_genoprob_to_alleleprob(const String& crosstype, const List& probs, const bool is_x_chr);
+RcppExport SEXP _qtl2_sparse_genoprob_to_alleleprob(SEXP crosstypeSEXP, SEXP probsSEXP, SEXP is_x_chrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const String& >::type crosstype(crosstypeSEXP);
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type is_x_chr(is_x_chrSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparse_genoprob_to_alleleprob(crosstype, probs, is_x_chr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sparse_genoprob_to_snpprob
+NumericVector sparse_genoprob_to_snpprob(const List& probs, const IntegerVector& sdp, const IntegerVector& interval, const LogicalVector& on_map, const int prob_type);
+RcppExport SEXP _qtl2_sparse_genoprob_to_snpprob(SEXP probsSEXP, SEXP sdpSEXP, SEXP intervalSEXP, SEXP on_mapSEXP, SEXP prob_typeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type sdp(sdpSEXP);
+    Rcpp::traits::input_parameter< const IntegerVector& >::type interval(intervalSEXP);
+    Rcpp::traits::input_parameter< const LogicalVector& >::type on_map(on_mapSEXP);
+    Rcpp::traits::input_parameter< const int >::type prob_type(prob_typeSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparse_genoprob_to_snpprob(probs, sdp, interval, on_map, prob_type));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calc_kinship_sparse_bychr
+List calc_kinship_sparse_bychr(const List& probs, const bool bychr, const int n_threads);
+RcppExport SEXP _qtl2_calc_kinship_sparse_bychr(SEXP probsSEXP, SEXP bychrSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type bychr(bychrSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calc_kinship_sparse_bychr(probs, bychr, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_hk_onechr_sparse
+NumericMatrix scan_hk_onechr_sparse(const List& genoprobs, const NumericMatrix& pheno, const NumericMatrix& addcovar, const NumericVector& weights, const double tol, const int n_threads);
+RcppExport SEXP _qtl2_scan_hk_onechr_sparse(SEXP genoprobsSEXP, SEXP phenoSEXP, SEXP addcovarSEXP, SEXP weightsSEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type genoprobs(genoprobsSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type pheno(phenoSEXP);
+    Rcpp::traits::input_parameter< const NumericMatrix& >::type addcovar(addcovarSEXP);
+    Rcpp::traits::input_parameter< const NumericVector& >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_hk_onechr_sparse(genoprobs, pheno, addcovar, weights, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // test_init
 double test_init(const String& crosstype, const int true_gen, const bool is_x_chr, const bool is_female, const IntegerVector& cross_info);
 RcppExport SEXP _qtl2_test_init(SEXP crosstypeSEXP, SEXP true_genSEXP, SEXP is_x_chrSEXP, SEXP is_femaleSEXP, SEXP cross_infoSEXP) {
@@ -2456,6 +2870,17 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// test_generic_kernels
+bool test_generic_kernels(const bool use_generic);
+RcppExport SEXP _qtl2_test_generic_kernels(SEXP use_genericSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const bool >::type use_generic(use_genericSEXP);
+    rcpp_result_gen = Rcpp::wrap(test_generic_kernels(use_generic));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_arrange_genes", (DL_FUNC) &_qtl2_arrange_genes, 2},
@@ -2479,6 +2904,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_calc_coefSE_binreg_weighted_eigenqr", (DL_FUNC) &_qtl2_calc_coefSE_binreg_weighted_eigenqr, 7},
     {"_qtl2_fit_binreg_weighted_eigenqr", (DL_FUNC) &_qtl2_fit_binreg_weighted_eigenqr, 9},
     {"_qtl2_calc_kinship", (DL_FUNC) &_qtl2_calc_kinship, 1},
+    {"_qtl2_calc_kinship_bychr", (DL_FUNC) &_qtl2_calc_kinship_bychr, 3},
     {"_qtl2_crosstype_supported", (DL_FUNC) &_qtl2_crosstype_supported, 1},
     {"_qtl2_count_invalid_genotypes", (DL_FUNC) &_qtl2_count_invalid_genotypes, 5},
     {"_qtl2_check_crossinfo", (DL_FUNC) &_qtl2_check_crossinfo, 3},
@@ -2486,6 +2912,15 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_check_handle_x_chr", (DL_FUNC) &_qtl2_check_handle_x_chr, 2},
     {"_qtl2_chisq_colpairs", (DL_FUNC) &_qtl2_chisq_colpairs, 1},
     {"_qtl2_clean_genoprob", (DL_FUNC) &_qtl2_clean_genoprob, 3},
+    {"_qtl2_compact_genoprob", (DL_FUNC) &_qtl2_compact_genoprob, 1},
+    {"_qtl2_expand_genoprob", (DL_FUNC) &_qtl2_expand_genoprob, 1},
+    {"_qtl2_subset_compact_genoprob", (DL_FUNC) &_qtl2_subset_compact_genoprob, 4},
+    {"_qtl2_compact_genoprob_colsums", (DL_FUNC) &_qtl2_compact_genoprob_colsums, 1},
+    {"_qtl2_interp_compact_genoprob_onechr", (DL_FUNC) &_qtl2_interp_compact_genoprob_onechr, 3},
+    {"_qtl2_compact_genoprob_to_alleleprob", (DL_FUNC) &_qtl2_compact_genoprob_to_alleleprob, 3},
+    {"_qtl2_compact_genoprob_to_snpprob", (DL_FUNC) &_qtl2_compact_genoprob_to_snpprob, 5},
+    {"_qtl2_calc_kinship_compact_bychr", (DL_FUNC) &_qtl2_calc_kinship_compact_bychr, 5},
+    {"_qtl2_scan_hk_onechr_compact", (DL_FUNC) &_qtl2_scan_hk_onechr_compact, 6},
     {"_qtl2_compare_geno", (DL_FUNC) &_qtl2_compare_geno, 1},
     {"_qtl2_count_xo", (DL_FUNC) &_qtl2_count_xo, 3},
     {"_qtl2_count_xo_3d", (DL_FUNC) &_qtl2_count_xo_3d, 3},
@@ -2516,15 +2951,16 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_guess_phase_X", (DL_FUNC) &_qtl2_guess_phase_X, 4},
     {"_qtl2_calc_errorlod", (DL_FUNC) &_qtl2_calc_errorlod, 7},
     {"_qtl2_calc_genoprob", (DL_FUNC) &_qtl2_calc_genoprob, 9},
-    {"_qtl2_calc_genoprob2", (DL_FUNC) &_qtl2_calc_genoprob2, 9},
+    {"_qtl2_calc_genoprob2", (DL_FUNC) &_qtl2_calc_genoprob2, 11},
     {"_qtl2_est_map", (DL_FUNC) &_qtl2_est_map, 11},
-    {"_qtl2_est_map2", (DL_FUNC) &_qtl2_est_map2, 13},
+    {"_qtl2_est_map2", (DL_FUNC) &_qtl2_est_map2, 16},
     {"_qtl2_sim_geno", (DL_FUNC) &_qtl2_sim_geno, 10},
     {"_qtl2_sim_geno2", (DL_FUNC) &_qtl2_sim_geno2, 10},
     {"_qtl2_addlog", (DL_FUNC) &_qtl2_addlog, 2},
     {"_qtl2_subtractlog", (DL_FUNC) &_qtl2_subtractlog, 2},
     {"_qtl2_viterbi", (DL_FUNC) &_qtl2_viterbi, 9},
     {"_qtl2_viterbi2", (DL_FUNC) &_qtl2_viterbi2, 9},
+    {"_qtl2_index_snps_bychr", (DL_FUNC) &_qtl2_index_snps_bychr, 5},
     {"_qtl2_interp_genoprob_onechr", (DL_FUNC) &_qtl2_interp_genoprob_onechr, 3},
     {"_qtl2_interpolate_map", (DL_FUNC) &_qtl2_interpolate_map, 3},
     {"_qtl2_find_intervals", (DL_FUNC) &_qtl2_find_intervals, 3},
@@ -2533,6 +2969,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_calc_coefSE_linreg", (DL_FUNC) &_qtl2_calc_coefSE_linreg, 3},
     {"_qtl2_calc_resid_linreg", (DL_FUNC) &_qtl2_calc_resid_linreg, 3},
     {"_qtl2_calc_resid_linreg_3d", (DL_FUNC) &_qtl2_calc_resid_linreg_3d, 3},
+    {"_qtl2_calc_rss_linreg_3d", (DL_FUNC) &_qtl2_calc_rss_linreg_3d, 4},
     {"_qtl2_fit_linreg", (DL_FUNC) &_qtl2_fit_linreg, 5},
     {"_qtl2_fit_linreg_eigenchol", (DL_FUNC) &_qtl2_fit_linreg_eigenchol, 4},
     {"_qtl2_calc_coef_linreg_eigenchol", (DL_FUNC) &_qtl2_calc_coef_linreg_eigenchol, 2},
@@ -2548,13 +2985,15 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_calc_mvrss_eigenqr", (DL_FUNC) &_qtl2_calc_mvrss_eigenqr, 3},
     {"_qtl2_calc_resid_eigenchol", (DL_FUNC) &_qtl2_calc_resid_eigenchol, 2},
     {"_qtl2_calc_resid_eigenqr", (DL_FUNC) &_qtl2_calc_resid_eigenqr, 3},
+    {"_qtl2_calc_mvrss_eigenqr_3d", (DL_FUNC) &_qtl2_calc_mvrss_eigenqr_3d, 4},
     {"_qtl2_Rcpp_eigen_decomp", (DL_FUNC) &_qtl2_Rcpp_eigen_decomp, 1},
+    {"_qtl2_Rcpp_eigen_decomp_randomized", (DL_FUNC) &_qtl2_Rcpp_eigen_decomp_randomized, 4},
     {"_qtl2_Rcpp_eigen_rotation", (DL_FUNC) &_qtl2_Rcpp_eigen_rotation, 3},
     {"_qtl2_Rcpp_calc_logdetXpX", (DL_FUNC) &_qtl2_Rcpp_calc_logdetXpX, 1},
     {"_qtl2_Rcpp_calcLL", (DL_FUNC) &_qtl2_Rcpp_calcLL, 6},
     {"_qtl2_Rcpp_calcLL_mat", (DL_FUNC) &_qtl2_Rcpp_calcLL_mat, 6},
     {"_qtl2_Rcpp_fitLMM", (DL_FUNC) &_qtl2_Rcpp_fitLMM, 7},
-    {"_qtl2_Rcpp_fitLMM_mat", (DL_FUNC) &_qtl2_Rcpp_fitLMM_mat, 7},
+    {"_qtl2_Rcpp_fitLMM_mat", (DL_FUNC) &_qtl2_Rcpp_fitLMM_mat, 9},
     {"_qtl2_locate_xo", (DL_FUNC) &_qtl2_locate_xo, 4},
     {"_qtl2_R_lod_int_plain", (DL_FUNC) &_qtl2_R_lod_int_plain, 2},
     {"_qtl2_find_matching_cols", (DL_FUNC) &_qtl2_find_matching_cols, 2},
@@ -2576,23 +3015,27 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_permute_ivector_stratified", (DL_FUNC) &_qtl2_permute_ivector_stratified, 4},
     {"_qtl2_reduce_markers", (DL_FUNC) &_qtl2_reduce_markers, 3},
     {"_qtl2_running_count", (DL_FUNC) &_qtl2_running_count, 3},
-    {"_qtl2_scan_binary_onechr", (DL_FUNC) &_qtl2_scan_binary_onechr, 7},
-    {"_qtl2_scan_binary_onechr_weighted", (DL_FUNC) &_qtl2_scan_binary_onechr_weighted, 8},
+    {"_qtl2_scan_binary_onechr", (DL_FUNC) &_qtl2_scan_binary_onechr, 10},
+    {"_qtl2_scan_binary_onechr_weighted", (DL_FUNC) &_qtl2_scan_binary_onechr_weighted, 11},
     {"_qtl2_scan_binary_onechr_intcovar_highmem", (DL_FUNC) &_qtl2_scan_binary_onechr_intcovar_highmem, 7},
     {"_qtl2_scan_binary_onechr_intcovar_weighted_highmem", (DL_FUNC) &_qtl2_scan_binary_onechr_intcovar_weighted_highmem, 8},
     {"_qtl2_scan_binary_onechr_intcovar_lowmem", (DL_FUNC) &_qtl2_scan_binary_onechr_intcovar_lowmem, 8},
     {"_qtl2_scan_binary_onechr_intcovar_weighted_lowmem", (DL_FUNC) &_qtl2_scan_binary_onechr_intcovar_weighted_lowmem, 9},
-    {"_qtl2_scan_hk_onechr_nocovar", (DL_FUNC) &_qtl2_scan_hk_onechr_nocovar, 3},
-    {"_qtl2_scan_hk_onechr", (DL_FUNC) &_qtl2_scan_hk_onechr, 4},
-    {"_qtl2_scan_hk_onechr_weighted", (DL_FUNC) &_qtl2_scan_hk_onechr_weighted, 5},
+    {"_qtl2_scan_hk_onechr_nocovar", (DL_FUNC) &_qtl2_scan_hk_onechr_nocovar, 4},
+    {"_qtl2_scan_hk_onechr", (DL_FUNC) &_qtl2_scan_hk_onechr, 5},
+    {"_qtl2_scan_hk_onechr_weighted", (DL_FUNC) &_qtl2_scan_hk_onechr_weighted, 6},
+    {"_qtl2_scan_hk_onechr_perm", (DL_FUNC) &_qtl2_scan_hk_onechr_perm, 5},
     {"_qtl2_scan_hk_onechr_intcovar_highmem", (DL_FUNC) &_qtl2_scan_hk_onechr_intcovar_highmem, 5},
     {"_qtl2_scan_hk_onechr_intcovar_weighted_highmem", (DL_FUNC) &_qtl2_scan_hk_onechr_intcovar_weighted_highmem, 6},
     {"_qtl2_scan_hk_onechr_intcovar_lowmem", (DL_FUNC) &_qtl2_scan_hk_onechr_intcovar_lowmem, 5},
     {"_qtl2_scan_hk_onechr_intcovar_weighted_lowmem", (DL_FUNC) &_qtl2_scan_hk_onechr_intcovar_weighted_lowmem, 6},
-    {"_qtl2_scan_pg_onechr", (DL_FUNC) &_qtl2_scan_pg_onechr, 6},
+    {"_qtl2_rotate_genoprobs", (DL_FUNC) &_qtl2_rotate_genoprobs, 3},
+    {"_qtl2_scan_pg_onechr_rotated", (DL_FUNC) &_qtl2_scan_pg_onechr_rotated, 7},
+    {"_qtl2_scan_pg_onechr", (DL_FUNC) &_qtl2_scan_pg_onechr, 7},
+    {"_qtl2_scan_pg_onechr_hsq", (DL_FUNC) &_qtl2_scan_pg_onechr_hsq, 10},
     {"_qtl2_scan_pg_onechr_intcovar_highmem", (DL_FUNC) &_qtl2_scan_pg_onechr_intcovar_highmem, 7},
     {"_qtl2_scan_pg_onechr_intcovar_lowmem", (DL_FUNC) &_qtl2_scan_pg_onechr_intcovar_lowmem, 7},
-    {"_qtl2_scanblup", (DL_FUNC) &_qtl2_scanblup, 6},
+    {"_qtl2_scanblup", (DL_FUNC) &_qtl2_scanblup, 7},
     {"_qtl2_scancoef_binary_addcovar", (DL_FUNC) &_qtl2_scancoef_binary_addcovar, 8},
     {"_qtl2_scancoef_binary_intcovar", (DL_FUNC) &_qtl2_scancoef_binary_intcovar, 9},
     {"_qtl2_scancoefSE_binary_addcovar", (DL_FUNC) &_qtl2_scancoefSE_binary_addcovar, 8},
@@ -2605,6 +3048,10 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_scancoef_pg_intcovar", (DL_FUNC) &_qtl2_scancoef_pg_intcovar, 7},
     {"_qtl2_scancoefSE_pg_addcovar", (DL_FUNC) &_qtl2_scancoefSE_pg_addcovar, 6},
     {"_qtl2_scancoefSE_pg_intcovar", (DL_FUNC) &_qtl2_scancoefSE_pg_intcovar, 7},
+    {"_qtl2_prep_hk_onechr", (DL_FUNC) &_qtl2_prep_hk_onechr, 4},
+    {"_qtl2_scan_hk_prepped", (DL_FUNC) &_qtl2_scan_hk_prepped, 3},
+    {"_qtl2_scancoef_hk_prepped", (DL_FUNC) &_qtl2_scancoef_hk_prepped, 6},
+    {"_qtl2_scan_hk_snps", (DL_FUNC) &_qtl2_scan_hk_snps, 8},
     {"_qtl2_calc_sdp", (DL_FUNC) &_qtl2_calc_sdp, 1},
     {"_qtl2_invert_sdp", (DL_FUNC) &_qtl2_invert_sdp, 2},
     {"_qtl2_alleleprob_to_snpprob", (DL_FUNC) &_qtl2_alleleprob_to_snpprob, 4},
@@ -2612,6 +3059,12 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_genoprob_to_snpprob", (DL_FUNC) &_qtl2_genoprob_to_snpprob, 4},
     {"_qtl2_Xgenocol_to_snpcol", (DL_FUNC) &_qtl2_Xgenocol_to_snpcol, 2},
     {"_qtl2_Xgenoprob_to_snpprob", (DL_FUNC) &_qtl2_Xgenoprob_to_snpprob, 4},
+    {"_qtl2_sparsify_genoprob", (DL_FUNC) &_qtl2_sparsify_genoprob, 3},
+    {"_qtl2_densify_genoprob", (DL_FUNC) &_qtl2_densify_genoprob, 1},
+    {"_qtl2_sparse_genoprob_to_alleleprob", (DL_FUNC) &_qtl2_sparse_genoprob_to_alleleprob, 3},
+    {"_qtl2_sparse_genoprob_to_snpprob", (DL_FUNC) &_qtl2_sparse_genoprob_to_snpprob, 5},
+    {"_qtl2_calc_kinship_sparse_bychr", (DL_FUNC) &_qtl2_calc_kinship_sparse_bychr, 3},
+    {"_qtl2_scan_hk_onechr_sparse", (DL_FUNC) &_qtl2_scan_hk_onechr_sparse, 6},
     {"_qtl2_test_init", (DL_FUNC) &_qtl2_test_init, 5},
     {"_qtl2_test_emit", (DL_FUNC) &_qtl2_test_emit, 8},
     {"_qtl2_test_step", (DL_FUNC) &_qtl2_test_step, 7},
@@ -2625,6 +3078,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_qtl2_test_emitmatrix", (DL_FUNC) &_qtl2_test_emitmatrix, 7},
     {"_qtl2_test_stepmatrix", (DL_FUNC) &_qtl2_test_stepmatrix, 5},
     {"_qtl2_test_initvector", (DL_FUNC) &_qtl2_test_initvector, 4},
+    {"_qtl2_test_generic_kernels", (DL_FUNC) &_qtl2_test_generic_kernels, 1},
     {NULL, NULL, 0}
 };
 
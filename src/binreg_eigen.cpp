@@ -102,25 +102,59 @@ double calc_ll_binreg_eigenqr(const NumericMatrix& X, const NumericVector& y,
         throw std::invalid_argument("nrow(X) != length(y)");
     #endif
 
+    const MatrixXd XX(as<Map<MatrixXd> >(X));
+    const VectorXd yy(as<Map<VectorXd> >(y));
+
+    bool converged;
+    VectorXd eta; // empty, so start from y
+    const double llik = calc_ll_binreg_eigenqr(XX, yy, maxit, tol, qr_tol, eta_max, converged, eta);
+
+    if(!converged) r_warning("binary trait regression didn't converge: increase maxit or tol");
+
+    return llik;
+}
+
+// logistic regression by QR decomposition with column pivoting
+// return just the log likelihood, with converged indicating convergence
+//
+// eta = linear predictor: if it has length(y), it's used as the starting
+//       point (e.g., the fit at a neighboring position); otherwise we start
+//       from y. On return, it contains the fitted linear predictor.
+//
+// (Eigen objects only, so may be called from worker threads)
+double calc_ll_binreg_eigenqr(const MatrixXd& X, const VectorXd& y,
+                              const int maxit, const double tol,
+                              const double qr_tol, const double eta_max,
+                              bool& converged, VectorXd& eta)
+{
+    const int n_ind = y.size();
+    const bool warm_start = (eta.size() == n_ind);
+    if(!warm_start) eta.resize(n_ind);
+
     double curllik = 0.0;
-    NumericVector pi(n_ind), wt(n_ind), eta(n_ind), z(n_ind);
+    VectorXd pi(n_ind), wt(n_ind), z(n_ind);
 
     for(int ind=0; ind<n_ind; ind++) {
-        pi[ind] = (y[ind] + 0.5)/2;
+        if(warm_start) {
+            if(eta[ind] < -eta_max) eta[ind] = -eta_max;
+            else if(eta[ind] > eta_max) eta[ind] = eta_max;
+            pi[ind] = exp(eta[ind])/(1.0 + exp(eta[ind]));
+        }
+        else {
+            pi[ind] = (y[ind] + 0.5)/2;
+            eta[ind] = log(pi[ind]) - log(1.0-pi[ind]);
+        }
         wt[ind] = sqrt(pi[ind] * (1.0-pi[ind]));
-        eta[ind] = log(pi[ind]) - log(1.0-pi[ind]);
         z[ind] = eta[ind]*wt[ind] + (y[ind] - pi[ind])/wt[ind];
         curllik += y[ind] * log10(pi[ind]) + (1.0-y[ind])*log10(1.0-pi[ind]);
     }
 
-    NumericMatrix XX = weighted_matrix(X, wt);
+    MatrixXd XX = wt.asDiagonal() * X;
 
-    bool converged=false;
+    converged=false;
     double llik=0.0;
 
     for(int it=0; it<maxit; it++) {
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
         // fitted values using weighted XX; will need to divide by previous weights
         eta = calc_fitted_linreg_eigenqr(XX, z, qr_tol);
 
@@ -144,13 +178,11 @@ double calc_ll_binreg_eigenqr(const NumericMatrix& X, const NumericVector& y,
             break;
         }
 
-        XX = weighted_matrix(X, wt);
+        XX = wt.asDiagonal() * X;
         curllik = llik;
 
     } // end iterations
 
-    if(!converged) r_warning("binary trait regression didn't converge: increase maxit or tol");
-
     return llik;
 }
 
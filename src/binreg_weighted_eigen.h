@@ -25,6 +25,18 @@ double calc_ll_binreg_weighted_eigenqr(const Rcpp::NumericMatrix& X,
                                        const double qr_tol,
                                        const double eta_max);
 
+// logistic regression by QR decomposition with column pivoting
+// return just the log likelihood, with converged indicating convergence
+// (eta = starting linear predictor if length(y), otherwise start from y;
+//  on return, the fitted linear predictor)
+// this version with weights
+// (Eigen objects only, so may be called from worker threads)
+double calc_ll_binreg_weighted_eigenqr(const Eigen::MatrixXd& X, const Eigen::VectorXd& y,
+                                       const Eigen::VectorXd& weights,
+                                       const int maxit, const double tol,
+                                       const double qr_tol, const double eta_max,
+                                       bool& converged, Eigen::VectorXd& eta);
+
 // logistic regression
 // return just the coefficients
 // this version with weights
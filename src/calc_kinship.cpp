@@ -1,7 +1,12 @@
 // calculate genetic similarity (kinship matrix) from genotype probabilities
 
+// [[Rcpp::depends(RcppEigen)]]
+
 #include "calc_kinship.h"
-#include <Rcpp.h>
+#include <RcppEigen.h>
+#include <algorithm>
+#include <vector>
+#include "parallel_util.h"
 using namespace Rcpp;
 
 
@@ -37,3 +42,90 @@ NumericMatrix calc_kinship(const NumericVector& prob_array) // array as n_pos x
 
     return result;
 }
+
+
+// calculate kinship matrix (unscaled) for each chromosome and their sum
+//
+// probs     = list of 3d arrays of genotype probabilities (each n_ind x n_gen x n_pos)
+// bychr     = if false, just calculate the sum over chromosomes
+// n_threads = number of threads to use (over blocks of the result)
+//
+// output    = list with total (n_ind x n_ind) and bychr (list of n_ind x n_ind
+//             matrices, one per chromosome, or empty if bychr=false)
+//
+// Each chromosome's probabilities are treated as an n_ind x (n_gen*n_pos)
+// matrix P, and the kinship is P P'. This is calculated for blocks of
+// individuals with matrix products; blocks of the lower triangle of the
+// result are split among threads and the upper triangle filled by symmetry.
+//
+// [[Rcpp::export(".calc_kinship_bychr")]]
+List calc_kinship_bychr(const List& probs, const bool bychr=true, const int n_threads=1)
+{
+    const int n_chr = probs.size();
+    if(n_chr == 0)
+        throw std::invalid_argument("probs has length 0");
+
+    std::vector<NumericVector> p(n_chr); // keeps the data alive, if coerced
+    std::vector<const double*> pr(n_chr);
+    std::vector<int> n_col(n_chr);
+    int n_ind = -1;
+    for(int chr=0; chr<n_chr; chr++) {
+        p[chr] = probs[chr];
+        if(Rf_isNull(p[chr].attr("dim")))
+            throw std::invalid_argument("probs[[i]] should be a 3d array but has no dim attribute");
+        const IntegerVector& dim = p[chr].attr("dim");
+        if(dim.size() != 3)
+            throw std::invalid_argument("probs[[i]] should be a 3d array of probabilities");
+        if(n_ind < 0) n_ind = dim[0];
+        else if(dim[0] != n_ind)
+            throw std::invalid_argument("probs[[i]] should all have the same number of individuals");
+        n_col[chr] = dim[1] * dim[2];
+        pr[chr] = REAL(p[chr]);
+    }
+
+    NumericMatrix total(n_ind, n_ind);
+    double *total_ptr = REAL(total);
+    List result_bychr(bychr ? n_chr : 0);
+    std::vector<double*> bychr_ptr;
+    if(bychr) {
+        for(int chr=0; chr<n_chr; chr++) {
+            NumericMatrix K(n_ind, n_ind);
+            result_bychr[chr] = K;
+            bychr_ptr.push_back(REAL(K));
+        }
+    }
+
+    // blocks in the lower triangle
+    const int block_size = 256;
+    const int n_block = (n_ind + block_size - 1)/block_size;
+    std::vector< std::pair<int,int> > blocks;
+    for(int bi=0; bi<n_block; bi++)
+        for(int bj=0; bj<=bi; bj++)
+            blocks.push_back(std::make_pair(bi, bj));
+
+    parallel_for(blocks.size(), n_threads, [&](const int block, const int thread) {
+        const int i0 = blocks[block].first * block_size;
+        const int j0 = blocks[block].second * block_size;
+        const int ni = std::min(block_size, n_ind - i0);
+        const int nj = std::min(block_size, n_ind - j0);
+
+        Eigen::Map<Eigen::MatrixXd> tot(total_ptr, n_ind, n_ind);
+        Eigen::MatrixXd K(ni, nj);
+
+        for(int chr=0; chr<n_chr; chr++) {
+            const Eigen::Map<const Eigen::MatrixXd> P(pr[chr], n_ind, n_col[chr]);
+            K.noalias() = P.middleRows(i0, ni) * P.middleRows(j0, nj).transpose();
+
+            tot.block(i0, j0, ni, nj) += K;
+            if(bychr) {
+                Eigen::Map<Eigen::MatrixXd> Kchr(bychr_ptr[chr], n_ind, n_ind);
+                Kchr.block(i0, j0, ni, nj) = K;
+                if(i0 != j0) Kchr.block(j0, i0, nj, ni) = K.transpose();
+            }
+        }
+        if(i0 != j0) tot.block(j0, i0, nj, ni) = tot.block(i0, j0, ni, nj).transpose();
+    });
+
+    return List::create(Named("total") = total,
+                        Named("bychr") = result_bychr);
+}
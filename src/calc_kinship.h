@@ -6,4 +6,8 @@
 
 Rcpp::NumericMatrix calc_kinship(const Rcpp::NumericVector& prob_array); // array as n_pos x n_gen x n_ind
 
+// calculate kinship matrix (unscaled) for each chromosome and their sum
+// (probs is a list of arrays, each n_ind x n_gen x n_pos)
+Rcpp::List calc_kinship_bychr(const Rcpp::List& probs, const bool bychr, const int n_threads);
+
 #endif // CALC_KINSHIP_H
@@ -0,0 +1,474 @@
+// compact genotype probabilities (stored as 16-bit fixed-point values)
+
+#include "compact_genoprob.h"
+#include <RcppEigen.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <utility>
+
+using namespace Rcpp;
+using namespace Eigen;
+
+#include "cross.h"
+#include "parallel_util.h"
+#include "genoprob_kernels.h"
+
+// byte order of this machine, as in .Platform$endian
+static const char *native_byte_order()
+{
+    const uint16_t one = 1;
+    return (*(const unsigned char *)&one == 1) ? "little" : "big";
+}
+
+// pointer into the compact probabilities for one chromosome
+// (the list keeps the raw vector alive)
+CompactGenoprob::CompactGenoprob(const List& probs)
+{
+    if(!probs.containsElementNamed("prob") || !probs.containsElementNamed("dim"))
+        throw std::invalid_argument("compact probs should contain prob and dim");
+
+    // the values are in the byte order of the machine that created them
+    SEXP byte_order = probs.attr("byte_order");
+    if(TYPEOF(byte_order) != STRSXP || Rf_length(byte_order) != 1)
+        throw std::invalid_argument("compact probs should have a byte_order attribute");
+    if(strcmp(CHAR(STRING_ELT(byte_order, 0)), native_byte_order()) != 0)
+        throw std::invalid_argument("compact probs were created with a different byte order; re-create them with compact_genoprob()");
+
+    SEXP prob_sexp = probs["prob"];
+    if(TYPEOF(prob_sexp) != RAWSXP)
+        throw std::invalid_argument("compact probs should have raw prob");
+
+    const IntegerVector dim = probs["dim"];
+    if(dim.size() != 3)
+        throw std::invalid_argument("compact probs dim should have length 3");
+    n_ind = dim[0];
+    n_gen = dim[1];
+    n_pos = dim[2];
+
+    if(Rf_xlength(prob_sexp) != 2*(R_xlen_t)n_ind*n_gen*n_pos)
+        throw std::invalid_argument("length(prob) != 2*n_ind*n_gen*n_pos");
+
+    prob = (const uint16_t *)RAW(prob_sexp);
+}
+
+// compact object as list, with space for the values
+// (and attribute byte_order, as the values are in this machine's byte order)
+static List compact_list(const int n_ind, const int n_gen, const int n_pos)
+{
+    RawVector prob(2*(size_t)n_ind*n_gen*n_pos);
+
+    List result = List::create(Named("prob") = prob,
+                               Named("dim") = IntegerVector::create(n_ind, n_gen, n_pos));
+    result.attr("byte_order") = native_byte_order();
+
+    return result;
+}
+
+// pointer to the values in a compact object created by compact_list()
+static uint16_t *compact_values(const List& probs)
+{
+    SEXP prob_sexp = probs["prob"];
+    return (uint16_t *)RAW(prob_sexp);
+}
+
+// convert genotype probabilities (3d array individuals x genotypes x positions) to compact form
+//
+// output = list with prob and dim
+//
+// [[Rcpp::export(".compact_genoprob")]]
+List compact_genoprob(const NumericVector& prob_array)
+{
+    if(Rf_isNull(prob_array.attr("dim")))
+        throw std::invalid_argument("prob_array should be a 3d array but has no dimension attribute");
+    const IntegerVector& dim = prob_array.attr("dim");
+    if(dim.size() != 3)
+        throw std::invalid_argument("prob_array should be a 3d array of probabilities");
+
+    List result = compact_list(dim[0], dim[1], dim[2]);
+    uint16_t *res = compact_values(result);
+
+    const double *pr = REAL(prob_array);
+    const size_t n = prob_array.size();
+    for(size_t i=0; i<n; i++) res[i] = narrow_prob(pr[i]);
+
+    return result;
+}
+
+// convert compact genotype probabilities to a 3d array (individuals x genotypes x positions)
+//
+// [[Rcpp::export(".expand_genoprob")]]
+NumericVector expand_genoprob(const List& probs)
+{
+    const CompactGenoprob pr(probs);
+    const size_t n = (size_t)pr.n_ind*pr.n_gen*pr.n_pos;
+
+    NumericVector result(n);
+    result.attr("dim") = Dimension(pr.n_ind, pr.n_gen, pr.n_pos);
+    double *res = REAL(result);
+
+    for(size_t i=0; i<n; i++) res[i] = widen_prob(pr.prob[i]);
+
+    return result;
+}
+
+// subset compact genotype probabilities
+//
+// probs = compact genotype probabilities for one chromosome
+// ind   = individuals to keep (0-based indexes)
+// gen   = genotypes to keep (0-based indexes)
+// pos   = positions to keep (0-based indexes)
+//
+// [[Rcpp::export(".subset_compact_genoprob")]]
+List subset_compact_genoprob(const List& probs,
+                             const IntegerVector& ind,
+                             const IntegerVector& gen,
+                             const IntegerVector& pos)
+{
+    const CompactGenoprob pr(probs);
+    const int n_ind = ind.size();
+    const int n_gen = gen.size();
+    const int n_pos = pos.size();
+
+    for(int i=0; i<n_ind; i++)
+        if(ind[i] < 0 || ind[i] >= pr.n_ind) throw std::range_error("ind out of range");
+    for(int i=0; i<n_gen; i++)
+        if(gen[i] < 0 || gen[i] >= pr.n_gen) throw std::range_error("gen out of range");
+    for(int i=0; i<n_pos; i++)
+        if(pos[i] < 0 || pos[i] >= pr.n_pos) throw std::range_error("pos out of range");
+
+    List result = compact_list(n_ind, n_gen, n_pos);
+    uint16_t *res = compact_values(result);
+
+    for(int k=0; k<n_pos; k++) {
+        for(int j=0; j<n_gen; j++) {
+            const uint16_t *from = pr.prob + ((size_t)pos[k]*pr.n_gen + gen[j])*pr.n_ind;
+            uint16_t *to = res + ((size_t)k*n_gen + j)*n_ind;
+            for(int i=0; i<n_ind; i++) to[i] = from[ind[i]];
+        }
+    }
+
+    return result;
+}
+
+// sum of the compact genotype probabilities for each genotype
+//
+// [[Rcpp::export(".compact_genoprob_colsums")]]
+NumericVector compact_genoprob_colsums(const List& probs)
+{
+    const CompactGenoprob pr(probs);
+
+    NumericVector result(pr.n_gen);
+    for(int pos=0; pos<pr.n_pos; pos++) {
+        for(int gen=0; gen<pr.n_gen; gen++) {
+            const uint16_t *v = pr.prob + ((size_t)pos*pr.n_gen + gen)*pr.n_ind;
+            double sum = 0.0;
+            for(int ind=0; ind<pr.n_ind; ind++) sum += v[ind];
+            result[gen] += sum;
+        }
+    }
+
+    for(int gen=0; gen<pr.n_gen; gen++) result[gen] /= COMPACT_SCALE;
+
+    return result;
+}
+
+// interpolate compact genotype probabilities, as in interp_genoprob_onechr()
+//
+// [[Rcpp::export(".interp_compact_genoprob_onechr")]]
+List interp_compact_genoprob_onechr(const List& probs,
+                                    const NumericVector& map,
+                                    const IntegerVector& pos_index)
+{
+    const CompactGenoprob pr(probs);
+    const int n_ind = pr.n_ind;
+    const int n_gen = pr.n_gen;
+    const size_t matsize = (size_t)n_ind * n_gen;
+    const int n_pos = map.size();
+    if(pos_index.size() != n_pos) {
+        throw std::invalid_argument("Need length(map) == length(pos_index)");
+    }
+
+    List result = compact_list(n_ind, n_gen, n_pos);
+    uint16_t *res = compact_values(result);
+
+    // find position to the left and to the right that have genoprobs
+    std::vector<int> left_index(n_pos), right_index(n_pos);
+    int last = -1;
+    for(int pos=0; pos<n_pos; pos++) {
+        if(pos_index[pos] >= 0) last = pos;
+        left_index[pos] = last;
+    }
+    last = -1;
+    for(int pos=n_pos-1; pos>=0; pos--) {
+        if(pos_index[pos] >= 0) last = pos;
+        right_index[pos] = last;
+    }
+
+    // copy or interpolate
+    for(int pos=0; pos<n_pos; pos++) {
+        uint16_t *to = res + pos*matsize;
+
+        if(pos_index[pos] >= 0) { // in the old genoprobs
+            const uint16_t *from = pr.prob + pos_index[pos]*matsize;
+            std::copy(from, from + matsize, to);
+        }
+        else if(left_index[pos] < 0) { // off end to left
+            const uint16_t *from = pr.prob + pos_index[right_index[pos]]*matsize;
+            std::copy(from, from + matsize, to);
+        }
+        else if(right_index[pos] < 0) { // off end to right
+            const uint16_t *from = pr.prob + pos_index[left_index[pos]]*matsize;
+            std::copy(from, from + matsize, to);
+        }
+        else {
+            const double left_pos =  map[left_index[pos]];
+            const double right_pos = map[right_index[pos]];
+            const double p = (right_pos - map[pos])/(right_pos - left_pos);
+            const double q = (map[pos] - left_pos)/(right_pos - left_pos);
+
+            const uint16_t *left = pr.prob + pos_index[left_index[pos]]*matsize;
+            const uint16_t *right = pr.prob + pos_index[right_index[pos]]*matsize;
+            for(size_t i=0; i<matsize; i++)
+                to[i] = (uint16_t)(p*left[i] + q*right[i] + 0.5);
+        }
+    }
+
+    return result;
+}
+
+// convert compact genotype probabilities to compact allele probabilities
+//
+// [[Rcpp::export(".compact_genoprob_to_alleleprob")]]
+List compact_genoprob_to_alleleprob(const String& crosstype,
+                                    const List& probs,
+                                    const bool is_x_chr)
+{
+    const CompactGenoprob pr(probs);
+    const int n_ind = pr.n_ind;
+    const int n_gen = pr.n_gen;
+    const int n_pos = pr.n_pos;
+
+    QTLCross* cross = QTLCross::Create(crosstype);
+    const NumericMatrix transform = cross->geno2allele_matrix(is_x_chr);
+    delete cross;
+
+    if(transform.cols() == 0) return probs; // no conversion needed
+    if((int)transform.rows() != n_gen)
+        throw std::invalid_argument("no. genotypes in probs doesn't match no. rows in transform matrix");
+    const int n_allele = transform.cols();
+
+    List result = compact_list(n_ind, n_allele, n_pos);
+    uint16_t *res = compact_values(result);
+
+    std::vector<double> value(n_allele);
+    for(int pos=0; pos<n_pos; pos++) {
+        Rcpp::checkUserInterrupt();  // check for ^C from user
+
+        const uint16_t *from = pr.prob + (size_t)pos*n_gen*n_ind;
+        uint16_t *to = res + (size_t)pos*n_allele*n_ind;
+        for(int ind=0; ind<n_ind; ind++) {
+            std::fill(value.begin(), value.end(), 0.0);
+            for(int g=0; g<n_gen; g++) {
+                const double v = widen_prob(from[ind + g*n_ind]);
+                if(v == 0.0) continue;
+                for(int a=0; a<n_allele; a++)
+                    value[a] += v * transform(g, a);
+            }
+            for(int a=0; a<n_allele; a++)
+                to[ind + a*n_ind] = narrow_prob(value[a]);
+        }
+    }
+
+    return result;
+}
+
+// convert compact genotype or allele probabilities to SNP probabilities
+//
+// probs     = compact genotype or allele probabilities for one chromosome
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = 3d array individuals x SNP genotypes x SNPs
+//
+// [[Rcpp::export(".compact_genoprob_to_snpprob")]]
+NumericVector compact_genoprob_to_snpprob(const List& probs,
+                                          const IntegerVector& sdp,
+                                          const IntegerVector& interval,
+                                          const LogicalVector& on_map,
+                                          const int prob_type)
+{
+    const CompactGenoprob pr(probs);
+    return genoprob_to_snpprob_kernel(pr, sdp, interval, on_map, prob_type);
+}
+
+// calculate kinship matrix (unscaled) for each chromosome and their sum,
+// from compact probabilities
+//
+// probs     = list of compact probabilities, one per chromosome
+// crosstype = cross type, used to convert genotype probabilities to
+//             allele probabilities; if "", the probabilities are used as is
+// is_x_chr  = logical vector indicating which chromosomes are the X
+// bychr     = if false, just calculate the sum over chromosomes
+// n_threads = number of threads to use (over blocks of the result)
+//
+// output    = list with total (n_ind x n_ind) and bychr (list of n_ind x n_ind
+//             matrices, one per chromosome, or empty if bychr=false)
+//
+// As in calc_kinship_bychr(), the kinship is P P' for blocks of
+// individuals, with P the n_ind x (n_gen*n_pos) matrix of
+// probabilities. Each thread widens chunks of columns of P for its
+// rows to double before the matrix product. The conversion to allele
+// probabilities is applied to the widened values, so that they're not
+// rounded to 16 bits a second time.
+//
+// [[Rcpp::export(".calc_kinship_compact_bychr")]]
+List calc_kinship_compact_bychr(const List& probs,
+                                const String& crosstype,
+                                const LogicalVector& is_x_chr,
+                                const bool bychr=true,
+                                const int n_threads=1)
+{
+    const int n_chr = probs.size();
+    if(n_chr == 0)
+        throw std::invalid_argument("probs has length 0");
+    if(is_x_chr.size() != n_chr)
+        throw std::invalid_argument("length(is_x_chr) != length(probs)");
+
+    std::vector<CompactGenoprob> pr;
+    for(int chr=0; chr<n_chr; chr++) {
+        pr.push_back(CompactGenoprob(as<List>(probs[chr])));
+        if(pr[chr].n_ind != pr[0].n_ind)
+            throw std::invalid_argument("probs[[i]] should all have the same number of individuals");
+    }
+    const int n_ind = pr[0].n_ind;
+
+    // for each chromosome and each column of P at a position, the
+    // genotype columns and coefficients that form it
+    typedef std::vector< std::pair<int,double> > terms_t;
+    std::vector< std::vector<terms_t> > terms(n_chr);
+    const bool to_alleles = (crosstype.get_cstring()[0] != '\0');
+    QTLCross* cross = to_alleles ? QTLCross::Create(crosstype) : 0;
+    for(int chr=0; chr<n_chr; chr++) {
+        const int n_gen = pr[chr].n_gen;
+        NumericMatrix transform(0, 0);
+        if(to_alleles) transform = cross->geno2allele_matrix(is_x_chr[chr]);
+
+        if(transform.cols() == 0) { // no conversion
+            terms[chr].resize(n_gen);
+            for(int g=0; g<n_gen; g++) terms[chr][g].push_back(std::make_pair(g, 1.0));
+            continue;
+        }
+        if((int)transform.rows() != n_gen) {
+            delete cross;
+            throw std::invalid_argument("no. genotypes in probs doesn't match no. rows in transform matrix");
+        }
+        terms[chr].resize(transform.cols());
+        for(int a=0; a<transform.cols(); a++)
+            for(int g=0; g<n_gen; g++)
+                if(transform(g, a) != 0.0) terms[chr][a].push_back(std::make_pair(g, transform(g, a)));
+    }
+    if(to_alleles) delete cross;
+
+    NumericMatrix total(n_ind, n_ind);
+    double *total_ptr = REAL(total);
+    List result_bychr(bychr ? n_chr : 0);
+    std::vector<double*> bychr_ptr;
+    if(bychr) {
+        for(int chr=0; chr<n_chr; chr++) {
+            NumericMatrix K(n_ind, n_ind);
+            result_bychr[chr] = K;
+            bychr_ptr.push_back(REAL(K));
+        }
+    }
+
+    // blocks in the lower triangle
+    const int block_size = 256;
+    const int chunk_size = 256; // columns of P widened at a time
+    const int n_block = (n_ind + block_size - 1)/block_size;
+    std::vector< std::pair<int,int> > blocks;
+    for(int bi=0; bi<n_block; bi++)
+        for(int bj=0; bj<=bi; bj++)
+            blocks.push_back(std::make_pair(bi, bj));
+
+    parallel_for(blocks.size(), n_threads, [&](const int block, const int thread) {
+        const int i0 = blocks[block].first * block_size;
+        const int j0 = blocks[block].second * block_size;
+        const int ni = std::min(block_size, n_ind - i0);
+        const int nj = std::min(block_size, n_ind - j0);
+
+        Eigen::Map<Eigen::MatrixXd> tot(total_ptr, n_ind, n_ind);
+        Eigen::MatrixXd K(ni, nj), Pi(ni, chunk_size), Pj(nj, chunk_size);
+
+        for(int chr=0; chr<n_chr; chr++) {
+            const int n_gen = pr[chr].n_gen;
+            const int n_out = terms[chr].size();
+            const size_t n_col = (size_t)n_out * pr[chr].n_pos;
+
+            K.setZero();
+            for(size_t c0=0; c0<n_col; c0 += chunk_size) {
+                const int nc = std::min((size_t)chunk_size, n_col - c0);
+                Pi.leftCols(nc).setZero();
+                if(i0 != j0) Pj.leftCols(nc).setZero();
+                for(int c=0; c<nc; c++) {
+                    const size_t pos = (c0+c) / n_out;
+                    const terms_t& col_terms = terms[chr][(c0+c) % n_out];
+                    const uint16_t *P = pr[chr].prob + pos*n_gen*n_ind;
+                    for(size_t t=0; t<col_terms.size(); t++) {
+                        const uint16_t *col = P + (size_t)col_terms[t].first*n_ind;
+                        const double coef = col_terms[t].second;
+                        for(int i=0; i<ni; i++) Pi(i,c) += coef * widen_prob(col[i0+i]);
+                        if(i0 != j0)
+                            for(int j=0; j<nj; j++) Pj(j,c) += coef * widen_prob(col[j0+j]);
+                    }
+                }
+                if(i0 == j0)
+                    K.noalias() += Pi.leftCols(nc) * Pi.leftCols(nc).transpose();
+                else
+                    K.noalias() += Pi.leftCols(nc) * Pj.leftCols(nc).transpose();
+            }
+
+            tot.block(i0, j0, ni, nj) += K;
+            if(bychr) {
+                Eigen::Map<Eigen::MatrixXd> Kchr(bychr_ptr[chr], n_ind, n_ind);
+                Kchr.block(i0, j0, ni, nj) = K;
+                if(i0 != j0) Kchr.block(j0, i0, nj, ni) = K.transpose();
+            }
+        }
+        if(i0 != j0) tot.block(j0, i0, nj, ni) = tot.block(i0, j0, ni, nj).transpose();
+    });
+
+    return List::create(Named("total") = total,
+                        Named("bychr") = result_bychr);
+}
+
+// Scan a single chromosome with additive covariates, with compact genotype probabilities
+//
+// genoprobs = compact genotype probabilities for one chromosome
+//             (already subset to the individuals and genotype columns to use)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// weights   = vector of weights (really the SQUARE ROOT of the weights), or length 0
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
+//
+// See scan_hk_onechr_kernel() in genoprob_kernels.h.
+//
+// [[Rcpp::export]]
+NumericMatrix scan_hk_onechr_compact(const List& genoprobs,
+                                     const NumericMatrix& pheno,
+                                     const NumericMatrix& addcovar,
+                                     const NumericVector& weights,
+                                     const double tol=1e-12,
+                                     const int n_threads=1)
+{
+    const CompactGenoprob pr(genoprobs);
+    return scan_hk_onechr_kernel(pr, pheno, addcovar, weights, tol, n_threads);
+}
@@ -0,0 +1,127 @@
+// compact genotype probabilities (stored as 16-bit fixed-point values)
+#ifndef COMPACT_GENOPROB_H
+#define COMPACT_GENOPROB_H
+
+#include <Rcpp.h>
+#include <stdint.h>
+
+// a probability p is stored as the 16-bit integer round(p * COMPACT_SCALE)
+const double COMPACT_SCALE = 65535.0;
+
+// double -> 16-bit value (values outside [0,1], and NaN, are truncated to [0,1])
+inline uint16_t narrow_prob(const double p)
+{
+    if(!(p > 0.0)) return 0;
+    if(p >= 1.0) return 65535;
+    return (uint16_t)(p * COMPACT_SCALE + 0.5);
+}
+
+// 16-bit value -> double
+inline double widen_prob(const uint16_t v)
+{
+    return (double)v * (1.0/COMPACT_SCALE);
+}
+
+// pointer into the compact probabilities for one chromosome
+// (a list with prob and dim; see R/compact_genoprob.R)
+//
+// prob is a raw vector with two bytes per value, in the same order as
+// a 3d array individuals x genotypes x positions; the list's attribute
+// byte_order ("little" or "big") must match this machine
+struct CompactGenoprob {
+    int n_ind;
+    int n_gen;
+    int n_pos;
+    const uint16_t *prob;
+
+    CompactGenoprob(const Rcpp::List& probs);
+
+    // call f(ind, gen, prob) for each non-zero probability at position pos
+    template<class F>
+    void visit(const int pos, F f) const
+    {
+        const uint16_t *v = prob + (size_t)pos*n_gen*n_ind;
+        for(int g=0; g<n_gen; g++)
+            for(int ind=0; ind<n_ind; ind++, v++)
+                if(*v > 0) f(ind, g, widen_prob(*v));
+    }
+};
+
+// convert genotype probabilities (3d array individuals x genotypes x positions) to compact form
+//
+// output = list with prob and dim
+Rcpp::List compact_genoprob(const Rcpp::NumericVector& prob_array);
+
+// convert compact genotype probabilities to a 3d array (individuals x genotypes x positions)
+Rcpp::NumericVector expand_genoprob(const Rcpp::List& probs);
+
+// subset compact genotype probabilities
+//
+// probs = compact genotype probabilities for one chromosome
+// ind   = individuals to keep (0-based indexes)
+// gen   = genotypes to keep (0-based indexes)
+// pos   = positions to keep (0-based indexes)
+Rcpp::List subset_compact_genoprob(const Rcpp::List& probs,
+                                   const Rcpp::IntegerVector& ind,
+                                   const Rcpp::IntegerVector& gen,
+                                   const Rcpp::IntegerVector& pos);
+
+// sum of the compact genotype probabilities for each genotype
+Rcpp::NumericVector compact_genoprob_colsums(const Rcpp::List& probs);
+
+// interpolate compact genotype probabilities, as in interp_genoprob_onechr()
+Rcpp::List interp_compact_genoprob_onechr(const Rcpp::List& probs,
+                                          const Rcpp::NumericVector& map,
+                                          const Rcpp::IntegerVector& pos_index);
+
+// convert compact genotype probabilities to compact allele probabilities
+Rcpp::List compact_genoprob_to_alleleprob(const Rcpp::String& crosstype,
+                                          const Rcpp::List& probs,
+                                          const bool is_x_chr);
+
+// convert compact genotype or allele probabilities to SNP probabilities
+//
+// probs     = compact genotype or allele probabilities for one chromosome
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = 3d array individuals x SNP genotypes x SNPs
+Rcpp::NumericVector compact_genoprob_to_snpprob(const Rcpp::List& probs,
+                                                const Rcpp::IntegerVector& sdp,
+                                                const Rcpp::IntegerVector& interval,
+                                                const Rcpp::LogicalVector& on_map,
+                                                const int prob_type);
+
+// calculate kinship matrix (unscaled) for each chromosome and their sum,
+// from compact probabilities (probs is a list of compact probabilities, one per chromosome)
+//
+// if crosstype != "", the genotype probabilities are converted to
+// allele probabilities (in double precision) as they're used
+Rcpp::List calc_kinship_compact_bychr(const Rcpp::List& probs,
+                                      const Rcpp::String& crosstype,
+                                      const Rcpp::LogicalVector& is_x_chr,
+                                      const bool bychr, const int n_threads);
+
+// Scan a single chromosome with additive covariates, with compact genotype probabilities
+//
+// genoprobs = compact genotype probabilities for one chromosome
+//             (already subset to the individuals and genotype columns to use)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// weights   = vector of weights (really the SQUARE ROOT of the weights), or length 0
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
+Rcpp::NumericMatrix scan_hk_onechr_compact(const Rcpp::List& genoprobs,
+                                           const Rcpp::NumericMatrix& pheno,
+                                           const Rcpp::NumericMatrix& addcovar,
+                                           const Rcpp::NumericVector& weights,
+                                           const double tol,
+                                           const int n_threads);
+
+#endif // COMPACT_GENOPROB_H
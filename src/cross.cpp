@@ -2,8 +2,12 @@
 //
 // to add a new cross type:
 //     - create files similar to cross_f2.h and cross_f2.cpp
+//       (class NEW final : public QTLCrossT<NEW>)
 //     - add include line below
 //     - add if statement within QTLCross::Create function below
+//     - for a simple cross whose HMM functions should be inlined, define
+//       init(), emit(), and step() in the header, give n_poss_gen_A and
+//       n_poss_gen_X, and add the class to QTLCROSS_HOT_CLASSES in cross_dispatch.h
 //
 // to create a QTLCross instance using a string with cross type:
 //     QTLCross* cross = QTLCross::Create("f2");
@@ -38,6 +42,9 @@
 #include "cross_genail.h"
 #include <string>
 
+// if true, the HMM kernels aren't specialized on the cross class (see cross_dispatch.h)
+bool qtlcross_generic_kernels = false;
+
 QTLCross* QTLCross::Create(const String& crosstype)
 {
     // first, if crosstype has length > 6 and first 6 characters are "genril" or "genail",
@@ -7,6 +7,7 @@
 
 #include <Rcpp.h>
 #include "hmm_estmap2.h"
+#include "hmm_emitmatrix.h"
 #include "r_message.h" // defines RQTL2_NODEBUG
 
 using namespace Rcpp;
@@ -217,32 +218,15 @@ public:
     }
 
 
-    // calculate a vector of emission matrices
-    virtual const std::vector<Rcpp::NumericMatrix> calc_emitmatrix(const double error_prob,
-                                                                   const int max_obsgeno,
-                                                                   const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
-                                                                   const bool is_x_chr, const bool is_female,
-                                                                   const Rcpp::IntegerVector& cross_info)
+    // calculate emission matrices (one for each unique column of founder_geno; see hmm_emitmatrix.h)
+    virtual const EmitMatrices calc_emitmatrix(const double error_prob,
+                                               const int max_obsgeno,
+                                               const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
+                                               const bool is_x_chr, const bool is_female,
+                                               const Rcpp::IntegerVector& cross_info)
     {
-        Rcpp::IntegerVector gen = possible_gen(is_x_chr, is_female, cross_info);
-        const int n_true_gen = gen.size();
-        const int n_obs_gen = max_obsgeno+1;
-
-        const int n_markers = founder_geno.cols();
-
-        std::vector<Rcpp::NumericMatrix> result;
-        for(int i=0; i<n_markers; i++) {
-            Rcpp::NumericMatrix emitmatrix(n_obs_gen, n_true_gen);
-            for(int obs_gen=0; obs_gen<n_obs_gen; obs_gen++) {
-                for(int true_gen=0; true_gen<n_true_gen; true_gen++) {
-                    emitmatrix(obs_gen,true_gen) = emit(obs_gen, gen[true_gen], error_prob,
-                                                        founder_geno(_, i), is_x_chr, is_female, cross_info);
-                }
-            }
-            result.push_back(emitmatrix);
-        }
-
-        return result;
+        return calc_unique_emitmatrices(this, error_prob, max_obsgeno, founder_geno,
+                                        is_x_chr, is_female, cross_info);
     }
 
     // calculate a vector of transition matrices
@@ -297,7 +281,10 @@ public:
                                                const double error_prob,
                                                const int max_iterations,
                                                const double tol,
-                                               const bool verbose)
+                                               const bool verbose,
+                                               const bool scaled_hmm,
+                                               const bool accel_em,
+                                               const int n_threads)
     {
         if(!is_X_chr) { // autosome
             // autosome, ignore the groups provided
@@ -312,7 +299,7 @@ public:
                                     is_X_chr, is_female, cross_info,
                                     one_group, one_unique_group,
                                     rec_frac, error_prob, max_iterations,
-                                    tol, verbose);
+                                    tol, verbose, scaled_hmm, accel_em, n_threads);
         }
 
         return est_map2_grouped(this->crosstype,
@@ -320,7 +307,78 @@ public:
                                 is_X_chr, is_female, cross_info,
                                 cross_group, unique_cross_group,
                                 rec_frac, error_prob, max_iterations,
-                                tol, verbose);
+                                tol, verbose, scaled_hmm, accel_em, n_threads);
+    }
+
+};
+
+
+// intermediate class that each cross type derives from, as in
+//     class F2 final : public QTLCrossT<F2>
+// The calc_* functions here call the cross's own init/emit/step
+// functions directly, rather than through the virtual table. (A cross type
+// may still override them, as DO does for calc_stepmatrix.)
+template<class CrossT>
+class QTLCrossT : public QTLCross
+{
+
+public:
+    virtual ~QTLCrossT(){};
+
+    // calculate emission matrices (one for each unique column of founder_geno; see hmm_emitmatrix.h)
+    virtual const EmitMatrices calc_emitmatrix(const double error_prob,
+                                               const int max_obsgeno,
+                                               const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
+                                               const bool is_x_chr, const bool is_female,
+                                               const Rcpp::IntegerVector& cross_info)
+    {
+        return calc_unique_emitmatrices(static_cast<CrossT*>(this), error_prob, max_obsgeno, founder_geno,
+                                        is_x_chr, is_female, cross_info);
+    }
+
+    // calculate a vector of transition matrices
+    virtual const std::vector<Rcpp::NumericMatrix> calc_stepmatrix(const Rcpp::NumericVector rec_frac,
+                                                                   const bool is_x_chr, const bool is_female,
+                                                                   const Rcpp::IntegerVector& cross_info)
+    {
+        CrossT* cross = static_cast<CrossT*>(this);
+
+        Rcpp::IntegerVector gen = cross->possible_gen(is_x_chr, is_female, cross_info);
+        const int n_gen = gen.size();
+
+        const int n_intervals = rec_frac.size();
+
+        std::vector<Rcpp::NumericMatrix> result;
+        result.reserve(n_intervals);
+        for(int i=0; i<n_intervals; i++) {
+            Rcpp::NumericMatrix stepmatrix(n_gen, n_gen);
+            for(int left=0; left<n_gen; left++) {
+                for(int right=0; right<n_gen; right++) {
+                    stepmatrix(left,right) = cross->step(gen[left], gen[right], rec_frac[i],
+                                                         is_x_chr, is_female, cross_info);
+                }
+            }
+            result.push_back(stepmatrix);
+        }
+
+        return result;
+    }
+
+    // calculate init probabilities
+    virtual const Rcpp::NumericVector calc_initvector(const bool is_x_chr, const bool is_female,
+                                                      const Rcpp::IntegerVector& cross_info)
+    {
+        CrossT* cross = static_cast<CrossT*>(this);
+
+        Rcpp::IntegerVector gen = cross->possible_gen(is_x_chr, is_female, cross_info);
+        const int n_gen = gen.size();
+
+        Rcpp::NumericVector result(n_gen);
+        for(int g=0; g<n_gen; g++) {
+            result[g] = cross->init(gen[g], is_x_chr, is_female, cross_info);
+        }
+
+        return result;
     }
 
 };
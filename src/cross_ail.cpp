@@ -558,7 +558,10 @@ const NumericVector AIL::est_map2(const IntegerMatrix& genotypes,
                                   const double error_prob,
                                   const int max_iterations,
                                   const double tol,
-                                  const bool verbose)
+                                  const bool verbose,
+                                  const bool scaled_hmm,
+                                  const bool accel_em,
+                                  const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for AILs.");
 
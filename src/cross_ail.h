@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class AIL : public QTLCross
+class AIL final : public QTLCrossT<AIL>
 {
  public:
     AIL(){
@@ -54,7 +54,10 @@ class AIL : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
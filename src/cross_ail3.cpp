@@ -5,7 +5,7 @@
 #include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
-#include "cross_util.h" // mpp_encode_alleles and mpp_decode_geno
+#include "cross_util.h" // mpp_geno_table
 #include "r_message.h" // defines RQTL2_NODEBUG and r_message()
 
 enum gen_ail3 {AA=1, AB=2, BB=3, notA=5, notB=4,
@@ -66,7 +66,7 @@ const double AIL3::emit(const int obs_gen, const int true_gen, const double erro
     if(obs_gen==0) return 0.0; // missing
 
     if(!is_x_chr || is_female) { // autosome or female X
-        const IntegerVector true_alleles = mpp_decode_geno(true_gen, 3, false);
+        const std::array<int,2>& true_alleles = mpp_geno_table(3, false).decode(true_gen);
         int f1 = founder_geno[true_alleles[0]-1];
         int f2 = founder_geno[true_alleles[1]-1];
 
@@ -194,8 +194,8 @@ const double AIL3::step(const int gen_left, const int gen_right, const double re
         }
         double R = (1.0 - 3.0*pAA);
 
-        const IntegerVector alleles_left = mpp_decode_geno(gen_left, 3, false);
-        const IntegerVector alleles_right = mpp_decode_geno(gen_right, 3, false);
+        const std::array<int,2>& alleles_left = mpp_geno_table(3, false).decode(gen_left);
+        const std::array<int,2>& alleles_right = mpp_geno_table(3, false).decode(gen_right);
 
         if(alleles_left[0] == alleles_left[1]) { // homozygous
             if(alleles_right[0] == alleles_right[1]) { // homozygous
@@ -408,8 +408,8 @@ const int AIL3::nrec(const int gen_left, const int gen_right,
     }
 
     // otherwise autosome or female X
-    Rcpp::IntegerVector a_left = mpp_decode_geno(gen_left, 3, false);
-    Rcpp::IntegerVector a_right = mpp_decode_geno(gen_right, 3, false);
+    const std::array<int,2>& a_left = mpp_geno_table(3, false).decode(gen_left);
+    const std::array<int,2>& a_right = mpp_geno_table(3, false).decode(gen_right);
 
     if(a_left[0] == a_right[0]) {
         if(a_left[1] == a_right[1]) return(0);
@@ -442,7 +442,10 @@ const NumericVector AIL3::est_map2(const IntegerMatrix& genotypes,
                                    const double error_prob,
                                    const int max_iterations,
                                    const double tol,
-                                   const bool verbose)
+                                   const bool verbose,
+                                   const bool scaled_hmm,
+                                   const bool accel_em,
+                                   const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for 3-way AILs.");
 
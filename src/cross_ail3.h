@@ -7,7 +7,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class AIL3 : public QTLCross
+class AIL3 final : public QTLCrossT<AIL3>
 {
  public:
     AIL3(){
@@ -61,7 +61,10 @@ class AIL3 : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
@@ -5,7 +5,7 @@
 #include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
-#include "cross_util.h" // mpp_encode_alleles and mpp_decode_geno
+#include "cross_util.h" // mpp_geno_table
 #include "r_message.h" // defines RQTL2_NODEBUG and r_message()
 
 enum gen_ail3pk {AA=1, AB=2, BB=3, notA=5, notB=4,
@@ -67,7 +67,7 @@ const double AIL3PK::emit(const int obs_gen, const int true_gen, const double er
     if(obs_gen==0) return 0.0; // missing
 
     if(!is_x_chr || is_female) { // autosome or female X
-        const IntegerVector true_alleles = mpp_decode_geno(true_gen, 3, true);
+        const std::array<int,2>& true_alleles = mpp_geno_table(3, true).decode(true_gen);
         int f1 = founder_geno[true_alleles[0]-1];
         int f2 = founder_geno[true_alleles[1]-1];
 
@@ -191,8 +191,8 @@ const double AIL3PK::step(const int gen_left, const int gen_right, const double
         }
         double R = (1.0 - 3.0*pAA);
 
-        const IntegerVector alleles_left = mpp_decode_geno(gen_left, 3, true);
-        const IntegerVector alleles_right = mpp_decode_geno(gen_right, 3, true);
+        const std::array<int,2>& alleles_left = mpp_geno_table(3, true).decode(gen_left);
+        const std::array<int,2>& alleles_right = mpp_geno_table(3, true).decode(gen_right);
 
         if(alleles_left[0] == alleles_left[1]) { // homozygous
             if(alleles_right[0] == alleles_right[1]) { // homozygous
@@ -283,8 +283,8 @@ const int AIL3PK::nrec(const int gen_left, const int gen_right,
     }
 
     // otherwise autosome or female X
-    Rcpp::IntegerVector a_left = mpp_decode_geno(gen_left, 3, true);
-    Rcpp::IntegerVector a_right = mpp_decode_geno(gen_right, 3, true);
+    const std::array<int,2>& a_left = mpp_geno_table(3, true).decode(gen_left);
+    const std::array<int,2>& a_right = mpp_geno_table(3, true).decode(gen_right);
 
     int result = 0;
     if(a_left[0] != a_right[0]) result++;
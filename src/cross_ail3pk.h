@@ -7,7 +7,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class AIL3PK : public QTLCross
+class AIL3PK final : public QTLCrossT<AIL3PK>
 {
  public:
     AIL3PK(){
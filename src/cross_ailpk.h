@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class AILPK : public QTLCross
+class AILPK final : public QTLCrossT<AILPK>
 {
  public:
     AILPK(){
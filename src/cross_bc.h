@@ -3,12 +3,21 @@
 #ifndef CROSS_BC_H
 #define CROSS_BC_H
 
+#include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
 
-class BC : public QTLCross
+class BC final : public QTLCrossT<BC>
 {
  public:
+    // genotype codes
+    enum gen_bc {AA=1, AB=2, BB=3, AY=3, BY=4};
+
+    // number of possible genotypes for an individual, autosome and X chr
+    // (compile-time constants for the HMM kernels; see cross_dispatch.h)
+    static const int n_poss_gen_A = 2;
+    static const int n_poss_gen_X = 2;
+
     BC(){
         crosstype = "bc";
         phase_known_crosstype = "bc";
@@ -37,4 +46,80 @@ class BC : public QTLCross
 
 };
 
+// check_geno(), init(), emit(), and step() are defined inline, here,
+// so they can be inlined in the HMM kernels (see cross_dispatch.h)
+
+inline const bool BC::check_geno(const int gen, const bool is_observed_value,
+                                 const bool is_x_chr, const bool is_female, const IntegerVector& cross_info)
+{
+    if(is_observed_value && gen==0) return true;
+
+    if(!is_x_chr || (is_x_chr && is_female)) {
+        if(gen != AA && gen != AB) return false;
+    }
+    else { // male X chr
+        if(is_observed_value) {
+            if(gen != AA && gen != BB) return false;
+        }
+        else {
+            if(gen != AY && gen != BY) return false;
+        }
+    }
+
+    return true;
+}
+
+inline const double BC::init(const int true_gen,
+                             const bool is_x_chr, const bool is_female, const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(true_gen, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    return log(0.5);
+}
+
+inline const double BC::emit(const int obs_gen, const int true_gen, const double error_prob,
+                             const IntegerVector& founder_geno, const bool is_x_chr,
+                             const bool is_female, const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(true_gen, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    if(obs_gen==0 || !check_geno(obs_gen, true, is_x_chr, is_female, cross_info))
+        return 0.0; // missing or invalid
+
+    if(is_x_chr && !is_female) { // X chr males different
+        if(obs_gen==AA) {
+            if(true_gen==AY) return log(1.0-error_prob);
+            else return log(error_prob);
+        }
+        else { // BB
+            if(true_gen==BY) return log(1.0-error_prob);
+            else return log(error_prob);
+        }
+    }
+    else { // female or autosome
+        if(obs_gen==true_gen) return log(1.0-error_prob);
+        else return log(error_prob);
+    }
+}
+
+inline const double BC::step(const int gen_left, const int gen_right, const double rec_frac,
+                             const bool is_x_chr, const bool is_female,
+                             const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(gen_left, false, is_x_chr, is_female, cross_info) ||
+       !check_geno(gen_right, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    if(gen_left==gen_right) return log(1.0-rec_frac);
+    else return log(rec_frac);
+}
+
 #endif // CROSS_BC_H
@@ -237,7 +237,10 @@ const NumericVector DH6::est_map2(const IntegerMatrix& genotypes,
                                       const double error_prob,
                                       const int max_iterations,
                                       const double tol,
-                                      const bool verbose)
+                                      const bool verbose,
+                                      const bool scaled_hmm,
+                                      const bool accel_em,
+                                      const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for 6-way doubled haploids.");
 
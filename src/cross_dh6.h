@@ -7,7 +7,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class DH6 : public QTLCross
+class DH6 final : public QTLCrossT<DH6>
 {
  public:
     DH6(){
@@ -59,7 +59,10 @@ class DH6 : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
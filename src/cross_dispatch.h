@@ -0,0 +1,75 @@
+// dispatch from a QTLCross* to code templated on the concrete cross class
+//
+// For the simple crosses in QTLCROSS_HOT_CLASSES, each class is final and
+// defines init(), emit(), and step() inline in its header, and it gives the
+// number of possible genotypes for an individual as compile-time constants
+// (n_poss_gen_A and n_poss_gen_X). Within a kernel instantiated for such a
+// class, those calls are bound and inlined, and the loops over genotypes have
+// fixed length. Other crosses use the generic kernel, Kernel<QTLCross, 0>, with
+// virtual calls and the number of genotypes determined at run time.
+//
+// Use as
+//     template<class CrossT, int N> struct my_kernel {
+//         static NumericMatrix run(CrossT* cross, const bool is_X_chr, ...) { ... }
+//     };
+//     NumericMatrix result = dispatch_cross<my_kernel>(cross, is_X_chr, ...);
+
+#ifndef CROSS_DISPATCH_H
+#define CROSS_DISPATCH_H
+
+#include <typeinfo>
+#include <utility>
+#include "cross.h"
+#include "cross_bc.h"
+#include "cross_f2.h"
+#include "cross_f2pk.h"
+#include "cross_risib.h"
+#include "cross_riself.h"
+#include "cross_dh.h"
+#include "cross_haploid.h"
+
+// cross classes with specialized HMM kernels
+#define QTLCROSS_HOT_CLASSES(X) \
+    X(BC) X(F2) X(F2PK) X(RISIB) X(RISELF) X(DH) X(HAPLOID)
+
+// if true, always use the generic kernels (for testing; see test_hmm.cpp)
+extern bool qtlcross_generic_kernels;
+
+// number of possible genotypes in kernel: N if > 0, otherwise n_poss_gen
+inline int kernel_n_poss_gen(const int N, const int n_poss_gen)
+{
+    #ifndef RQTL2_NODEBUG
+    if(N > 0 && N != n_poss_gen)
+        throw std::range_error("number of possible genotypes doesn't match cross class");
+    #endif
+
+    return (N > 0 ? N : n_poss_gen);
+}
+
+// call Kernel<CrossT, N>::run(cross, is_X_chr, args...) with CrossT the class of *cross
+// and N the number of possible genotypes, or Kernel<QTLCross, 0> if not a hot class
+template<template<class, int> class Kernel, class... Args>
+auto dispatch_cross(QTLCross* cross, const bool is_X_chr, Args&&... args)
+    -> decltype(Kernel<QTLCross, 0>::run(cross, is_X_chr, std::forward<Args>(args)...))
+{
+    if(!qtlcross_generic_kernels) {
+#define QTLCROSS_DISPATCH_CASE(CLASS)                                             \
+        if(typeid(*cross) == typeid(CLASS)) {                                     \
+            CLASS* c = static_cast<CLASS*>(cross);                                \
+            if(is_X_chr)                                                          \
+                return Kernel<CLASS, CLASS::n_poss_gen_X>::run(c, is_X_chr,       \
+                                                               std::forward<Args>(args)...); \
+            else                                                                  \
+                return Kernel<CLASS, CLASS::n_poss_gen_A>::run(c, is_X_chr,       \
+                                                               std::forward<Args>(args)...); \
+        }
+
+        QTLCROSS_HOT_CLASSES(QTLCROSS_DISPATCH_CASE)
+
+#undef QTLCROSS_DISPATCH_CASE
+    }
+
+    return Kernel<QTLCross, 0>::run(cross, is_X_chr, std::forward<Args>(args)...);
+}
+
+#endif // CROSS_DISPATCH_H
@@ -145,6 +145,38 @@ double ri4way_malX_hapCC(double r, int k)
 // 2. Probability of recombinant haplotypes in DO
 //////////////////////////////////////////////////////////////////////
 
+/**********************************************************************
+ * info about the pre-CC progenitors of the DO: the generations
+ * (precc_gen) and the proportion of mice at each (precc_alpha)
+ *
+ * HS is treated like DO with the "preCC" founders all at generation 1
+ **********************************************************************/
+const IntegerVector& DO_precc_gen()
+{
+    const static IntegerVector precc_gen = IntegerVector::create(4,5,6,7,8,9,10,11,12);
+    return precc_gen;
+}
+
+const NumericVector& DO_precc_alpha()
+{
+    const static NumericVector precc_alpha =
+        NumericVector::create(21.0/144.0, 64.0/144.0, 24.0/144.0, 10.0/144.0, 5.0/144.0,
+                               9.0/144.0,  5.0/144.0,  3.0/144.0,  3.0/144.0);
+    return precc_alpha;
+}
+
+const IntegerVector& HS_precc_gen()
+{
+    const static IntegerVector precc_gen = IntegerVector::create(1);
+    return precc_gen;
+}
+
+const NumericVector& HS_precc_alpha()
+{
+    const static NumericVector precc_alpha = NumericVector::create(1.0);
+    return precc_alpha;
+}
+
 /**********************************************************************
  * probability of recombinant haplotype on autosome at generation s
  * of the diversity outcross population, where at generation 1 the
@@ -333,8 +365,8 @@ const double DOstep_auto(int left, int right, double r, int s,
     #endif
 
     // pull out alleles for left and right loci
-    IntegerVector leftv = mpp_decode_geno(left, 8, false);
-    IntegerVector rightv = mpp_decode_geno(right, 8, false);
+    const std::array<int,2>& leftv = mpp_geno_table(8, false).decode(left);
+    const std::array<int,2>& rightv = mpp_geno_table(8, false).decode(right);
     int left1 = leftv[0];
     int left2 = leftv[1];
     int right1 = rightv[0];
@@ -399,8 +431,8 @@ const double DOstep_femX(int left, int right, double r, int s,
     #endif
 
     // pull out alleles for left and right loci
-    IntegerVector leftv = mpp_decode_geno(left, 8, false);
-    IntegerVector rightv = mpp_decode_geno(right, 8, false);
+    const std::array<int,2>& leftv = mpp_geno_table(8, false).decode(left);
+    const std::array<int,2>& rightv = mpp_geno_table(8, false).decode(right);
     int left1 = leftv[0];
     int left2 = leftv[1];
     int right1 = rightv[0];
@@ -494,8 +526,8 @@ const double DOPKstep_auto(int left, int right, double r, int s,
     #endif
 
     // pull out alleles for left and right loci
-    IntegerVector leftv = mpp_decode_geno(left, 8, true);
-    IntegerVector rightv = mpp_decode_geno(right, 8, true);
+    const std::array<int,2>& leftv = mpp_geno_table(8, true).decode(left);
+    const std::array<int,2>& rightv = mpp_geno_table(8, true).decode(right);
     int left1 = leftv[0];
     int left2 = leftv[1];
     int right1 = rightv[0];
@@ -563,8 +595,8 @@ const double DOPKstep_femX(int left, int right, double r, int s,
     #endif
 
     // pull out alleles for left and right loci
-    IntegerVector leftv = mpp_decode_geno(left, 8, true);
-    IntegerVector rightv = mpp_decode_geno(right, 8, true);
+    const std::array<int,2>& leftv = mpp_geno_table(8, true).decode(left);
+    const std::array<int,2>& rightv = mpp_geno_table(8, true).decode(right);
     int left1 = leftv[0];
     int left2 = leftv[1];
     int right1 = rightv[0];
@@ -637,3 +669,161 @@ const double DOPKstep_malX(int left, int right, double r, int s,
     if(left == right) return log(1.0 - recprob);
     return log(recprob) - log(7.0);
 }
+
+// probability of recombinant haplotype for DO, on autosome, female X, or male X
+double DOrec(double r, int s, bool is_x_chr, bool is_female,
+             IntegerVector precc_gen, NumericVector precc_alpha)
+{
+    if(is_x_chr) {
+        if(is_female) return DOrec_femX(r, s, precc_gen, precc_alpha);
+        else return DOrec_malX(r, s, precc_gen, precc_alpha);
+    }
+    return DOrec_auto(r, s, precc_gen, precc_alpha);
+}
+
+/**********************************************************************
+ * class of a pair of genotypes (left, right) for DO transition
+ * probabilities, autosome or female X
+ *
+ * The transition probability depends only on this class and on the
+ * probability of a recombinant haplotype:
+ *
+ *   0 AA -> AA     4 AB -> AA     8 AB -> CD
+ *   1 AA -> BB     5 AB -> CC     9 AB -> BA  (phase-known only)
+ *   2 AA -> AB     6 AB -> AB    10 AB -> CA  (phase-known only)
+ *   3 AA -> BC     7 AB -> AC
+ **********************************************************************/
+int DOstep_class(int left, int right, bool phase_known)
+{
+    // pull out alleles for left and right loci
+    const std::array<int,2>& leftv = mpp_geno_table(8, phase_known).decode(left);
+    const std::array<int,2>& rightv = mpp_geno_table(8, phase_known).decode(right);
+    int left1 = leftv[0];
+    int left2 = leftv[1];
+    int right1 = rightv[0];
+    int right2 = rightv[1];
+
+    if(left1 == left2) { // AA ->
+        if(right1 == right2) {
+            if(left1 == right1) return 0; // AA -> AA
+            else return 1;                // AA -> BB
+        }
+        else {
+            if(left1 == right1 || left1 == right2) return 2; // AA -> AB
+            else return 3;                                   // AA -> BC
+        }
+    }
+    else { // AB ->
+        if(right1 == right2) {
+            if(left1 == right1 || left2 == right1) return 4; // AB -> AA
+            else return 5;                                   // AB -> CC
+        }
+        else if(phase_known) {
+            if(left1==right1 && left2==right2) return 6;           // AB -> AB
+            else if(left1==right2 && left2==right1) return 9;      // AB -> BA
+            else if(left1==right1 || left2==right2) return 7;      // AB -> AC
+            else if(left2==right1 || left2==right2) return 10;     // AB -> CA
+            else return 8;                                         // AB -> CD
+        }
+        else {
+            if((left1==right1 && left2==right2) ||
+               (left1==right2 && left2==right1)) return 6;         // AB -> AB
+            else if(left1==right1 || left1==right2 ||
+                    left2==right1 || left2==right2) return 7;      // AB -> AC
+            else return 8;                                         // AB -> CD
+        }
+    }
+}
+
+// log transition probability for each class in DOstep_class(),
+// given the probability of a recombinant haplotype
+std::vector<double> DOstep_classvalues(double recprob, bool phase_known)
+{
+    const double log_r = log(recprob);
+    const double log_1mr = log(1.0 - recprob);
+    const double log7 = log(7.0);
+    const double log49 = log(49.0);
+
+    std::vector<double> result(11);
+
+    if(phase_known) {
+        result[0] = 2.0*log_1mr;             // AA -> AA
+        result[1] = 2.0*log_r - log49;       // AA -> BB
+        result[2] = log_r + log_1mr - log7;  // AA -> AB
+        result[3] = 2.0*log_r - log49;       // AA -> BC
+        result[4] = log_r + log_1mr - log7;  // AB -> AA
+        result[5] = 2.0*log_r - log49;       // AB -> CC
+        result[6] = 2.0*log_1mr;             // AB -> AB
+        result[7] = log_r + log_1mr - log7;  // AB -> AC
+        result[8] = 2.0*log_r - log49;       // AB -> CD
+        result[9] = 2.0*log_r - log49;       // AB -> BA
+        result[10] = 2.0*log_r - log49;      // AB -> CA
+    }
+    else {
+        result[0] = 2.0*log_1mr;                    // AA -> AA
+        result[1] = 2.0*log_r - log49;              // AA -> BB
+        result[2] = log(2.0) + log_r + log_1mr - log7; // AA -> AB
+        result[3] = 2.0*log_r + log(2.0) - log49;   // AA -> BC
+        result[4] = log_r + log_1mr - log7;         // AB -> AA
+        result[5] = 2.0*log_r - log49;              // AB -> CC
+        result[6] = log(recprob*recprob/49.0 + (1.0-recprob)*(1.0-recprob)); // AB -> AB
+        result[7] = log(recprob*(1.0-recprob)/7.0 + recprob*recprob/49.0);  // AB -> AC
+        result[8] = 2.0*log_r + log(2.0) - log49;   // AB -> CD
+        result[9] = result[10] = NA_REAL;           // not used
+    }
+
+    return result;
+}
+
+/**********************************************************************
+ * transition matrices for DO-type crosses (DO, DOPK, HS, HSPK, DOF1, HSF1)
+ *
+ * rec_frac = recombination fractions, one per interval
+ * s = generation of DO
+ * gen = possible genotypes
+ * one_allele = if true, the genotype is a single founder allele (male X,
+ *              or DOF1/HSF1), and the transition probability just depends
+ *              on whether left == right
+ *
+ * The probability of a recombinant haplotype is calculated once per
+ * interval, and the pairs of genotypes are classified just once.
+ **********************************************************************/
+std::vector<NumericMatrix> DO_calc_stepmatrix(const NumericVector& rec_frac,
+                                              const bool is_x_chr, const bool is_female,
+                                              const int s, const IntegerVector& gen,
+                                              const IntegerVector& precc_gen,
+                                              const NumericVector& precc_alpha,
+                                              const bool phase_known,
+                                              const bool one_allele)
+{
+    const int n_gen = gen.size();
+    const int n_intervals = rec_frac.size();
+
+    // class of each pair of genotypes
+    std::vector<int> step_class(n_gen*n_gen);
+    for(int right=0; right<n_gen; right++) {
+        for(int left=0; left<n_gen; left++) {
+            if(one_allele) step_class[left + right*n_gen] = (gen[left]==gen[right] ? 0 : 1);
+            else step_class[left + right*n_gen] = DOstep_class(gen[left], gen[right], phase_known);
+        }
+    }
+
+    std::vector<NumericMatrix> result;
+    for(int i=0; i<n_intervals; i++) {
+        double recprob = DOrec(rec_frac[i], s, is_x_chr, is_female, precc_gen, precc_alpha);
+
+        std::vector<double> values(2);
+        if(one_allele) {
+            values[0] = log(1.0 - recprob);
+            values[1] = log(recprob) - log(7.0);
+        }
+        else values = DOstep_classvalues(recprob, phase_known);
+
+        NumericMatrix stepmatrix(n_gen, n_gen);
+        for(int j=0; j<n_gen*n_gen; j++)
+            stepmatrix[j] = values[step_class[j]];
+        result.push_back(stepmatrix);
+    }
+
+    return result;
+}
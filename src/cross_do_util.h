@@ -58,6 +58,17 @@ double ri4way_malX_hapCC(double r, int k);
 // 2. Probability of recombinant haplotypes in DO
 //////////////////////////////////////////////////////////////////////
 
+/**********************************************************************
+ * info about the pre-CC progenitors of the DO: the generations
+ * (precc_gen) and the proportion of mice at each (precc_alpha)
+ *
+ * HS is treated like DO with the "preCC" founders all at generation 1
+ **********************************************************************/
+const Rcpp::IntegerVector& DO_precc_gen();
+const Rcpp::NumericVector& DO_precc_alpha();
+const Rcpp::IntegerVector& HS_precc_gen();
+const Rcpp::NumericVector& HS_precc_alpha();
+
 /**********************************************************************
  * probability of recombinant haplotype on autosome at generation s
  * of the diversity outcross population, where at generation 1 the
@@ -154,4 +165,47 @@ const double DOPKstep_femX(int left, int right, double r, int s,
 const double DOPKstep_malX(int left, int right, double r, int s,
                            Rcpp::IntegerVector precc_gen, Rcpp::NumericVector precc_alpha);
 
+// probability of recombinant haplotype for DO, on autosome, female X, or male X
+double DOrec(double r, int s, bool is_x_chr, bool is_female,
+             Rcpp::IntegerVector precc_gen, Rcpp::NumericVector precc_alpha);
+
+/**********************************************************************
+ * class of a pair of genotypes (left, right) for DO transition
+ * probabilities, autosome or female X
+ *
+ * The transition probability depends only on this class and on the
+ * probability of a recombinant haplotype:
+ *
+ *   0 AA -> AA     4 AB -> AA     8 AB -> CD
+ *   1 AA -> BB     5 AB -> CC     9 AB -> BA  (phase-known only)
+ *   2 AA -> AB     6 AB -> AB    10 AB -> CA  (phase-known only)
+ *   3 AA -> BC     7 AB -> AC
+ **********************************************************************/
+int DOstep_class(int left, int right, bool phase_known);
+
+// log transition probability for each class in DOstep_class(),
+// given the probability of a recombinant haplotype
+std::vector<double> DOstep_classvalues(double recprob, bool phase_known);
+
+/**********************************************************************
+ * transition matrices for DO-type crosses (DO, DOPK, HS, HSPK, DOF1, HSF1)
+ *
+ * rec_frac = recombination fractions, one per interval
+ * s = generation of DO
+ * gen = possible genotypes
+ * one_allele = if true, the genotype is a single founder allele (male X,
+ *              or DOF1/HSF1), and the transition probability just depends
+ *              on whether left == right
+ *
+ * The probability of a recombinant haplotype is calculated once per
+ * interval, and the pairs of genotypes are classified just once.
+ **********************************************************************/
+std::vector<Rcpp::NumericMatrix> DO_calc_stepmatrix(const Rcpp::NumericVector& rec_frac,
+                                                    const bool is_x_chr, const bool is_female,
+                                                    const int s, const Rcpp::IntegerVector& gen,
+                                                    const Rcpp::IntegerVector& precc_gen,
+                                                    const Rcpp::NumericVector& precc_alpha,
+                                                    const bool phase_known,
+                                                    const bool one_allele);
+
 #endif // CROSS_DO_UTIL_H
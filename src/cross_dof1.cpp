@@ -131,10 +131,8 @@ const double DOF1::step(const int gen_left, const int gen_right, const double re
     #endif
 
     // info about preCC progenitors
-    const static IntegerVector precc_gen = IntegerVector::create(4,5,6,7,8,9,10,11,12);
-    const static NumericVector precc_alpha =
-        NumericVector::create(21.0/144.0, 64.0/144.0, 24.0/144.0, 10.0/144.0, 5.0/144.0,
-                               9.0/144.0,  5.0/144.0,  3.0/144.0,  3.0/144.0);
+    const IntegerVector& precc_gen = DO_precc_gen();
+    const NumericVector& precc_alpha = DO_precc_alpha();
 
     // no. generations for this mouse
     int n_gen = cross_info[0];
@@ -156,6 +154,25 @@ const double DOF1::step(const int gen_left, const int gen_right, const double re
     else return(log(r)-log(7.0));
 }
 
+// transition matrices for a set of intervals
+// (probability of recombinant haplotype calculated just once per interval)
+const std::vector<NumericMatrix> DOF1::calc_stepmatrix(const NumericVector rec_frac,
+                                                       const bool is_x_chr, const bool is_female,
+                                                       const IntegerVector& cross_info)
+{
+    // info about preCC progenitors
+    const IntegerVector& precc_gen = DO_precc_gen();
+    const NumericVector& precc_alpha = DO_precc_alpha();
+
+    // no. generations for this mouse
+    int n_gen = cross_info[0];
+
+    IntegerVector gen = possible_gen(is_x_chr, is_female, cross_info);
+
+    return DO_calc_stepmatrix(rec_frac, is_x_chr, is_female, n_gen, gen,
+                              precc_gen, precc_alpha, false, true);
+}
+
 const IntegerVector DOF1::possible_gen(const bool is_x_chr, const bool is_female,
                                        const IntegerVector& cross_info)
 {
@@ -331,7 +348,10 @@ const NumericVector DOF1::est_map2(const IntegerMatrix& genotypes,
                                    const double error_prob,
                                    const int max_iterations,
                                    const double tol,
-                                   const bool verbose)
+                                   const bool verbose,
+                                   const bool scaled_hmm,
+                                   const bool accel_em,
+                                   const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for DO F1s.");
 
@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class DOPK : public QTLCross
+class DOPK final : public QTLCrossT<DOPK>
 {
  public:
     DOPK(){
@@ -26,6 +26,10 @@ class DOPK : public QTLCross
     const double step(const int gen_left, const int gen_right, const double rec_frac,
                       const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
+    const std::vector<Rcpp::NumericMatrix> calc_stepmatrix(const Rcpp::NumericVector rec_frac,
+                                                           const bool is_x_chr, const bool is_female,
+                                                           const Rcpp::IntegerVector& cross_info);
+
     const Rcpp::IntegerVector possible_gen(const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
     const int ngen(const bool is_x_chr);
@@ -3,12 +3,23 @@
 #ifndef CROSS_F2PK_H
 #define CROSS_F2PK_H
 
+#include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
 
-class F2PK : public QTLCross
+class F2PK final : public QTLCrossT<F2PK>
 {
  public:
+    // genotype codes
+    enum gen_f2pk {AA=1, AB=2, BA=3, BB=4,
+                   A=1, H=2, B=3, notB=4, notA=5,
+                   AY=5, BY=6};
+
+    // number of possible genotypes for an individual, autosome and X chr
+    // (compile-time constants for the HMM kernels; see cross_dispatch.h)
+    static const int n_poss_gen_A = 4;
+    static const int n_poss_gen_X = 2;
+
     F2PK(){
         crosstype = "f2pk";
         phase_known_crosstype = "f2pk";
@@ -50,4 +61,168 @@ class F2PK : public QTLCross
 
 };
 
+// check_geno(), init(), emit(), and step() are defined inline, here,
+// so they can be inlined in the HMM kernels (see cross_dispatch.h)
+
+inline const bool F2PK::check_geno(const int gen, const bool is_observed_value,
+                                   const bool is_x_chr, const bool is_female, const IntegerVector& cross_info)
+{
+    // allow any value 0-5 or observed
+    if(is_observed_value) {
+        if(gen==0 || gen==A || gen==H || gen==B ||
+           gen==notA || gen==notB) return true;
+        else return false;
+    }
+
+    if(is_x_chr) {
+        bool forward_direction = (cross_info[0]==0);
+        if(is_female) {
+            if(forward_direction && (gen==AA || gen==AB)) return true;
+            if(!forward_direction && (gen==BA || gen==BB)) return true;
+        }
+        else if(gen==AY || gen==BY) return true;
+    }
+    else { // autosome
+        if(gen==AA || gen==AB || gen==BA || gen==BB) return true;
+    }
+
+    return false; // invalid
+}
+
+inline const double F2PK::init(const int true_gen,
+                               const bool is_x_chr, const bool is_female,
+                               const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(true_gen, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    if(is_x_chr) return log(0.5);
+    else return log(0.25);
+}
+
+inline const double F2PK::emit(const int obs_gen, const int true_gen, const double error_prob,
+                               const IntegerVector& founder_geno, const bool is_x_chr,
+                               const bool is_female, const IntegerVector& cross_info)
+{
+
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(true_gen, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    if(obs_gen==0 || !check_geno(obs_gen, true, is_x_chr, is_female, cross_info))
+        return 0.0; // missing or invalid
+
+    if(is_x_chr) {
+        if(is_female) {
+            bool is_forward_direction = (cross_info[0] == 0);
+            if(is_forward_direction) {
+                if(true_gen==AA) {
+                    if(obs_gen==A) return log(1.0-error_prob);
+                    if(obs_gen==H || obs_gen==notA) return log(error_prob);
+                    return 0.0; // treat everything else as NA
+                }
+                if(true_gen==AB) {
+                    if(obs_gen==H || obs_gen==notA) return log(1.0-error_prob);
+                    if(obs_gen==A) return log(error_prob);
+                    return 0.0; // treat everything else as NA
+                }
+            }
+            else {
+                if(true_gen==BA) {
+                    if(obs_gen==H || obs_gen==notB) return log(1.0-error_prob);
+                    if(obs_gen==B) return log(error_prob);
+                    return 0.0; // treat everything else as NA
+                }
+                if(true_gen==BB) {
+                    if(obs_gen==B) return log(1.0-error_prob);
+                    if(obs_gen==H || obs_gen==notB) return log(error_prob);
+                    return 0.0; // treat everything else as NA
+                }
+            }
+        }
+        else { // males
+            if(true_gen==AY) {
+                if(obs_gen==A || obs_gen==notB) return log(1.0-error_prob);
+                if(obs_gen==B || obs_gen==notA) return log(error_prob);
+                return 0.0; // treat everything else as NA
+            }
+            else { // BY
+                if(obs_gen==B || obs_gen==notA) return log(1.0-error_prob);
+                if(obs_gen==A || obs_gen==notB) return log(error_prob);
+                return 0.0; // treat everything else as NA
+            }
+        }
+    }
+    else { // autosome
+        if(true_gen==AA) {
+            if(obs_gen==A) return log(1.0-error_prob);
+            if(obs_gen==H || obs_gen==B) return log(error_prob/2.0);
+            if(obs_gen==notB) return log(1.0-error_prob/2.0);
+            if(obs_gen==notA) return log(error_prob);
+        }
+        else if(true_gen == AB || true_gen==BA) {
+            if(obs_gen==H) return log(1.0-error_prob);
+            if(obs_gen==A || obs_gen==B) return log(error_prob/2.0);
+            if(obs_gen==notB || obs_gen==notA) return log(1.0-error_prob/2.0);
+        }
+        else { // BB
+            if(obs_gen==B) return log(1.0-error_prob);
+            if(obs_gen==H || obs_gen==A) return log(error_prob/2.0);
+            if(obs_gen==notA) return log(1.0-error_prob/2.0);
+            if(obs_gen==notB) return log(error_prob);
+        }
+    }
+
+    return NA_REAL; // shouldn't get here
+}
+
+inline const double F2PK::step(const int gen_left, const int gen_right, const double rec_frac,
+                               const bool is_x_chr, const bool is_female,
+                               const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(gen_left, false, is_x_chr, is_female, cross_info) ||
+       !check_geno(gen_right, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    if(is_x_chr) {
+        if(gen_left == gen_right) return log(1.0-rec_frac);
+        else return log(rec_frac);
+    }
+    else { // autosome
+        switch(gen_left) {
+        case AA:
+            switch(gen_right) {
+            case AA: return 2.0*log(1.0-rec_frac);
+            case AB: case BA: return log(1.0-rec_frac)+log(rec_frac);
+            case BB: return 2.0*log(rec_frac);
+            }
+        case AB:
+            switch(gen_right) {
+            case AA: case BB: return log(rec_frac)+log(1.0-rec_frac);
+            case AB: return log((1.0-rec_frac)*(1.0-rec_frac));
+            case BA: return log(rec_frac*rec_frac);
+            }
+        case BA:
+            switch(gen_right) {
+            case AA: case BB: return log(rec_frac)+log(1.0-rec_frac);
+            case AB: return log(rec_frac*rec_frac);
+            case BA: return log((1.0-rec_frac)*(1.0-rec_frac));
+            }
+        case BB:
+            switch(gen_right) {
+            case AA: return 2.0*log(rec_frac);
+            case AB: case BA: return log(1.0-rec_frac)+log(rec_frac);
+            case BB: return 2.0*log(1.0-rec_frac);
+            }
+        }
+    }
+
+    return NA_REAL; // shouldn't get here
+}
+
 #endif // CROSS_F2PK_H
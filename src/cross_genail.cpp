@@ -55,7 +55,7 @@ const double GENAIL::init(const int true_gen,
         return log((double)cross_info[true_gen-n_auto_geno]) - log((double)denom);
     }
     else { // autosome or female X
-        const IntegerVector alleles = mpp_decode_geno(true_gen, this->n_founders, false);
+        const std::array<int,2>& alleles = mpp_geno_table(this->n_founders, false).decode(true_gen);
 
         if(mpp_is_het(true_gen, this->n_founders, false)) {
             return log(2.0) + log((double)cross_info[alleles[0]]) +
@@ -82,7 +82,7 @@ const double GENAIL::emit(const int obs_gen, const int true_gen, const double er
     const int n_auto_geno = this->ngen(false);
 
     if(!is_x_chr || is_female) { // autosome or female X
-        const IntegerVector true_alleles = mpp_decode_geno(true_gen, this->n_founders, false);
+        const std::array<int,2>& true_alleles = mpp_geno_table(this->n_founders, false).decode(true_gen);
         int f1 = founder_geno[true_alleles[0]-1];
         int f2 = founder_geno[true_alleles[1]-1];
 
@@ -185,8 +185,8 @@ const double GENAIL::step(const int gen_left, const int gen_right, const double
     }
     else { // autosome or female X
 
-        const IntegerVector leftg = mpp_decode_geno(gen_left, this->n_founders, false);
-        const IntegerVector rightg = mpp_decode_geno(gen_right, this->n_founders, false);
+        const std::array<int,2>& leftg = mpp_geno_table(this->n_founders, false).decode(gen_left);
+        const std::array<int,2>& rightg = mpp_geno_table(this->n_founders, false).decode(gen_right);
 
         const int left1 = leftg[0];
         const int left2 = leftg[1];
@@ -386,8 +386,8 @@ const int GENAIL::nrec(const int gen_left, const int gen_right,
         else return(1);
     }
 
-    Rcpp::IntegerVector a_left = mpp_decode_geno(gen_left, this->n_founders, false);
-    Rcpp::IntegerVector a_right = mpp_decode_geno(gen_right, this->n_founders, false);
+    const std::array<int,2>& a_left = mpp_geno_table(this->n_founders, false).decode(gen_left);
+    const std::array<int,2>& a_right = mpp_geno_table(this->n_founders, false).decode(gen_right);
 
     if(a_left[0] == a_right[0]) {
         if(a_left[1] == a_right[1]) return(0);
@@ -425,7 +425,10 @@ const NumericVector GENAIL::est_map2(const IntegerMatrix& genotypes,
                                       const double error_prob,
                                       const int max_iterations,
                                       const double tol,
-                                      const bool verbose)
+                                      const bool verbose,
+                                      const bool scaled_hmm,
+                                      const bool accel_em,
+                                      const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for general RIL.");
 
@@ -445,7 +448,7 @@ const NumericMatrix GENAIL::geno2allele_matrix(const bool is_x_chr)
         NumericMatrix result(n_geno+n_alleles, n_alleles);
         // female X
         for(int trueg=0; trueg<n_geno; trueg++) {
-            IntegerVector alleles = mpp_decode_geno(trueg+1, n_alleles, false);
+            const std::array<int,2>& alleles = mpp_geno_table(n_alleles, false).decode(trueg+1);
             result(trueg,alleles[0]-1) += 0.5;
             result(trueg,alleles[1]-1) += 0.5;
         }
@@ -459,7 +462,7 @@ const NumericMatrix GENAIL::geno2allele_matrix(const bool is_x_chr)
         NumericMatrix result(n_geno,n_alleles);
 
         for(int trueg=0; trueg<n_geno; trueg++) {
-            IntegerVector alleles = mpp_decode_geno(trueg+1, n_alleles, false);
+            const std::array<int,2>& alleles = mpp_geno_table(n_alleles, false).decode(trueg+1);
             result(trueg,alleles[0]-1) += 0.5;
             result(trueg,alleles[1]-1) += 0.5;
         }
@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class GENAIL : public QTLCross
+class GENAIL final : public QTLCrossT<GENAIL>
 {
  public:
     int n_founders;
@@ -66,7 +66,10 @@ class GENAIL : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
@@ -239,7 +239,10 @@ const NumericVector GENRIL::est_map2(const IntegerMatrix& genotypes,
                                       const double error_prob,
                                       const int max_iterations,
                                       const double tol,
-                                      const bool verbose)
+                                      const bool verbose,
+                                      const bool scaled_hmm,
+                                      const bool accel_em,
+                                      const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for general RIL.");
 
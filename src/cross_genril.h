@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class GENRIL : public QTLCross
+class GENRIL final : public QTLCrossT<GENRIL>
 {
  public:
     int n_founders;
@@ -64,7 +64,10 @@ class GENRIL : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
@@ -6,9 +6,14 @@
 #include "cross.h"
 #include "r_message.h"
 
-class HAPLOID : public QTLCross
+class HAPLOID final : public QTLCrossT<HAPLOID>
 {
  public:
+    // number of possible genotypes for an individual, autosome and X chr
+    // (compile-time constants for the HMM kernels; see cross_dispatch.h)
+    static const int n_poss_gen_A = 2;
+    static const int n_poss_gen_X = 2;
+
     HAPLOID(){
         crosstype = "haploid";
         phase_known_crosstype = "haploid";
@@ -64,7 +64,7 @@ const double HS::emit(const int obs_gen, const int true_gen, const double error_
     if(obs_gen==0) return 0.0; // missing
 
     if(!is_x_chr || is_female) { // autosome or female X
-        const IntegerVector true_alleles = mpp_decode_geno(true_gen, 8, false);
+        const std::array<int,2>& true_alleles = mpp_geno_table(8, false).decode(true_gen);
         int f1 = founder_geno[true_alleles[0]-1];
         int f2 = founder_geno[true_alleles[1]-1];
 
@@ -157,9 +157,8 @@ const double HS::step(const int gen_left, const int gen_right, const double rec_
     #endif
 
     // can treat HS like DO where "preCC" founders all at generation 1
-    const static IntegerVector precc_gen = IntegerVector::create(1);
-    const static NumericVector precc_alpha =
-        NumericVector::create(1.0);
+    const IntegerVector& precc_gen = HS_precc_gen();
+    const NumericVector& precc_alpha = HS_precc_alpha();
 
     // no. generations for this mouse
     int n_gen = cross_info[0];
@@ -182,6 +181,25 @@ const double HS::step(const int gen_left, const int gen_right, const double rec_
     return NA_REAL; // shouldn't get here
 }
 
+// transition matrices for a set of intervals
+// (probability of recombinant haplotype calculated just once per interval)
+const std::vector<NumericMatrix> HS::calc_stepmatrix(const NumericVector rec_frac,
+                                                     const bool is_x_chr, const bool is_female,
+                                                     const IntegerVector& cross_info)
+{
+    // can treat HS like DO where "preCC" founders all at generation 1
+    const IntegerVector& precc_gen = HS_precc_gen();
+    const NumericVector& precc_alpha = HS_precc_alpha();
+
+    // no. generations for this mouse
+    int n_gen = cross_info[0];
+
+    IntegerVector gen = possible_gen(is_x_chr, is_female, cross_info);
+
+    return DO_calc_stepmatrix(rec_frac, is_x_chr, is_female, n_gen, gen,
+                              precc_gen, precc_alpha, false, is_x_chr && !is_female);
+}
+
 const IntegerVector HS::possible_gen(const bool is_x_chr, const bool is_female,
                                      const IntegerVector& cross_info)
 {
@@ -225,7 +243,7 @@ const NumericMatrix HS::geno2allele_matrix(const bool is_x_chr)
         NumericMatrix result(n_geno+n_alleles, n_alleles);
         // female X
         for(int trueg=0; trueg<n_geno; trueg++) {
-            IntegerVector alleles = mpp_decode_geno(trueg+1, 8, false);
+            const std::array<int,2>& alleles = mpp_geno_table(8, false).decode(trueg+1);
             result(trueg,alleles[0]-1) += 0.5;
             result(trueg,alleles[1]-1) += 0.5;
         }
@@ -239,7 +257,7 @@ const NumericMatrix HS::geno2allele_matrix(const bool is_x_chr)
         NumericMatrix result(n_geno,n_alleles);
 
         for(int trueg=0; trueg<n_geno; trueg++) {
-            IntegerVector alleles = mpp_decode_geno(trueg+1, 8, false);
+            const std::array<int,2>& alleles = mpp_geno_table(8, false).decode(trueg+1);
             result(trueg,alleles[0]-1) += 0.5;
             result(trueg,alleles[1]-1) += 0.5;
         }
@@ -365,7 +383,7 @@ const std::vector<std::string> HS::geno_names(const std::vector<std::string> all
     if(is_x_chr) {
         std::vector<std::string> result(44);
         for(int i=0; i<36; i++) {
-            IntegerVector allele_int = mpp_decode_geno(i+1, 8, false);
+            const std::array<int,2>& allele_int = mpp_geno_table(8, false).decode(i+1);
             result[i] = alleles[allele_int[0]-1] + alleles[allele_int[1]-1];
         }
         for(int i=0; i<8; i++) {
@@ -377,7 +395,7 @@ const std::vector<std::string> HS::geno_names(const std::vector<std::string> all
     else {
         std::vector<std::string> result(36);
         for(int i=0; i<36; i++) {
-            IntegerVector allele_int = mpp_decode_geno(i+1, 8, false);
+            const std::array<int,2>& allele_int = mpp_geno_table(8, false).decode(i+1);
             result[i] = alleles[allele_int[0]-1] + alleles[allele_int[1]-1];
         }
         return result;
@@ -400,8 +418,8 @@ const int HS::nrec(const int gen_left, const int gen_right,
         else return(1);
     }
 
-    Rcpp::IntegerVector a_left = mpp_decode_geno(gen_left, 8, false);
-    Rcpp::IntegerVector a_right = mpp_decode_geno(gen_right, 8, false);
+    const std::array<int,2>& a_left = mpp_geno_table(8, false).decode(gen_left);
+    const std::array<int,2>& a_right = mpp_geno_table(8, false).decode(gen_right);
 
     if(a_left[0] == a_right[0]) {
         if(a_left[1] == a_right[1]) return(0);
@@ -432,7 +450,10 @@ const NumericVector HS::est_map2(const IntegerMatrix& genotypes,
                                  const double error_prob,
                                  const int max_iterations,
                                  const double tol,
-                                 const bool verbose)
+                                 const bool verbose,
+                                 const bool scaled_hmm,
+                                 const bool accel_em,
+                                 const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for heterogeneous stock.");
 
@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class HS : public QTLCross
+class HS final : public QTLCrossT<HS>
 {
  public:
     HS(){
@@ -26,6 +26,10 @@ class HS : public QTLCross
     const double step(const int gen_left, const int gen_right, const double rec_frac,
                       const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
+    const std::vector<Rcpp::NumericMatrix> calc_stepmatrix(const Rcpp::NumericVector rec_frac,
+                                                           const bool is_x_chr, const bool is_female,
+                                                           const Rcpp::IntegerVector& cross_info);
+
     const Rcpp::IntegerVector possible_gen(const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
     const int ngen(const bool is_x_chr);
@@ -62,7 +66,10 @@ class HS : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
@@ -130,9 +130,9 @@ const double HSF1::step(const int gen_left, const int gen_right, const double re
         throw std::range_error("genotype value not allowed");
     #endif
 
-    // info about preCC progenitors
-    const static IntegerVector precc_gen = IntegerVector::create(1);
-    const static NumericVector precc_alpha = NumericVector::create(1.0);
+    // can treat HS like DO where "preCC" founders all at generation 1
+    const IntegerVector& precc_gen = HS_precc_gen();
+    const NumericVector& precc_alpha = HS_precc_alpha();
 
     // no. generations for this mouse
     int n_gen = cross_info[0];
@@ -154,6 +154,25 @@ const double HSF1::step(const int gen_left, const int gen_right, const double re
     else return(log(r)-log(7.0));
 }
 
+// transition matrices for a set of intervals
+// (probability of recombinant haplotype calculated just once per interval)
+const std::vector<NumericMatrix> HSF1::calc_stepmatrix(const NumericVector rec_frac,
+                                                       const bool is_x_chr, const bool is_female,
+                                                       const IntegerVector& cross_info)
+{
+    // can treat HS like DO where "preCC" founders all at generation 1
+    const IntegerVector& precc_gen = HS_precc_gen();
+    const NumericVector& precc_alpha = HS_precc_alpha();
+
+    // no. generations for this mouse
+    int n_gen = cross_info[0];
+
+    IntegerVector gen = possible_gen(is_x_chr, is_female, cross_info);
+
+    return DO_calc_stepmatrix(rec_frac, is_x_chr, is_female, n_gen, gen,
+                              precc_gen, precc_alpha, false, true);
+}
+
 const IntegerVector HSF1::possible_gen(const bool is_x_chr, const bool is_female,
                                        const IntegerVector& cross_info)
 {
@@ -328,7 +347,10 @@ const NumericVector HSF1::est_map2(const IntegerMatrix& genotypes,
                                    const double error_prob,
                                    const int max_iterations,
                                    const double tol,
-                                   const bool verbose)
+                                   const bool verbose,
+                                   const bool scaled_hmm,
+                                   const bool accel_em,
+                                   const int n_threads)
 {
     Rcpp::stop("est_map not yet implemented for HS F1s.");
 
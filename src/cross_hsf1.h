@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class HSF1 : public QTLCross
+class HSF1 final : public QTLCrossT<HSF1>
 {
  public:
     HSF1(){
@@ -26,6 +26,10 @@ class HSF1 : public QTLCross
     const double step(const int gen_left, const int gen_right, const double rec_frac,
                       const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
+    const std::vector<Rcpp::NumericMatrix> calc_stepmatrix(const Rcpp::NumericVector rec_frac,
+                                                           const bool is_x_chr, const bool is_female,
+                                                           const Rcpp::IntegerVector& cross_info);
+
     const Rcpp::IntegerVector possible_gen(const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
     const int ngen(const bool is_x_chr);
@@ -58,7 +62,10 @@ class HSF1 : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
@@ -61,7 +61,7 @@ const double HSPK::emit(const int obs_gen, const int true_gen, const double erro
     if(obs_gen==0) return 0.0; // missing
 
     if(!is_x_chr || is_female) { // autosome or female X
-        const IntegerVector true_alleles = mpp_decode_geno(true_gen, 8, true);
+        const std::array<int,2>& true_alleles = mpp_geno_table(8, true).decode(true_gen);
         int f1 = founder_geno[true_alleles[0]-1];
         int f2 = founder_geno[true_alleles[1]-1];
 
@@ -154,10 +154,8 @@ const double HSPK::step(const int gen_left, const int gen_right, const double re
     #endif
 
     // info about preCC progenitors
-    const static IntegerVector precc_gen = IntegerVector::create(4,5,6,7,8,9,10,11,12);
-    const static NumericVector precc_alpha =
-        NumericVector::create(21.0/144.0, 64.0/144.0, 24.0/144.0, 10.0/144.0, 5.0/144.0,
-                               9.0/144.0,  5.0/144.0,  3.0/144.0,  3.0/144.0);
+    const IntegerVector& precc_gen = DO_precc_gen();
+    const NumericVector& precc_alpha = DO_precc_alpha();
 
     // no. generations for this mouse
     int n_gen = cross_info[0];
@@ -180,6 +178,25 @@ const double HSPK::step(const int gen_left, const int gen_right, const double re
     return NA_REAL; // shouldn't get here
 }
 
+// transition matrices for a set of intervals
+// (probability of recombinant haplotype calculated just once per interval)
+const std::vector<NumericMatrix> HSPK::calc_stepmatrix(const NumericVector rec_frac,
+                                                       const bool is_x_chr, const bool is_female,
+                                                       const IntegerVector& cross_info)
+{
+    // info about preCC progenitors
+    const IntegerVector& precc_gen = DO_precc_gen();
+    const NumericVector& precc_alpha = DO_precc_alpha();
+
+    // no. generations for this mouse
+    int n_gen = cross_info[0];
+
+    IntegerVector gen = possible_gen(is_x_chr, is_female, cross_info);
+
+    return DO_calc_stepmatrix(rec_frac, is_x_chr, is_female, n_gen, gen,
+                              precc_gen, precc_alpha, true, is_x_chr && !is_female);
+}
+
 const IntegerVector HSPK::possible_gen(const bool is_x_chr, const bool is_female,
                                        const IntegerVector& cross_info)
 {
@@ -229,8 +246,8 @@ const int HSPK::nrec(const int gen_left, const int gen_right,
         else return(1);
     }
 
-    Rcpp::IntegerVector a_left = mpp_decode_geno(gen_left, 8, true);
-    Rcpp::IntegerVector a_right = mpp_decode_geno(gen_right, 8, true);
+    const std::array<int,2>& a_left = mpp_geno_table(8, true).decode(gen_left);
+    const std::array<int,2>& a_right = mpp_geno_table(8, true).decode(gen_right);
 
     if(a_left[0] == a_right[0]) {
         if(a_left[1] == a_right[1]) return(0);
@@ -266,7 +283,7 @@ const NumericMatrix HSPK::geno2allele_matrix(const bool is_x_chr)
         NumericMatrix result(n_geno+n_alleles, n_alleles);
         // female X
         for(int trueg=0; trueg<n_geno; trueg++) {
-            IntegerVector alleles = mpp_decode_geno(trueg+1, 8, true);
+            const std::array<int,2>& alleles = mpp_geno_table(8, true).decode(trueg+1);
             result(trueg,alleles[0]-1) += 0.5;
             result(trueg,alleles[1]-1) += 0.5;
         }
@@ -280,7 +297,7 @@ const NumericMatrix HSPK::geno2allele_matrix(const bool is_x_chr)
         NumericMatrix result(n_geno,n_alleles);
 
         for(int trueg=0; trueg<n_geno; trueg++) {
-            IntegerVector alleles = mpp_decode_geno(trueg+1, 8, true);
+            const std::array<int,2>& alleles = mpp_geno_table(8, true).decode(trueg+1);
             result(trueg,alleles[0]-1) += 0.5;
             result(trueg,alleles[1]-1) += 0.5;
         }
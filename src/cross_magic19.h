@@ -11,7 +11,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class MAGIC19 : public QTLCross
+class MAGIC19 final : public QTLCrossT<MAGIC19>
 {
  public:
     MAGIC19(){
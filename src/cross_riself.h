@@ -3,12 +3,21 @@
 #ifndef CROSS_RISELF_H
 #define CROSS_RISELF_H
 
+#include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
 
-class RISELF : public QTLCross
+class RISELF final : public QTLCrossT<RISELF>
 {
  public:
+    // genotype codes
+    enum gen_riself {AA=1, BB=2};
+
+    // number of possible genotypes for an individual, autosome and X chr
+    // (compile-time constants for the HMM kernels; see cross_dispatch.h)
+    static const int n_poss_gen_A = 2;
+    static const int n_poss_gen_X = 2;
+
     RISELF(){
         crosstype = "riself";
         phase_known_crosstype = "riself";
@@ -26,4 +35,22 @@ class RISELF : public QTLCross
 
 };
 
+// step() is defined inline, here,
+// so it can be inlined in the HMM kernels (see cross_dispatch.h)
+
+inline const double RISELF::step(const int gen_left, const int gen_right, const double rec_frac,
+                                 const bool is_x_chr, const bool is_female, const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(gen_left, false, is_x_chr, is_female, cross_info) ||
+       !check_geno(gen_right, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    const double R = 2.0*rec_frac/(1+2.0*rec_frac);
+
+    if(gen_left == gen_right) return log(1.0-R);
+    else return log(R);
+}
+
 #endif // CROSS_RISELF_H
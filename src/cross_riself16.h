@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class RISELF16 : public QTLCross
+class RISELF16 final : public QTLCrossT<RISELF16>
 {
  public:
     RISELF16(){
@@ -61,7 +61,10 @@ class RISELF16 : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 };
 
 #endif // CROSS_RISELF16_H
@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class RISELF4 : public QTLCross
+class RISELF4 final : public QTLCrossT<RISELF4>
 {
  public:
     RISELF4(){
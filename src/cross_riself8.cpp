@@ -297,12 +297,15 @@ const NumericVector RISELF8::est_map2(const IntegerMatrix& genotypes,
                                       const double error_prob,
                                       const int max_iterations,
                                       const double tol,
-                                      const bool verbose)
+                                      const bool verbose,
+                                      const bool scaled_hmm,
+                                      const bool accel_em,
+                                      const int n_threads)
 {
     return est_map2_founderorder(this->crosstype,
                                  genotypes, founder_geno,
                                  is_X_chr, is_female, cross_info,
                                  cross_group, unique_cross_group,
                                  rec_frac, error_prob, max_iterations,
-                                 tol, verbose);
+                                 tol, verbose, scaled_hmm, accel_em, n_threads);
 }
@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class RISELF8 : public QTLCross
+class RISELF8 final : public QTLCrossT<RISELF8>
 {
  public:
     RISELF8(){
@@ -61,7 +61,10 @@ class RISELF8 : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 
 };
 
@@ -3,12 +3,21 @@
 #ifndef CROSS_RISIB_H
 #define CROSS_RISIB_H
 
+#include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
 
-class RISIB : public QTLCross
+class RISIB final : public QTLCrossT<RISIB>
 {
  public:
+    // genotype codes
+    enum gen_risib {AA=1, BB=2};
+
+    // number of possible genotypes for an individual, autosome and X chr
+    // (compile-time constants for the HMM kernels; see cross_dispatch.h)
+    static const int n_poss_gen_A = 2;
+    static const int n_poss_gen_X = 2;
+
     RISIB(){
         crosstype = "risib";
         phase_known_crosstype = "risib";
@@ -29,4 +38,87 @@ class RISIB : public QTLCross
 
 };
 
+// init() and step() are defined inline, here,
+// so they can be inlined in the HMM kernels (see cross_dispatch.h)
+
+inline const double RISIB::init(const int true_gen,
+                                const bool is_x_chr, const bool is_female, const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(true_gen, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    const bool forward_direction = (cross_info.size()<1 || cross_info[0] == 0); // AA female x BB male
+
+    if(is_x_chr) {
+        if(forward_direction) {
+            if(true_gen == AA) return log(2.0)-log(3.0);
+            if(true_gen == BB) return -log(3.0);
+        }
+        else {
+            if(true_gen == BB) return log(2.0)-log(3.0);
+            if(true_gen == AA) return -log(3.0);
+        }
+    }
+    else { // autosome
+        return -log(2.0);
+    }
+
+    return NA_REAL; // can't get here
+}
+
+inline const double RISIB::step(const int gen_left, const int gen_right, const double rec_frac,
+                                const bool is_x_chr, const bool is_female, const IntegerVector& cross_info)
+{
+    #ifndef RQTL2_NODEBUG
+    if(!check_geno(gen_left, false, is_x_chr, is_female, cross_info) ||
+       !check_geno(gen_right, false, is_x_chr, is_female, cross_info))
+        throw std::range_error("genotype value not allowed");
+    #endif
+
+    if(is_x_chr)  {
+        const bool forward_direction = (cross_info.size()<1 || cross_info[0] == 0); // AA female x BB male
+
+        if(forward_direction) {
+            if(gen_left == AA) {
+                if(gen_right == AA)
+                    return log(1.0 + 2.0*rec_frac) - log(1.0 + 4.0*rec_frac);
+                if(gen_right == BB)
+                    return log(2.0*rec_frac) - log(1.0 + 4.0*rec_frac);
+            }
+
+            if(gen_left == BB) {
+                if(gen_right == BB)
+                    return -log(1.0 + 4.0*rec_frac);
+                if(gen_right == AA)
+                    return log(4.0*rec_frac) - log(1.0 + 4.0*rec_frac);
+            }
+        }
+        else {
+            if(gen_left == AA) {
+                if(gen_right == AA)
+                    return -log(1.0 + 4.0*rec_frac);
+                if(gen_right == BB)
+                    return log(4.0*rec_frac) - log(1.0 + 4.0*rec_frac);
+            }
+
+            if(gen_left == BB) {
+                if(gen_right == BB)
+                    return log(1.0 + 2.0*rec_frac) - log(1.0 + 4.0*rec_frac);
+                if(gen_right == AA)
+                    return log(2.0*rec_frac) - log(1.0 + 4.0*rec_frac);
+            }
+        }
+    }
+    else { // autosome
+        const double R = 4.0*rec_frac/(1+6.0*rec_frac);
+
+        if(gen_left == gen_right) return log(1.0-R);
+        else return log(R);
+    }
+
+    return NA_REAL; // can't get here
+}
+
 #endif // CROSS_RISIB_H
@@ -270,7 +270,10 @@ const NumericVector RISIB4::est_map2(const IntegerMatrix& genotypes,
                                      const double error_prob,
                                      const int max_iterations,
                                      const double tol,
-                                     const bool verbose)
+                                     const bool verbose,
+                                     const bool scaled_hmm,
+                                     const bool accel_em,
+                                     const int n_threads)
 {
     if(!is_X_chr) { // autosome; can ignore founder order
         const int n_ind = cross_group.size();
@@ -284,7 +287,7 @@ const NumericVector RISIB4::est_map2(const IntegerMatrix& genotypes,
                                 is_X_chr, is_female, cross_info,
                                 one_group, one_unique_group,
                                 rec_frac, error_prob, max_iterations,
-                                tol, verbose);
+                                tol, verbose, scaled_hmm, accel_em, n_threads);
     }
 
     // X chromosome: need to use the lowmem version
@@ -293,5 +296,5 @@ const NumericVector RISIB4::est_map2(const IntegerMatrix& genotypes,
                            is_X_chr, is_female, cross_info,
                            cross_group, unique_cross_group,
                            rec_frac, error_prob, max_iterations,
-                           tol, verbose);
+                           tol, verbose, scaled_hmm, accel_em, n_threads);
 }
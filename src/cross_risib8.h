@@ -6,7 +6,7 @@
 #include <Rcpp.h>
 #include "cross.h"
 
-class RISIB8 : public QTLCross
+class RISIB8 final : public QTLCrossT<RISIB8>
 {
  public:
     RISIB8(){
@@ -57,7 +57,10 @@ class RISIB8 : public QTLCross
                                        const double error_prob,
                                        const int max_iterations,
                                        const double tol,
-                                       const bool verbose);
+                                       const bool verbose,
+                                       const bool scaled_hmm,
+                                       const bool accel_em,
+                                       const int n_threads);
 };
 
 #endif // CROSS_RISIB8_H
@@ -3,35 +3,80 @@
 #include "cross_util.h"
 #include "cross.h"
 #include <math.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <Rcpp.h>
 using namespace Rcpp;
 #include "r_message.h" // defines RQTL2_NODEBUG and r_message()
 
+// lookup table for genotype codes, for multi-parent crosses with heterozygosity
+MPPGenoTable::MPPGenoTable(const int n_alleles, const bool phase_known) :
+    n_alleles(n_alleles < 0 ? 0 : n_alleles), phase_known(phase_known)
+{
+    const int n_puk_geno = this->n_alleles*(this->n_alleles+1)/2; // no. phase-unknown genotypes
+    n_geno = phase_known ? this->n_alleles*this->n_alleles : n_puk_geno;
+
+    code.resize(this->n_alleles*this->n_alleles);
+    alleles.resize(n_geno+1);
+    het.resize(n_geno+1);
+
+    alleles[0][0] = alleles[0][1] = NA_INTEGER; // genotype code 0 is not valid
+    het[0] = false;
+
+    for(int allele1=1; allele1<=this->n_alleles; allele1++) {
+        for(int allele2=1; allele2<=this->n_alleles; allele2++) {
+            const int m = std::max(allele1, allele2);
+            const int d = abs(allele1 - allele2);
+
+            int g;
+            if(phase_known && allele1 > allele2)
+                g = m*(m-1)/2 - d + 1 + n_puk_geno;
+            else
+                g = m*(m+1)/2 - d;
+            code[(allele1-1)*this->n_alleles + allele2-1] = g;
+
+            // decoded phase-unknown genotypes have allele1 <= allele2
+            if(phase_known || allele1 <= allele2) {
+                alleles[g][0] = allele1;
+                alleles[g][1] = allele2;
+                het[g] = (allele1 != allele2);
+            }
+        }
+    }
+}
+
+// lookup table for given no. alleles and phase_known (created on first use, and then re-used)
+const MPPGenoTable& mpp_geno_table(const int n_alleles, const bool phase_known)
+{
+    // tables for up to 32 alleles are also saved here, for look-up without locking
+    const int max_quick = 32;
+    static std::atomic<const MPPGenoTable*> quick[2][max_quick+1];
+    const bool is_quick = (n_alleles >= 0 && n_alleles <= max_quick);
+
+    if(is_quick) {
+        const MPPGenoTable* table = quick[phase_known][n_alleles].load(std::memory_order_acquire);
+        if(table) return *table;
+    }
+
+    static std::mutex table_mutex;
+    static std::map< std::pair<int,bool>, std::unique_ptr<MPPGenoTable> > tables;
+
+    std::lock_guard<std::mutex> lock(table_mutex);
+    std::unique_ptr<MPPGenoTable>& table = tables[std::make_pair(n_alleles, phase_known)];
+    if(!table) table.reset(new MPPGenoTable(n_alleles, phase_known));
+    if(is_quick) quick[phase_known][n_alleles].store(table.get(), std::memory_order_release);
+
+    return *table;
+}
+
 // allele pair -> genotype code (for multi-parent crosses with heterozygosity)
 // [[Rcpp::export]]
 int mpp_encode_alleles(const int allele1, const int allele2,
                        const int n_alleles, const bool phase_known)
 {
-    // if either input is missing, return NA
-    if(IntegerVector::is_na(allele1) || allele1 <= 0 || allele1 > n_alleles ||
-       IntegerVector::is_na(allele2) || allele2 <= 0 || allele2 > n_alleles)
-        return NA_INTEGER;
-
-    if(phase_known) {
-        const int m = std::max(allele1, allele2);
-        const int d = abs(allele1 - allele2);
-
-        if(allele1 <= allele2)
-            return (int)round(R::choose((double)(m+1), 2.0) - d);
-        else
-            return (int)round(R::choose((double)(m), 2.0) - d + 1 +
-                              R::choose((double)(n_alleles+1), 2.0));
-    }
-    else {
-        const int m = std::max(allele1, allele2);
-        const int d = abs(allele1 - allele2);
-        return (int)round(R::choose((double)(m+1), 2.0) - d);
-    }
+    return mpp_geno_table(n_alleles, phase_known).encode(allele1, allele2);
 }
 
 
@@ -40,78 +85,12 @@ int mpp_encode_alleles(const int allele1, const int allele2,
 IntegerVector mpp_decode_geno(const int true_gen,
                               const int n_alleles, const bool phase_known)
 {
-    IntegerVector result(2);
-
-    // return NA if input is bad
-    if(IntegerVector::is_na(true_gen) || true_gen <= 0 ||
-       (phase_known && true_gen > n_alleles*n_alleles) ||
-       (!phase_known && true_gen > n_alleles*(n_alleles+1)/2)) {
-
-        result[0] = NA_INTEGER;
-        result[1] = NA_INTEGER;
-        return result;
-    }
-
-    if(phase_known) {
-        // number of phase-known genotypes
-        const int n_puk_geno = n_alleles + (int)round(R::choose((double)n_alleles, 2.0));
+    const std::array<int,2>& alleles = mpp_geno_table(n_alleles, phase_known).decode(true_gen);
 
-        #ifndef RQTL2_NODEBUG
-        const int n_geno = n_alleles * n_alleles;
-        if(true_gen < 0 || true_gen > n_geno)
-            throw std::range_error("genotype value not allowed");
-        #endif
-
-        if(true_gen <= n_puk_geno) {
-            int last_max = 0;
-            for(int i=1; i<=n_alleles; i++) {
-                if(true_gen <= last_max+i) {
-                    result[1] = i;
-                    result[0] = true_gen - last_max;
-                    return result;
-                }
-                last_max += i;
-            }
-        }
-        else {
-            int g = true_gen - n_puk_geno;
-            int last_max = 0;
-            for(int i=1; i<=n_alleles-1; i++) {
-                if(g <= last_max+i) {
-                    result[0] = i+1;
-                    result[1] = g-last_max;
-                    return result;
-                }
-                last_max += i;
-            }
-        }
-
-        result[0] = NA_INTEGER;
-        result[1] = NA_INTEGER;
-        return result;
-    }
-    else {
-        // number of phase-unknown genotypes
-        #ifndef RQTL2_NODEBUG
-        const int n_geno = n_alleles + (int)round(R::choose((double)n_alleles, 2.0));
-        if(true_gen < 0 || true_gen > n_geno)
-            throw std::range_error("genotype value not allowed");
-        #endif
-
-        int last_max = 0;
-        for(int i=1; i<=n_alleles; i++) {
-            if(true_gen <= last_max+i) {
-                result[1] = i;
-                result[0] = true_gen - last_max;
-                return(result);
-            }
-            last_max += i;
-        }
-
-        result[0] = NA_INTEGER;
-        result[1] = NA_INTEGER;
-        return result;
-    }
+    IntegerVector result(2);
+    result[0] = alleles[0];
+    result[1] = alleles[1];
+    return result;
 }
 
 // is heterozygous? (for multi-parent crosses with heterozygosity)
@@ -119,9 +98,7 @@ IntegerVector mpp_decode_geno(const int true_gen,
 bool mpp_is_het(const int true_gen, const int n_alleles,
                 const bool phase_known)
 {
-    IntegerVector alleles = mpp_decode_geno(true_gen, n_alleles, phase_known);
-    if(alleles[0] == alleles[1]) return(false);
-    return(true);
+    return mpp_geno_table(n_alleles, phase_known).is_het(true_gen);
 }
 
 
@@ -131,12 +108,13 @@ const std::vector<std::string> mpp_geno_names(const std::vector<std::string> all
                                               const bool is_x_chr)
 {
     const int n_alleles = alleles.size();
-    const int n_geno = n_alleles + (int)round(R::choose((double)n_alleles, 2.0));
+    const MPPGenoTable& geno_table = mpp_geno_table(n_alleles, false);
+    const int n_geno = geno_table.n_geno;
 
     if(is_x_chr) {
         std::vector<std::string> result(n_geno + n_alleles);
         for(int i=0; i<n_geno; i++) {
-            IntegerVector allele_int = mpp_decode_geno(i+1, n_alleles, false);
+            const std::array<int,2>& allele_int = geno_table.decode(i+1);
             result[i] = alleles[allele_int[0]-1] + alleles[allele_int[1]-1];
         }
         for(int i=0; i<n_alleles; i++) {
@@ -148,7 +126,7 @@ const std::vector<std::string> mpp_geno_names(const std::vector<std::string> all
     else {
         std::vector<std::string> result(n_geno);
         for(int i=0; i<n_geno; i++) {
-            IntegerVector allele_int = mpp_decode_geno(i+1, n_alleles, false);
+            const std::array<int,2>& allele_int = geno_table.decode(i+1);
             result[i] = alleles[allele_int[0]-1] + alleles[allele_int[1]-1];
         }
         return result;
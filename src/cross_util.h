@@ -2,8 +2,54 @@
 #ifndef CROSS_UTIL_H
 #define CROSS_UTIL_H
 
+#include <array>
+#include <vector>
 #include <Rcpp.h>
 
+// lookup table of genotype codes <-> allele pairs (for multi-parent crosses with heterozygosity)
+//
+// Use mpp_geno_table() to get the table for a given number of alleles;
+// look-ups don't allocate any memory
+class MPPGenoTable
+{
+ public:
+    MPPGenoTable(const int n_alleles, const bool phase_known);
+
+    int n_alleles;
+    bool phase_known;
+    int n_geno; // number of genotypes (autosome)
+
+    // genotype code -> allele pair (NA if genotype code is invalid)
+    const std::array<int,2>& decode(const int true_gen) const
+    {
+        if(true_gen <= 0 || true_gen > n_geno) return alleles[0];
+        return alleles[true_gen];
+    }
+
+    // allele pair -> genotype code (NA if either allele is invalid)
+    int encode(const int allele1, const int allele2) const
+    {
+        if(allele1 <= 0 || allele1 > n_alleles || allele2 <= 0 || allele2 > n_alleles)
+            return NA_INTEGER;
+        return code[(allele1-1)*n_alleles + allele2-1];
+    }
+
+    // is heterozygous?
+    bool is_het(const int true_gen) const
+    {
+        if(true_gen <= 0 || true_gen > n_geno) return false;
+        return het[true_gen];
+    }
+
+ private:
+    std::vector< std::array<int,2> > alleles; // indexed by genotype code; [0] is NA
+    std::vector<int> code;                    // indexed by (allele1-1)*n_alleles + allele2-1
+    std::vector<bool> het;                    // indexed by genotype code
+};
+
+// lookup table for given no. alleles and phase_known (created on first use, and then re-used)
+const MPPGenoTable& mpp_geno_table(const int n_alleles, const bool phase_known);
+
 // allele pair -> genotype code (for multi-parent crosses with heterozygosity)
 int mpp_encode_alleles(const int allele1, const int allele2,
                        const int n_alleles, const bool phase_known);
@@ -0,0 +1,145 @@
+// calculations shared by the sparse and compact genotype probabilities
+//
+// These are templated on the class holding the probabilities for one
+// chromosome (SparseGenoprob or CompactGenoprob), which must have
+// n_ind, n_gen, and n_pos, plus a member function visit(pos, f) that
+// calls f(ind, gen, prob) for each non-zero probability at position
+// pos. visit() is called from worker threads, so must not use the R API.
+#ifndef GENOPROB_KERNELS_H
+#define GENOPROB_KERNELS_H
+
+#include <RcppEigen.h>
+#include <vector>
+#include "snpprobs.h"
+#include "parallel_util.h"
+
+// convert genotype or allele probabilities to (dense) SNP probabilities
+//
+// pr        = genotype or allele probabilities for one chromosome
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = 3d array individuals x SNP genotypes x SNPs
+template<class ProbsT>
+Rcpp::NumericVector genoprob_to_snpprob_kernel(const ProbsT& pr,
+                                               const Rcpp::IntegerVector& sdp,
+                                               const Rcpp::IntegerVector& interval,
+                                               const Rcpp::LogicalVector& on_map,
+                                               const int prob_type)
+{
+    const int n_ind = pr.n_ind;
+    const int n_gen = pr.n_gen;
+    const int n_snp = sdp.size();
+
+    int n_str, n_snpgen;
+    snpprob_dims(n_gen, pr.n_pos, sdp, interval, on_map, prob_type, n_str, n_snpgen);
+    const std::vector<int> snpcol = snpcol_table(n_gen, n_str, sdp, prob_type);
+
+    Rcpp::NumericVector result((size_t)n_ind*n_snpgen*n_snp);
+    result.attr("dim") = Rcpp::Dimension(n_ind, n_snpgen, n_snp);
+    double *res = REAL(result);
+
+    for(int snp=0; snp<n_snp; snp++) {
+        Rcpp::checkUserInterrupt();  // check for ^C from user
+
+        double *res_snp = res + (size_t)n_ind*n_snpgen*snp;
+        const int *col = snpcol.data() + (size_t)n_gen*snp;
+        const double wt = on_map[snp] ? 1.0 : 0.5;
+        auto add = [&](const int ind, const int gen, const double prob) {
+            res_snp[ind + col[gen]*n_ind] += wt * prob;
+        };
+
+        pr.visit(interval[snp], add);
+        if(!on_map[snp]) pr.visit(interval[snp] + 1, add); // average with the next position
+    }
+
+    return result;
+}
+
+// Scan a single chromosome with additive covariates
+//
+// pr        = genotype probabilities for one chromosome
+//             (already subset to the individuals and genotype columns to use)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// weights   = vector of weights (really the SQUARE ROOT of the weights), or length 0
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
+//
+// The genotype probabilities at each position are formed in a dense
+// workspace (individuals x genotypes), with the covariates regressed
+// out, as in scan_hk_onechr(); the full dense array is never formed.
+template<class ProbsT>
+Rcpp::NumericMatrix scan_hk_onechr_kernel(const ProbsT& pr,
+                                          const Rcpp::NumericMatrix& pheno,
+                                          const Rcpp::NumericMatrix& addcovar,
+                                          const Rcpp::NumericVector& weights,
+                                          const double tol,
+                                          const int n_threads)
+{
+    using Eigen::MatrixXd;
+    using Eigen::VectorXd;
+    using Eigen::Map;
+
+    const int n_ind = pr.n_ind;
+    const int n_gen = pr.n_gen;
+    const int n_pos = pr.n_pos;
+    const int n_phe = pheno.cols();
+    if(n_ind != pheno.rows())
+        throw std::range_error("nrow(pheno) != nrow(genoprobs)");
+    if(n_ind != addcovar.rows())
+        throw std::range_error("nrow(pheno) != nrow(addcovar)");
+    const bool weighted = (weights.size() > 0);
+    if(weighted && n_ind != weights.size())
+        throw std::range_error("length(weights) != nrow(genoprobs)");
+
+    VectorXd w = VectorXd::Ones(n_ind);
+    if(weighted) w = Rcpp::as<Map<VectorXd> >(weights);
+
+    // orthonormal basis for the (weighted) covariates
+    const MatrixXd A = w.asDiagonal() * Rcpp::as<Map<MatrixXd> >(addcovar);
+    Eigen::ColPivHouseholderQR<MatrixXd> AQR(A);
+    AQR.setThreshold(tol);
+    const MatrixXd Qa = AQR.householderQ() * MatrixXd::Identity(n_ind, AQR.rank());
+
+    // phenotype residuals
+    MatrixXd Y = w.asDiagonal() * Rcpp::as<Map<MatrixXd> >(pheno);
+    Y -= Qa * (Qa.transpose() * Y);
+    const VectorXd yy = Y.colwise().squaredNorm().transpose();
+
+    Rcpp::NumericMatrix result(n_phe, n_pos);
+    double *res = REAL(result);
+    const double cancel_tol = 1e-6;
+
+    parallel_for(n_pos, n_threads, [&](const int pos, const int thread) {
+        // dense genotype probabilities at this position
+        MatrixXd X = MatrixXd::Zero(n_ind, n_gen);
+        pr.visit(pos, [&](const int ind, const int gen, const double prob) {
+            X(ind, gen) = w[ind] * prob;
+        });
+        X -= Qa * (Qa.transpose() * X);
+
+        Eigen::ColPivHouseholderQR<MatrixXd> PQR(X);
+        PQR.setThreshold(tol);
+        const int r = PQR.rank();
+        const MatrixXd Q = PQR.householderQ() * MatrixXd::Identity(n_ind, r);
+
+        const MatrixXd QtY = Q.transpose() * Y;
+        for(int j=0; j<n_phe; j++) {
+            double rss = yy[j] - QtY.col(j).squaredNorm();
+            if(rss < cancel_tol * yy[j])
+                rss = (Y.col(j) - Q * QtY.col(j)).squaredNorm();
+            res[j + (size_t)pos*n_phe] = rss;
+        }
+    });
+
+    return result;
+}
+
+#endif // GENOPROB_KERNELS_H
@@ -101,12 +101,13 @@ IntegerVector guess_phase_A(const IntegerMatrix& geno, const String& crosstype,
     const int matsize = n_pos*2;
 
     IntegerVector result(n_ind*n_pos*2); // this will be 2 x n_pos x n_ind
+    const MPPGenoTable& geno_table = mpp_geno_table(n_alleles, false);
 
     for(int ind=0; ind < n_ind; ind++) {
         IntegerVector g1(n_pos), g2(n_pos);
         for(int pos=0; pos < n_pos; pos++) {
 
-            IntegerVector this_g = mpp_decode_geno(geno(pos,ind), n_alleles, false);
+            const std::array<int,2>& this_g = geno_table.decode(geno(pos,ind));
 
             g1[pos] = this_g[0];
             g2[pos] = this_g[1];
@@ -138,13 +139,14 @@ IntegerVector guess_phase_X(const IntegerMatrix& geno, const String& crosstype,
     const int matsize = n_pos*2;
 
     IntegerVector result(n_ind*n_pos*2); // this will be 2 x n_pos x n_ind
+    const MPPGenoTable& geno_table = mpp_geno_table(n_alleles, false);
 
     for(int ind=0; ind < n_ind; ind++) {
         if(is_female[ind]) { // female
             IntegerVector g1(n_pos), g2(n_pos);
             for(int pos=0; pos < n_pos; pos++) {
 
-                IntegerVector this_g = mpp_decode_geno(geno(pos,ind), n_alleles, false);
+                const std::array<int,2>& this_g = geno_table.decode(geno(pos,ind));
 
                 g1[pos] = this_g[0];
                 g2[pos] = this_g[1];
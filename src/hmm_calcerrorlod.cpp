@@ -46,13 +46,14 @@ NumericMatrix calc_errorlod(const String& crosstype,
     NumericMatrix error_lod(n_mar, n_ind);
 
     NumericVector init_vector = cross->calc_initvector(is_X_chr, is_female, cross_info);
+    NumericVector init_prob = exp(init_vector); // on probability scale
 
     const int matsize = n_ind * n_gen;
     const int max_obsgeno = max(genotypes);
 
-    std::vector<NumericMatrix> emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno,
-                                                                    founder_geno,
-                                                                    is_X_chr, is_female, cross_info);
+    EmitMatrices emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno,
+                                                      founder_geno,
+                                                      is_X_chr, is_female, cross_info);
 
     // possible genotypes
     IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female, cross_info);
@@ -78,14 +79,14 @@ NumericMatrix calc_errorlod(const String& crosstype,
 
             for(int i=0; i<n_poss_gen; i++) {
                 int g = poss_gen[i]-1;
-                if(emit_matrix[mar](obs_geno, i) < log_half) { // considered error if Pr(O | g) < 1/2
+                if(emit_matrix(mar, obs_geno, i) < log_half) { // considered error if Pr(O | g) < 1/2
                     n_err++;
-                    init_err += exp(init_vector[i]);
+                    init_err += init_prob[i];
                     post_err += probs[matindex + g];
                 }
                 else { // not an error
                     n_noerr++;
-                    init_noerr += exp(init_vector[i]);
+                    init_noerr += init_prob[i];
                     post_noerr += probs[matindex + g];
                 }
             } // loop over possible genotypes
@@ -4,9 +4,81 @@
 #include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
+#include "cross_dispatch.h"
 #include "hmm_util.h"
 #include "hmm_forwback.h"
 
+// loop over individuals, for a particular cross class
+// and number of possible genotypes (see cross_dispatch.h)
+template<class CrossT, int N>
+struct calc_genoprob_kernel {
+    static NumericVector run(CrossT* cross,
+                             const bool is_X_chr,
+                             const IntegerMatrix& genotypes,
+                             const IntegerMatrix& founder_geno,
+                             const LogicalVector& is_female,
+                             const IntegerMatrix& cross_info,
+                             const NumericVector& rec_frac,
+                             const IntegerVector& marker_index,
+                             const double error_prob)
+    {
+        const int n_ind = genotypes.cols();
+        const int n_pos = marker_index.size();
+
+        const int n_gen = cross->ngen(is_X_chr);
+        const int matsize = n_gen*n_ind; // size of genotype x individual matrix
+        NumericVector genoprobs(matsize*n_pos);
+
+        // individuals with common is_female and cross_info share the transition matrices
+        std::vector< std::vector<int> > groups = group_individuals(is_female, cross_info);
+
+        for(unsigned int group=0; group<groups.size(); group++) {
+            const int first_ind = groups[group][0];
+            std::vector<NumericMatrix> step_matrix = cross->calc_stepmatrix(rec_frac, is_X_chr, is_female[first_ind],
+                                                                            cross_info(_,first_ind));
+
+            for(unsigned int k=0; k<groups[group].size(); k++) {
+                const int ind = groups[group][k];
+
+                Rcpp::checkUserInterrupt();  // check for ^C from user
+
+                IntegerVector ind_geno = genotypes(_,ind);
+                IntegerVector ind_cross_info = cross_info(_,ind);
+
+                // possible genotypes for this individual
+                IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female[ind], ind_cross_info);
+                const int n_poss_gen = kernel_n_poss_gen(N, poss_gen.size());
+
+                // forward/backward equations
+                NumericMatrix alpha = forwardEquations<CrossT, N>(cross, ind_geno, founder_geno, is_X_chr, is_female[ind],
+                                                       ind_cross_info, step_matrix, marker_index, error_prob,
+                                                       poss_gen);
+                NumericMatrix beta = backwardEquations<CrossT, N>(cross, ind_geno, founder_geno, is_X_chr, is_female[ind],
+                                                       ind_cross_info, step_matrix, marker_index, error_prob,
+                                                       poss_gen);
+
+                // calculate genotype probabilities
+                for(int pos=0, matindex=n_gen*ind; pos<n_pos; pos++, matindex += matsize) {
+                    int g = poss_gen[0]-1;
+                    double sum_at_pos = genoprobs[matindex+g] = alpha(0,pos) + beta(0,pos);
+                    for(int i=1; i<n_poss_gen; i++) {
+                        int g = poss_gen[i]-1;
+                        double val = genoprobs[matindex+g] = alpha(i,pos) + beta(i,pos);
+                        sum_at_pos = addlog(sum_at_pos, val);
+                    }
+                    for(int i=0; i<n_poss_gen; i++) {
+                        int g = poss_gen[i]-1;
+                        genoprobs[matindex+g] = exp(genoprobs[matindex+g] - sum_at_pos);
+                    }
+                }
+            } // loop over individuals
+        } // loop over groups
+
+        genoprobs.attr("dim") = Dimension(n_gen, n_ind, n_pos);
+        return genoprobs;
+    }
+};
+
 // calculate conditional genotype probabilities given multipoint marker data
 // [[Rcpp::export(".calc_genoprob")]]
 NumericVector calc_genoprob(const String& crosstype,
@@ -44,43 +116,9 @@ NumericVector calc_genoprob(const String& crosstype,
         throw std::range_error("founder_geno is not the right size");
     // end of checks
 
-    const int n_gen = cross->ngen(is_X_chr);
-    const int matsize = n_gen*n_ind; // size of genotype x individual matrix
-    NumericVector genoprobs(matsize*n_pos);
-
-    for(int ind=0; ind<n_ind; ind++) {
-
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // possible genotypes for this individual
-        IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female[ind], cross_info(_,ind));
-        const int n_poss_gen = poss_gen.size();
-
-        // forward/backward equations
-        NumericMatrix alpha = forwardEquations(cross, genotypes(_,ind), founder_geno, is_X_chr, is_female[ind],
-                                               cross_info(_,ind), rec_frac, marker_index, error_prob,
-                                               poss_gen);
-        NumericMatrix beta = backwardEquations(cross, genotypes(_,ind), founder_geno, is_X_chr, is_female[ind],
-                                               cross_info(_,ind), rec_frac, marker_index, error_prob,
-                                               poss_gen);
-
-        // calculate genotype probabilities
-        for(int pos=0, matindex=n_gen*ind; pos<n_pos; pos++, matindex += matsize) {
-            int g = poss_gen[0]-1;
-            double sum_at_pos = genoprobs[matindex+g] = alpha(0,pos) + beta(0,pos);
-            for(int i=1; i<n_poss_gen; i++) {
-                int g = poss_gen[i]-1;
-                double val = genoprobs[matindex+g] = alpha(i,pos) + beta(i,pos);
-                sum_at_pos = addlog(sum_at_pos, val);
-            }
-            for(int i=0; i<n_poss_gen; i++) {
-                int g = poss_gen[i]-1;
-                genoprobs[matindex+g] = exp(genoprobs[matindex+g] - sum_at_pos);
-            }
-        }
-    } // loop over individuals
-
-    genoprobs.attr("dim") = Dimension(n_gen, n_ind, n_pos);
+    NumericVector genoprobs = dispatch_cross<calc_genoprob_kernel>(cross, is_X_chr, genotypes, founder_geno,
+                                                                   is_female, cross_info, rec_frac,
+                                                                   marker_index, error_prob);
     delete cross;
     return genoprobs;
 }
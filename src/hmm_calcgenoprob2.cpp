@@ -7,6 +7,7 @@
 #include "cross.h"
 #include "hmm_util.h"
 #include "hmm_forwback2.h"
+#include "parallel_util.h"
 
 // calculate conditional genotype probabilities given multipoint marker data
 // [[Rcpp::export(".calc_genoprob2")]]
@@ -18,7 +19,9 @@ NumericVector calc_genoprob2(const String& crosstype,
                              const IntegerVector& cross_info, // same for all individuals
                              const NumericVector& rec_frac,   // length nrow(genotypes)-1
                              const IntegerVector& marker_index, // length nrow(genotypes)
-                             const double error_prob)
+                             const double error_prob,
+                             const bool scaled_hmm, // if true, use scaled version of HMM, on probability scale
+                             const int n_threads) // number of threads to use
 {
     const int n_ind = genotypes.cols();
     const int n_pos = marker_index.size();
@@ -32,6 +35,8 @@ NumericVector calc_genoprob2(const String& crosstype,
 
     if(error_prob < 0.0 || error_prob > 1.0)
         throw std::range_error("error_prob out of range");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
 
     for(int i=0; i<rec_frac.size(); i++) {
         if(rec_frac[i] < 0 || rec_frac[i] > 0.5)
@@ -51,9 +56,9 @@ NumericVector calc_genoprob2(const String& crosstype,
 
     const int max_obsgeno = max(genotypes);
 
-    std::vector<NumericMatrix> emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno,
-                                                                    founder_geno,
-                                                                    is_X_chr, is_female, cross_info);
+    EmitMatrices emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno,
+                                                      founder_geno,
+                                                      is_X_chr, is_female, cross_info);
 
     std::vector<NumericMatrix> step_matrix = cross->calc_stepmatrix(rec_frac, is_X_chr, is_female, cross_info);
 
@@ -61,29 +66,105 @@ NumericVector calc_genoprob2(const String& crosstype,
     IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female, cross_info);
     const int n_poss_gen = poss_gen.size();
 
-    for(int ind=0; ind<n_ind; ind++) {
-
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // forward/backward equations
-        NumericMatrix alpha = forwardEquations2(genotypes(_,ind), init_vector, emit_matrix, step_matrix, marker_index, poss_gen);
-        NumericMatrix beta = backwardEquations2(genotypes(_,ind), init_vector, emit_matrix, step_matrix, marker_index, poss_gen);
+    if(scaled_hmm) { // convert to probability scale
+        init_vector = exp(init_vector);
+        emit_matrix = exp_matrices(emit_matrix);
+        step_matrix = exp_matrices(step_matrix);
+    }
+    double *gp = genoprobs.begin();
+
+    if(scaled_hmm) {
+        // individuals in batches of HMM_BATCH_SIZE, handled together (see hmm_forwback2.h)
+        std::vector< std::vector<int> > batches = hmm_batches(IntegerVector(n_ind, 0), 1);
+        const int n_batches = batches.size();
+
+        // workspace for each thread
+        const int max_batch = HMM_BATCH_SIZE;
+        std::vector< std::vector<double> > alpha(n_threads), beta(n_threads);
+        std::vector< std::vector<double> > log_scale_alpha(n_threads), log_scale_beta(n_threads);
+        for(int thread=0; thread<n_threads; thread++) {
+            alpha[thread].resize(n_poss_gen*n_pos*max_batch);
+            beta[thread].resize(n_poss_gen*n_pos*max_batch);
+            log_scale_alpha[thread].resize(n_pos*max_batch);
+            log_scale_beta[thread].resize(n_pos*max_batch);
+        }
 
-        // calculate genotype probabilities
-        for(int pos=0, matindex=n_gen*ind; pos<n_pos; pos++, matindex += matsize) {
-            int g = poss_gen[0]-1;
-            double sum_at_pos = genoprobs[matindex+g] = alpha(0,pos) + beta(0,pos);
-            for(int i=1; i<n_poss_gen; i++) {
-                int g = poss_gen[i]-1;
-                double val = genoprobs[matindex+g] = alpha(i,pos) + beta(i,pos);
-                sum_at_pos = addlog(sum_at_pos, val);
+        // batches are independent; each thread writes to its own part of genoprobs
+        parallel_for(n_batches, n_threads, [&](const int batch, const int thread) {
+            const std::vector<int>& batch_ind = batches[batch];
+            const int W = batch_ind.size(); // HMM_BATCH_SIZE or 1
+            double *a = alpha[thread].data();
+            double *b = beta[thread].data();
+
+            // forward/backward equations, on probability scale
+            // a[(pos*n_poss_gen + i)*W + w] is for individual batch_ind[w]
+            if(W == HMM_BATCH_SIZE) {
+                const int *geno[HMM_BATCH_SIZE];
+                for(int w=0; w<W; w++) geno[w] = &(genotypes(0,batch_ind[w]));
+                forwardEquations2_scaled_batch(geno, init_vector, emit_matrix, step_matrix,
+                                               marker_index, poss_gen, a, log_scale_alpha[thread].data());
+                backwardEquations2_scaled_batch(geno, init_vector, emit_matrix, step_matrix,
+                                                marker_index, poss_gen, b, log_scale_beta[thread].data());
+            }
+            else {
+                const int *geno = &(genotypes(0,batch_ind[0]));
+                forwardEquations2_scaled(geno, init_vector, emit_matrix, step_matrix,
+                                         marker_index, poss_gen, a, log_scale_alpha[thread].data());
+                backwardEquations2_scaled(geno, init_vector, emit_matrix, step_matrix,
+                                          marker_index, poss_gen, b, log_scale_beta[thread].data());
             }
-            for(int i=0; i<n_poss_gen; i++) {
-                int g = poss_gen[i]-1;
-                genoprobs[matindex+g] = exp(genoprobs[matindex+g] - sum_at_pos);
+
+            // calculate genotype probabilities
+            for(int w=0; w<W; w++) {
+                for(int pos=0, matindex=n_gen*batch_ind[w]; pos<n_pos; pos++, matindex += matsize) {
+                    double sum_at_pos = 0.0;
+                    for(int i=0; i<n_poss_gen; i++) {
+                        int g = poss_gen[i]-1;
+                        int k = (pos*n_poss_gen + i)*W + w;
+                        sum_at_pos += (gp[matindex+g] = a[k] * b[k]);
+                    }
+                    for(int i=0; i<n_poss_gen; i++) {
+                        int g = poss_gen[i]-1;
+                        gp[matindex+g] /= sum_at_pos;
+                    }
+                }
             }
+        }); // loop over batches
+    }
+    else {
+        // workspace for each thread
+        std::vector< std::vector<double> > alpha(n_threads), beta(n_threads);
+        for(int thread=0; thread<n_threads; thread++) {
+            alpha[thread].resize(n_poss_gen*n_pos);
+            beta[thread].resize(n_poss_gen*n_pos);
         }
-    } // loop over individuals
+
+        // individuals are independent; each thread writes to its own part of genoprobs
+        parallel_for(n_ind, n_threads, [&](const int ind, const int thread) {
+            const int *geno = &(genotypes(0,ind));
+            double *a = alpha[thread].data();
+            double *b = beta[thread].data();
+
+            // forward/backward equations
+            forwardEquations2(geno, init_vector, emit_matrix, step_matrix, marker_index, poss_gen, a);
+            backwardEquations2(geno, init_vector, emit_matrix, step_matrix, marker_index, poss_gen, b);
+
+            // calculate genotype probabilities
+            for(int pos=0, matindex=n_gen*ind; pos<n_pos; pos++, matindex += matsize) {
+                int g = poss_gen[0]-1;
+                double sum_at_pos = gp[matindex+g] = a[pos*n_poss_gen] + b[pos*n_poss_gen];
+                for(int i=1; i<n_poss_gen; i++) {
+                    int g = poss_gen[i]-1;
+                    double val = gp[matindex+g] = a[i+pos*n_poss_gen] + b[i+pos*n_poss_gen];
+                    sum_at_pos = addlog(sum_at_pos, val);
+                }
+                for(int i=0; i<n_poss_gen; i++) {
+                    int g = poss_gen[i]-1;
+                    gp[matindex+g] = exp(gp[matindex+g] - sum_at_pos);
+                }
+            }
+        }); // loop over individuals
+    }
 
     genoprobs.attr("dim") = Dimension(n_gen, n_ind, n_pos);
     delete cross;
@@ -13,6 +13,8 @@ Rcpp::NumericVector calc_genoprob2(const Rcpp::String& crosstype,
                                    const Rcpp::IntegerVector& cross_info, // same for all individuals
                                    const Rcpp::NumericVector& rec_frac,   // length nrow(genotypes)-1
                                    const Rcpp::IntegerVector& marker_index, // length nrow(genotypes)
-                                   const double error_prob);
+                                   const double error_prob,
+                                   const bool scaled_hmm, // if true, use scaled version of HMM, on probability scale
+                                   const int n_threads); // number of threads to use
 
 #endif // HMM_CALCGENOPROB2_H
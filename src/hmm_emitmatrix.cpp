@@ -0,0 +1,28 @@
+// emission matrices for HMM
+
+#include "hmm_emitmatrix.h"
+#include <vector>
+#include <Rcpp.h>
+
+EmitMatrices::EmitMatrices(const int n_obs_gen, const int n_gen, const int n_markers) :
+    n_obs_gen(n_obs_gen), n_gen(n_gen), index(n_markers, 0)
+{
+}
+
+int EmitMatrices::add_unique()
+{
+    const int u = n_unique();
+    values.resize(values.size() + n_obs_gen*n_gen, 0.0);
+    return u;
+}
+
+Rcpp::NumericMatrix EmitMatrices::matrix(const int marker) const
+{
+    Rcpp::NumericMatrix result(n_obs_gen, n_gen);
+    for(int obs_gen=0; obs_gen<n_obs_gen; obs_gen++) {
+        const double* r = row(marker, obs_gen);
+        for(int gen=0; gen<n_gen; gen++)
+            result(obs_gen, gen) = r[gen];
+    }
+    return result;
+}
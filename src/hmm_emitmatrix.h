@@ -0,0 +1,119 @@
+// emission matrices for HMM
+//
+// Markers with the same founder genotypes (the same strain distribution
+// pattern) share an emission matrix, so we store the unique matrices in
+// one contiguous block plus an index from marker to matrix
+#ifndef HMM_EMITMATRIX_H
+#define HMM_EMITMATRIX_H
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <Rcpp.h>
+
+class EmitMatrices
+{
+ public:
+    EmitMatrices() : n_obs_gen(0), n_gen(0) {};
+    EmitMatrices(const int n_obs_gen, const int n_gen, const int n_markers);
+
+    int n_obs_gen; // number of observed genotype values, including 0 = missing
+    int n_gen;     // number of possible true genotypes
+
+    // marker -> unique matrix
+    std::vector<int> index;
+
+    // unique matrices; for each, the values for a given observed genotype
+    // are contiguous: Pr(obs | gen) is at [(u*n_obs_gen + obs)*n_gen + gen]
+    std::vector<double> values;
+
+    int n_markers() const { return index.size(); }
+
+    int n_unique() const { return values.size() / (n_obs_gen*n_gen); }
+
+    // emission probability for a marker, observed genotype, and (index of) true genotype
+    double operator()(const int marker, const int obs_gen, const int gen) const
+    {
+        return values[(index[marker]*n_obs_gen + obs_gen)*n_gen + gen];
+    }
+
+    // emission probabilities for all true genotypes at a marker, for an observed genotype
+    const double* row(const int marker, const int obs_gen) const
+    {
+        return &values[(index[marker]*n_obs_gen + obs_gen)*n_gen];
+    }
+
+    // add a unique matrix (filled with 0's), returning its index
+    int add_unique();
+
+    // pointer to unique matrix u, for filling it in
+    double* unique_matrix(const int u)
+    {
+        return &values[u*n_obs_gen*n_gen];
+    }
+
+    // emission matrix for a marker, as an n_obs_gen x n_gen R matrix
+    Rcpp::NumericMatrix matrix(const int marker) const;
+};
+
+
+// compare two founder genotype columns (used to find the unique ones)
+struct FounderGenoLess
+{
+    int n_founders;
+    FounderGenoLess(const int n_founders) : n_founders(n_founders) {};
+
+    bool operator()(const int* a, const int* b) const
+    {
+        return std::lexicographical_compare(a, a+n_founders, b, b+n_founders);
+    }
+};
+
+// calculate emission matrices, once for each unique column of founder_geno
+// (CrossT is QTLCross or one of the cross classes; see QTLCrossT in cross.h)
+template<class CrossT>
+EmitMatrices calc_unique_emitmatrices(CrossT* cross,
+                                      const double error_prob,
+                                      const int max_obsgeno,
+                                      const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
+                                      const bool is_x_chr, const bool is_female,
+                                      const Rcpp::IntegerVector& cross_info)
+{
+    Rcpp::IntegerVector gen = cross->possible_gen(is_x_chr, is_female, cross_info);
+    const int n_true_gen = gen.size();
+    const int n_obs_gen = max_obsgeno+1;
+
+    const int n_founders = founder_geno.rows();
+    const int n_markers = founder_geno.cols();
+    const int* fg_begin = founder_geno.begin();
+
+    EmitMatrices result(n_obs_gen, n_true_gen, n_markers);
+
+    FounderGenoLess fg_less(n_founders);
+    std::map<const int*, int, FounderGenoLess> unique_fg(fg_less);
+    for(int i=0; i<n_markers; i++) {
+        const int* fg_col = fg_begin + i*n_founders;
+        std::map<const int*, int, FounderGenoLess>::const_iterator it = unique_fg.find(fg_col);
+        if(it != unique_fg.end()) { // seen these founder genotypes already
+            result.index[i] = it->second;
+            continue;
+        }
+
+        const int u = result.add_unique();
+        unique_fg[fg_col] = u;
+        result.index[i] = u;
+
+        Rcpp::IntegerVector fg = founder_geno(Rcpp::_, i);
+        double* emitmatrix = result.unique_matrix(u);
+        for(int obs_gen=0; obs_gen<n_obs_gen; obs_gen++) {
+            for(int true_gen=0; true_gen<n_true_gen; true_gen++) {
+                emitmatrix[obs_gen*n_true_gen + true_gen] = cross->emit(obs_gen, gen[true_gen], error_prob,
+                                                                        fg, is_x_chr, is_female, cross_info);
+            }
+        }
+    }
+
+    return result;
+}
+
+#endif // HMM_EMITMATRIX_H
@@ -8,6 +8,7 @@
 
 #include "hmm_estmap2.h"
 #include <math.h>
+#include <functional>
 #include <Rcpp.h>
 #include "cross.h"
 #include "hmm_util.h"
@@ -15,6 +16,7 @@
 #include "hmm_estmap.h"
 #include "r_message.h" // defines RQTL2_NODEBUG and r_message()
 #include "cross_util.h"
+#include "parallel_util.h"
 
 // re-estimate inter-marker recombination fractions
 //
@@ -26,6 +28,12 @@
 //     unique_cross_group = vector of indexes to the first individual in each category, for grabbing is_female
 //                          and cross_info for the category
 //
+// accel_em = if true, accelerate EM with SQUAREM-type extrapolation (see est_map2_em())
+// n_threads = number of threads to use, for the E-step and the log likelihood
+//
+// The result has attributes "loglik" (final log likelihood), "n_iter" (number of EM steps),
+// and "loglik_trace" (log likelihood at the start of each iteration, or cycle with accel_em)
+//
 // [[Rcpp::export(".est_map2")]]
 NumericVector est_map2(const String& crosstype,
                        const IntegerMatrix& genotypes, // columns are individuals, rows are markers
@@ -39,7 +47,10 @@ NumericVector est_map2(const String& crosstype,
                        const double error_prob,
                        const int max_iterations,
                        const double tol,
-                       const bool verbose)
+                       const bool verbose,
+                       const bool scaled_hmm,
+                       const bool accel_em,
+                       const int n_threads)
 {
     const int n_ind = genotypes.cols();
     const int n_mar = genotypes.rows();
@@ -67,6 +78,8 @@ NumericVector est_map2(const String& crosstype,
       throw std::range_error("max_iterations should be >= 0");
     if(tol < 0)
       throw std::range_error("tol >= 0");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
 
     if(!cross->check_founder_geno_size(founder_geno, n_mar))
         throw std::range_error("founder_geno is not the right size");
@@ -76,7 +89,7 @@ NumericVector est_map2(const String& crosstype,
                                            is_X_chr, is_female, cross_info,
                                            cross_group, unique_cross_group,
                                            rec_frac, error_prob, max_iterations,
-                                           tol, verbose);
+                                           tol, verbose, scaled_hmm, accel_em, n_threads);
 
     delete cross;
     return result;
@@ -96,8 +109,12 @@ NumericVector est_map2_lowmem(const String crosstype,
                               const double error_prob,
                               const int max_iterations,
                               const double tol,
-                              const bool verbose)
+                              const bool verbose,
+                              const bool scaled_hmm,
+                              const bool accel_em,
+                              const int n_threads)
 {
+    // (scaled_hmm, accel_em, and n_threads are ignored here)
     return est_map(crosstype, genotypes, founder_geno,
                    is_X_chr, is_female, cross_info,
                    rec_frac, error_prob, max_iterations,
@@ -105,6 +122,175 @@ NumericVector est_map2_lowmem(const String crosstype,
 }
 
 
+// re-estimate rec fracs from the per-interval sums of gamma within each cross group
+//
+// group_gamma[(pos*n_cross_group + group)*n_gen_sq + gr*n_gen + gl] = sum of gamma(gl,gr) over individuals in group
+//
+// est_rec_frac() takes gamma as an n_gen x n_gen x n_ind array, plus cross_info for each
+// individual, but it is a function of sums over individuals, with weights that depend only on
+// cross_info. Individuals in a group have common cross_info, so each group's sum is placed
+// in the slot for the group's first individual, with zeros for the other individuals.
+static void est_rec_frac_grouped(QTLCross* cross,
+                                 const std::vector<double>& group_gamma,
+                                 const bool is_X_chr,
+                                 const IntegerMatrix& cross_info,
+                                 const IntegerVector& unique_cross_group,
+                                 const int n_gen,
+                                 NumericVector& rec_frac)
+{
+    const int n_rf = rec_frac.size();
+    const int n_cross_group = unique_cross_group.size();
+    const int n_gen_sq = n_gen*n_gen;
+
+    NumericVector sub_gamma(n_gen_sq * cross_info.cols()); // initialized to 0
+    for(int pos=0; pos<n_rf; pos++) {
+        const double *this_gamma = group_gamma.data() + pos*n_cross_group*n_gen_sq;
+        for(int group=0; group<n_cross_group; group++) {
+            std::copy(this_gamma + group*n_gen_sq, this_gamma + (group+1)*n_gen_sq,
+                      sub_gamma.begin() + unique_cross_group[group]*n_gen_sq);
+        }
+        rec_frac[pos] = cross->est_rec_frac(sub_gamma, is_X_chr, cross_info, n_gen);
+    }
+}
+
+
+// check convergence of EM: change in each rec frac is small relative to its size
+static bool rec_frac_converged(const NumericVector& prev_rec_frac,
+                               const NumericVector& cur_rec_frac,
+                               const double tol)
+{
+    const int n_rf = cur_rec_frac.size();
+    for(int pos=0; pos<n_rf; pos++) {
+        if(fabs(prev_rec_frac[pos] - cur_rec_frac[pos]) > tol*(cur_rec_frac[pos]+tol*100.0))
+            return false;
+    }
+    return true;
+}
+
+
+// run EM iterations, starting at rec_frac; the result goes in cur_rec_frac
+//
+// em_step(rf_in, rf_out) does one EM step, from rf_in to rf_out, and returns the
+// log likelihood at rf_in. It is called at most max_iterations times; n_iter gets the
+// number of calls and loglik_trace gets the log likelihood at the start of each iteration
+// (with accel_em, at the start of each cycle).
+//
+// With accel_em, use the SQUAREM scheme (Varadhan and Roland 2008, Scand J Stat 35:335-353):
+// from two EM steps r0 -> r1 -> r2, extrapolate to r0 - 2a(r1-r0) + a^2(r2-2r1+r0), with
+// a = -|r1-r0|/|r2-2r1+r0|, and take an EM step from there. If the log likelihood at the
+// extrapolated point is less than that at r0, fall back to r2.
+//
+// Convergence is assessed on single EM steps, as with plain EM.
+// Returns true if converged.
+static bool est_map2_em(const std::function<double(const NumericVector&, NumericVector&)>& em_step,
+                        const NumericVector& rec_frac,
+                        NumericVector& cur_rec_frac,
+                        const int max_iterations,
+                        const double tol,
+                        const double rf_tol,
+                        const double rf_uptol,
+                        const bool accel_em,
+                        const bool verbose,
+                        int& n_iter,
+                        std::vector<double>& loglik_trace)
+{
+    const int n_rf = rec_frac.size();
+    n_iter = 0;
+    loglik_trace.clear();
+
+    NumericVector prev_rec_frac(clone(rec_frac));
+
+    if(!accel_em) {
+        while(n_iter < max_iterations) {
+            double loglik = em_step(prev_rec_frac, cur_rec_frac);
+            n_iter++;
+            loglik_trace.push_back(loglik);
+
+            if(verbose) {
+                double maxdif = max(abs(prev_rec_frac - cur_rec_frac));
+                Rprintf("%4d %.12f\n", n_iter, maxdif);
+            }
+
+            if(rec_frac_converged(prev_rec_frac, cur_rec_frac, tol)) return true;
+
+            prev_rec_frac = clone(cur_rec_frac);
+        }
+        return false;
+    }
+
+    // accelerated EM
+    NumericVector rf1(n_rf), rf2(n_rf), rf_extrap(n_rf);
+    double max_step = 1.0; // largest allowed |a|; increased when it's reached
+    const double step_factor = 4.0;
+
+    while(n_iter < max_iterations) {
+        // first EM step
+        double loglik0 = em_step(prev_rec_frac, rf1);
+        n_iter++;
+        loglik_trace.push_back(loglik0);
+
+        if(verbose) {
+            double maxdif = max(abs(prev_rec_frac - rf1));
+            Rprintf("%4d %.12f %.6f\n", n_iter, maxdif, loglik0);
+        }
+
+        cur_rec_frac = clone(rf1);
+        if(rec_frac_converged(prev_rec_frac, rf1, tol)) return true;
+        if(n_iter >= max_iterations) break;
+
+        // second EM step
+        em_step(rf1, rf2);
+        n_iter++;
+
+        cur_rec_frac = clone(rf2);
+        if(rec_frac_converged(rf1, rf2, tol)) return true;
+        if(n_iter >= max_iterations) break;
+
+        // step length
+        double sum_r=0.0, sum_v=0.0;
+        for(int pos=0; pos<n_rf; pos++) {
+            double r = rf1[pos] - prev_rec_frac[pos];
+            double v = rf2[pos] - 2.0*rf1[pos] + prev_rec_frac[pos];
+            sum_r += r*r;
+            sum_v += v*v;
+        }
+        if(sum_v <= 0.0) { // no curvature; continue from r2
+            prev_rec_frac = clone(rf2);
+            continue;
+        }
+        double a = -sqrt(sum_r/sum_v);
+        if(a > -1.0) a = -1.0;
+        if(a < -max_step) a = -max_step;
+        if(a == -max_step) max_step *= step_factor;
+
+        // extrapolate, keeping within the allowed range
+        for(int pos=0; pos<n_rf; pos++) {
+            double r = rf1[pos] - prev_rec_frac[pos];
+            double v = rf2[pos] - 2.0*rf1[pos] + prev_rec_frac[pos];
+            rf_extrap[pos] = prev_rec_frac[pos] - 2.0*a*r + a*a*v;
+            if(rf_extrap[pos] < rf_tol) rf_extrap[pos] = rf_tol;
+            if(rf_extrap[pos] > rf_uptol) rf_extrap[pos] = rf_uptol;
+        }
+
+        // EM step from the extrapolated point; fall back to r2 if the likelihood went down
+        NumericVector rf3(n_rf);
+        double loglik_extrap = em_step(rf_extrap, rf3);
+        n_iter++;
+
+        if(!(loglik_extrap >= loglik0)) { // (also if it's NaN)
+            prev_rec_frac = clone(rf2);
+            max_step = std::max(1.0, max_step/step_factor);
+        }
+        else {
+            prev_rec_frac = rf3;
+            cur_rec_frac = clone(rf3);
+        }
+    }
+
+    return false;
+}
+
+
 // same init, emit, step for groups with common sex and cross_info
 //
 //     cross_group = vector of integers that categorizes individuals into groups with common is_female and cross_info
@@ -112,6 +298,9 @@ NumericVector est_map2_lowmem(const String crosstype,
 //     unique_cross_group = vector of indexes to the first individual in each category, for grabbing is_female
 //                          and cross_info for the category
 //
+// The E-step is multi-threaded over individuals (or batches of individuals, with scaled_hmm);
+// each thread accumulates the sums of gamma within each cross group, for each interval.
+//
 NumericVector est_map2_grouped(const String crosstype,
                                const IntegerMatrix& genotypes, // columns are individuals, rows are markers
                                const IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
@@ -124,7 +313,10 @@ NumericVector est_map2_grouped(const String crosstype,
                                const double error_prob,
                                const int max_iterations,
                                const double tol,
-                               const bool verbose)
+                               const bool verbose,
+                               const bool scaled_hmm,
+                               const bool accel_em,
+                               const int n_threads)
 {
     const int n_ind = genotypes.cols();
     const int n_mar = genotypes.rows();
@@ -138,9 +330,11 @@ NumericVector est_map2_grouped(const String crosstype,
     for(int i=0; i<n_cross_group; i++) {
         if(unique_cross_group[i] < 0 || unique_cross_group[i] >= n_ind)
             throw std::range_error("unique_cross_group values out of range [0, n_ind-1]");
+    }
     for(int i=0; i<n_ind; i++) {
         if(cross_group[i] < 0 || cross_group[i] >= n_cross_group)
             throw std::range_error("cross_group values out of range [0, n_group-1]");
+    }
     #endif
 
     QTLCross* cross_pu = QTLCross::Create(crosstype);
@@ -150,21 +344,22 @@ NumericVector est_map2_grouped(const String crosstype,
     else cross = cross_pu;
 
     NumericVector cur_rec_frac(n_rf);
-    NumericVector prev_rec_frac(clone(rec_frac));
 
     // marker index for forward/backward equations
     IntegerVector marker_index(n_mar);
     for(int i=0; i<n_mar; i++) marker_index[i] = i;
 
-    // 3-d array to contain sum(gamma(il,ir)) for each interval
+    // for each thread, sum(gamma(il,ir)) for each interval and cross group
+    // (see est_rec_frac_grouped() above)
     const int n_gen = cross->ngen(is_X_chr);
     const int n_gen_sq = n_gen*n_gen;
-    const int n_gen_sq_times_n_ind = n_gen_sq * n_ind;
-    NumericVector full_gamma(n_gen_sq_times_n_ind * n_rf);
+    std::vector< std::vector<double> > group_gamma(n_threads);
+    for(int thread=0; thread<n_threads; thread++)
+        group_gamma[thread].resize(n_gen_sq * n_cross_group * n_rf);
 
     // pre-calculate stuff; need separate ones for each unique value of is_female/cross_info
     const int max_obsgeno = max(genotypes);
-    std::vector<std::vector<NumericMatrix> > emit_matrix(n_cross_group);
+    std::vector<EmitMatrices> emit_matrix(n_cross_group);
     std::vector<NumericVector> init_vector(n_cross_group);
     std::vector<IntegerVector> poss_gen(n_cross_group);
     IntegerVector n_poss_gen(n_cross_group);
@@ -181,111 +376,196 @@ NumericVector est_map2_grouped(const String crosstype,
                                           is_female[unique_cross_group[i]],
                                           cross_info(_,unique_cross_group[i]));
         n_poss_gen[i] = poss_gen[i].size();
+
+        if(scaled_hmm) { // convert to probability scale
+            emit_matrix[i] = exp_matrices(emit_matrix[i]);
+            init_vector[i] = exp(init_vector[i]);
+        }
+    }
+
+    // used only in scaled HMM: individuals in batches of HMM_BATCH_SIZE, handled together
+    // (see hmm_forwback2.h)
+    std::vector< std::vector<int> > batches;
+    if(scaled_hmm) batches = hmm_batches(cross_group, n_cross_group);
+    const int n_batches = batches.size();
+    const int max_batch = scaled_hmm ? HMM_BATCH_SIZE : 1;
+
+    // workspace for each thread, for the forward/backward equations and gamma
+    std::vector< std::vector<double> > alpha(n_threads), beta(n_threads), gamma(n_threads);
+    std::vector< std::vector<double> > log_scale_alpha(n_threads), log_scale_beta(n_threads);
+    for(int thread=0; thread<n_threads; thread++) {
+        alpha[thread].resize(n_gen*n_mar*max_batch);
+        beta[thread].resize(n_gen*n_mar*max_batch);
+        gamma[thread].resize(n_gen_sq);
+        log_scale_alpha[thread].resize(n_mar*max_batch);
+        log_scale_beta[thread].resize(n_mar*max_batch);
     }
 
-    bool converged = false; // flag for convergence
-    for(int it=0; it<max_iterations; it++) {
+    // one EM step, from rf_in to rf_out; returns the log likelihood at rf_in
+    std::vector<double> thread_loglik(n_threads);
+    auto em_step = [&](const NumericVector& rf_in, NumericVector& rf_out) {
 
         // transition matrix for current rec fracs
         std::vector<std::vector<NumericMatrix> > step_matrix(n_cross_group);
         for(int i=0; i<n_cross_group; i++) {
-            step_matrix[i] = cross->calc_stepmatrix(prev_rec_frac, is_X_chr,
+            step_matrix[i] = cross->calc_stepmatrix(rf_in, is_X_chr,
                                                     is_female[unique_cross_group[i]],
                                                     cross_info(_,unique_cross_group[i]));
+            if(scaled_hmm) step_matrix[i] = exp_matrices(step_matrix[i]);
         }
 
-        // zero the full_gamma array
-        full_gamma.fill(0.0);
-
-        for(int ind=0; ind < n_ind; ind++) {
-            Rcpp::checkUserInterrupt();  // check for ^C from user
+        // zero the sums of gamma and the log likelihood
+        for(int thread=0; thread<n_threads; thread++) {
+            std::fill(group_gamma[thread].begin(), group_gamma[thread].end(), 0.0);
+            thread_loglik[thread] = 0.0;
+        }
 
-            const int this_n_poss_gen = n_poss_gen[cross_group[ind]];
+        if(scaled_hmm) {
+            parallel_for(n_batches, n_threads, [&](const int batch, const int thread) {
+                const std::vector<int>& batch_ind = batches[batch];
+                const int W = batch_ind.size(); // HMM_BATCH_SIZE or 1
+                const int group = cross_group[batch_ind[0]];
+                const int this_n_poss_gen = n_poss_gen[group];
+                double *a = alpha[thread].data();
+                double *b = beta[thread].data();
+                double *g = gamma[thread].data();
+
+                // forward and backward equations, on probability scale
+                // a[(pos*this_n_poss_gen + i)*W + w] is for individual batch_ind[w]
+                if(W == HMM_BATCH_SIZE) {
+                    const int *geno[HMM_BATCH_SIZE];
+                    for(int w=0; w<W; w++) geno[w] = &(genotypes(0,batch_ind[w]));
+                    forwardEquations2_scaled_batch(geno, init_vector[group], emit_matrix[group],
+                                                   step_matrix[group], marker_index, poss_gen[group],
+                                                   a, log_scale_alpha[thread].data());
+                    backwardEquations2_scaled_batch(geno, init_vector[group], emit_matrix[group],
+                                                    step_matrix[group], marker_index, poss_gen[group],
+                                                    b, log_scale_beta[thread].data());
+                }
+                else {
+                    const int *geno = &(genotypes(0,batch_ind[0]));
+                    forwardEquations2_scaled(geno, init_vector[group], emit_matrix[group],
+                                             step_matrix[group], marker_index, poss_gen[group],
+                                             a, log_scale_alpha[thread].data());
+                    backwardEquations2_scaled(geno, init_vector[group], emit_matrix[group],
+                                              step_matrix[group], marker_index, poss_gen[group],
+                                              b, log_scale_beta[thread].data());
+                }
 
-            // forward and backward equations
-            NumericMatrix alpha = forwardEquations2(genotypes(_,ind),
-                                                    init_vector[cross_group[ind]],
-                                                    emit_matrix[cross_group[ind]],
-                                                    step_matrix[cross_group[ind]],
-                                                    marker_index,
-                                                    poss_gen[cross_group[ind]]);
-            NumericMatrix beta = backwardEquations2(genotypes(_,ind),
-                                                    init_vector[cross_group[ind]],
-                                                    emit_matrix[cross_group[ind]],
-                                                    step_matrix[cross_group[ind]],
-                                                    marker_index,
-                                                    poss_gen[cross_group[ind]]);
+                for(int w=0; w<W; w++) {
+                    const int ind = batch_ind[w];
+
+                    // log likelihood is the sum of the log scale factors
+                    for(int pos=0; pos<n_mar; pos++)
+                        thread_loglik[thread] += log_scale_alpha[thread][pos*W + w];
+
+                    for(int pos=0; pos<n_rf; pos++) {
+                        // calculate gamma, proportional to Pr(v1, v2, O)
+                        const NumericMatrix& this_step = step_matrix[group][pos];
+                        const double* this_emit = emit_matrix[group].row(pos+1, genotypes(pos+1,ind));
+                        const double* alpha_left = a + pos*this_n_poss_gen*W + w;
+                        const double* beta_right = b + (pos+1)*this_n_poss_gen*W + w;
+                        double sum_gamma=0.0;
+                        for(int ir=0; ir<this_n_poss_gen; ir++) {
+                            const double beta_emit = beta_right[ir*W] * this_emit[ir];
+                            for(int il=0; il<this_n_poss_gen; il++) {
+                                double val = g[ir*this_n_poss_gen + il] = alpha_left[il*W] * this_step(il,ir) * beta_emit;
+                                sum_gamma += val;
+                            }
+                        }
 
-            for(int pos=0; pos<n_rf; pos++) {
-                // calculate gamma = log Pr(v1, v2, O)
-                NumericMatrix gamma(this_n_poss_gen, this_n_poss_gen);
-                double sum_gamma=0.0;
-                bool sum_gamma_undef = true;
-                for(int ir=0; ir<this_n_poss_gen; ir++) {
-                    for(int il=0; il<this_n_poss_gen; il++) {
-                        gamma(il,ir) = alpha(il,pos) + beta(ir,pos+1) +
-                            emit_matrix[cross_group[ind]][pos+1](genotypes(pos+1,ind),ir) +
-                            step_matrix[cross_group[ind]][pos](il,ir);
-
-                        if(sum_gamma_undef) {
-                            sum_gamma_undef = false;
-                            sum_gamma = gamma(il,ir);
+                        // add to sums for this interval and cross group
+                        double *this_sum = group_gamma[thread].data() + (pos*n_cross_group + group)*n_gen_sq;
+                        for(int ir=0; ir<this_n_poss_gen; ir++) {
+                            int gr_by_n_gen = (poss_gen[group][ir]-1)*n_gen;
+                            for(int il=0; il<this_n_poss_gen; il++) {
+                                int gl = poss_gen[group][il]-1;
+                                this_sum[gr_by_n_gen + gl] += g[ir*this_n_poss_gen + il] / sum_gamma;
+                            }
                         }
-                        else {
-                            sum_gamma = addlog(sum_gamma, gamma(il,ir));
+                    } // loop over marker intervals
+                } // loop over individuals in batch
+            }); // loop over batches
+        }
+        else {
+            parallel_for(n_ind, n_threads, [&](const int ind, const int thread) {
+                const int group = cross_group[ind];
+                const int this_n_poss_gen = n_poss_gen[group];
+                const int *geno = &(genotypes(0,ind));
+                double *a = alpha[thread].data();
+                double *b = beta[thread].data();
+                double *g = gamma[thread].data();
+
+                // forward and backward equations
+                forwardEquations2(geno, init_vector[group], emit_matrix[group], step_matrix[group],
+                                  marker_index, poss_gen[group], a);
+                backwardEquations2(geno, init_vector[group], emit_matrix[group], step_matrix[group],
+                                   marker_index, poss_gen[group], b);
+
+                double curloglik = a[n_rf*this_n_poss_gen];
+                for(int i=1; i<this_n_poss_gen; i++)
+                    curloglik = addlog(curloglik, a[n_rf*this_n_poss_gen + i]);
+                thread_loglik[thread] += curloglik;
+
+                for(int pos=0; pos<n_rf; pos++) {
+                    // calculate gamma = log Pr(v1, v2, O)
+                    double sum_gamma=0.0;
+                    bool sum_gamma_undef = true;
+                    for(int ir=0; ir<this_n_poss_gen; ir++) {
+                        for(int il=0; il<this_n_poss_gen; il++) {
+                            double val = g[ir*this_n_poss_gen + il] =
+                                a[pos*this_n_poss_gen + il] + b[(pos+1)*this_n_poss_gen + ir] +
+                                emit_matrix[group](pos+1, geno[pos+1], ir) +
+                                step_matrix[group][pos](il,ir);
+
+                            if(sum_gamma_undef) {
+                                sum_gamma_undef = false;
+                                sum_gamma = val;
+                            }
+                            else {
+                                sum_gamma = addlog(sum_gamma, val);
+                            }
                         }
                     }
-                }
 
-                // add to full_gamma array of dim n_rf x n_ind x n_gen x n_gen
-                const int offset = n_gen_sq_times_n_ind*pos + n_gen_sq*ind;
-                for(int ir=0; ir<this_n_poss_gen; ir++) {
-                    int gr_by_n_gen = (poss_gen[cross_group[ind]][ir]-1)*n_gen;
-                    for(int il=0; il<this_n_poss_gen; il++) {
-                        int gl = poss_gen[cross_group[ind]][il]-1;
-                        full_gamma[offset + gr_by_n_gen + gl] += exp(gamma(il,ir) - sum_gamma);
+                    // add to sums for this interval and cross group
+                    double *this_sum = group_gamma[thread].data() + (pos*n_cross_group + group)*n_gen_sq;
+                    for(int ir=0; ir<this_n_poss_gen; ir++) {
+                        int gr_by_n_gen = (poss_gen[group][ir]-1)*n_gen;
+                        for(int il=0; il<this_n_poss_gen; il++) {
+                            int gl = poss_gen[group][il]-1;
+                            this_sum[gr_by_n_gen + gl] += exp(g[ir*this_n_poss_gen + il] - sum_gamma);
+                        }
                     }
-                }
-
-            } // loop over marker intervals
-
-
-        } // loop over individuals
-
-        // re-estimate rec'n fractions
-        for(int pos=0; pos < n_rf; pos++) {
-            // pull out the part for that position
-            NumericVector sub_gamma(n_gen_sq_times_n_ind);
-            std::copy(full_gamma.begin()+(n_gen_sq_times_n_ind*pos),
-                      full_gamma.begin()+(n_gen_sq_times_n_ind*(pos+1)),
-                      sub_gamma.begin());
-            cur_rec_frac[pos] = cross->est_rec_frac(sub_gamma, is_X_chr, cross_info, n_gen);
+                } // loop over marker intervals
+            }); // loop over individuals
         }
 
-        // don't let rec fracs get too small
-        for(int pos=0; pos<n_rf; pos++) {
-            if(cur_rec_frac[pos] < rf_tol) cur_rec_frac[pos] = rf_tol;
-            if(cur_rec_frac[pos] > rf_uptol) cur_rec_frac[pos] = rf_uptol;
+        // combine the threads' sums
+        for(int thread=1; thread<n_threads; thread++) {
+            for(int i=0; i<n_gen_sq * n_cross_group * n_rf; i++)
+                group_gamma[0][i] += group_gamma[thread][i];
         }
 
-        if(verbose) {
-            double maxdif = max(abs(prev_rec_frac - cur_rec_frac));
-            Rprintf("%4d %.12f\n", it+1, maxdif);
-        }
+        // re-estimate rec'n fractions
+        est_rec_frac_grouped(cross, group_gamma[0], is_X_chr, cross_info,
+                             unique_cross_group, n_gen, rf_out);
 
-        // check convergence
-        converged = true;
+        // don't let rec fracs get too small
         for(int pos=0; pos<n_rf; pos++) {
-            if(fabs(prev_rec_frac[pos] - cur_rec_frac[pos]) > tol*(cur_rec_frac[pos]+tol*100.0)) {
-                converged = false;
-                break;
-            }
+            if(rf_out[pos] < rf_tol) rf_out[pos] = rf_tol;
+            if(rf_out[pos] > rf_uptol) rf_out[pos] = rf_uptol;
         }
 
-        if(converged) break;
+        double loglik = 0.0;
+        for(int thread=0; thread<n_threads; thread++) loglik += thread_loglik[thread];
+        return loglik;
+    };
 
-        prev_rec_frac = clone(cur_rec_frac);
-    } // end loop over iterations
+    int n_iter;
+    std::vector<double> loglik_trace;
+    bool converged = est_map2_em(em_step, rec_frac, cur_rec_frac, max_iterations, tol,
+                                 rf_tol, rf_uptol, accel_em, verbose, n_iter, loglik_trace);
 
     if(!converged)
         r_warning("est_map reaching maximum iterations without converging");
@@ -296,43 +576,47 @@ NumericVector est_map2_grouped(const String crosstype,
         step_matrix[i] = cross->calc_stepmatrix(cur_rec_frac, is_X_chr,
                                                 is_female[unique_cross_group[i]],
                                                 cross_info(_,unique_cross_group[i]));
+        if(scaled_hmm) step_matrix[i] = exp_matrices(step_matrix[i]);
     }
 
-
     // calculate log likelihood
-    double loglik = 0.0;
-    for(int ind=0; ind<n_ind; ind++) {
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        const int this_n_poss_gen = n_poss_gen[cross_group[ind]];
+    std::vector<double> ind_loglik(n_ind);
+    parallel_for(n_ind, n_threads, [&](const int ind, const int thread) {
+        const int group = cross_group[ind];
+        const int this_n_poss_gen = n_poss_gen[group];
+        const int *geno = &(genotypes(0,ind));
+        double *a = alpha[thread].data();
         double curloglik=0.0;
 
-        // forward
-        NumericMatrix alpha = forwardEquations2(genotypes(_,ind),
-                                                init_vector[cross_group[ind]],
-                                                emit_matrix[cross_group[ind]],
-                                                step_matrix[cross_group[ind]],
-                                                marker_index,
-                                                poss_gen[cross_group[ind]]);
-
-        bool curloglik_undef = true;
-        for(int i=0; i<this_n_poss_gen; i++) {
-            if(curloglik_undef) {
-                curloglik_undef = false;
-                curloglik = alpha(i,n_rf);
-            }
-            else {
-                curloglik = addlog(curloglik, alpha(i, n_rf));
-            }
+        if(scaled_hmm) {
+            // forward, on probability scale; log likelihood is the sum of the log scale factors
+            double *log_scale = log_scale_alpha[thread].data();
+            forwardEquations2_scaled(geno, init_vector[group], emit_matrix[group], step_matrix[group],
+                                     marker_index, poss_gen[group], a, log_scale);
+            for(int pos=0; pos<n_mar; pos++) curloglik += log_scale[pos];
         }
-        loglik += curloglik;
-    }
+        else {
+            // forward
+            forwardEquations2(geno, init_vector[group], emit_matrix[group], step_matrix[group],
+                              marker_index, poss_gen[group], a);
+
+            curloglik = a[n_rf*this_n_poss_gen];
+            for(int i=1; i<this_n_poss_gen; i++)
+                curloglik = addlog(curloglik, a[n_rf*this_n_poss_gen + i]);
+        }
+        ind_loglik[ind] = curloglik;
+    });
+
+    double loglik = 0.0;
+    for(int ind=0; ind<n_ind; ind++) loglik += ind_loglik[ind];
 
     if(verbose) {
         Rprintf("loglik = %.3f\n", loglik);
     }
 
     cur_rec_frac.attr("loglik") = loglik;
+    cur_rec_frac.attr("n_iter") = n_iter;
+    cur_rec_frac.attr("loglik_trace") = wrap(loglik_trace);
     if(cross_pu != cross) delete cross_pu;
     delete cross;
     return cur_rec_frac;
@@ -342,6 +626,10 @@ NumericVector est_map2_grouped(const String crosstype,
 // Need same set of possible genotypes for all individuals,
 // and same basic structure for transition matrix, but reorder transition matrix by founder order
 // (for riself8 and riself16)
+//
+// The transition matrix for an individual is that for the plain founder order, with the
+// founders relabeled, and so gamma is relabeled to the plain founder order and summed across
+// individuals, for each interval. The E-step is multi-threaded over individuals.
 NumericVector est_map2_founderorder(const String crosstype,
                                     const IntegerMatrix& genotypes, // columns are individuals, rows are markers
                                     const IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
@@ -354,7 +642,10 @@ NumericVector est_map2_founderorder(const String crosstype,
                                     const double error_prob,
                                     const int max_iterations,
                                     const double tol,
-                                    const bool verbose)
+                                    const bool verbose,
+                                    const bool scaled_hmm,
+                                    const bool accel_em,
+                                    const int n_threads)
 {
     const int n_ind = genotypes.cols();
     const int n_mar = genotypes.rows();
@@ -370,143 +661,199 @@ NumericVector est_map2_founderorder(const String crosstype,
     else cross = cross_pu;
 
     NumericVector cur_rec_frac(n_rf);
-    NumericVector prev_rec_frac(clone(rec_frac));
 
     // marker index for forward/backward equations
     IntegerVector marker_index(n_mar);
     for(int i=0; i<n_mar; i++) marker_index[i] = i;
 
-    // 3-d array to contain sum(gamma(il,ir)) for each interval
+    // for each thread, sum(gamma(il,ir)) for each interval, in the plain founder order
     const int n_gen = cross->ngen(is_X_chr);
     const int n_gen_sq = n_gen*n_gen;
-    const int n_gen_sq_times_n_ind = n_gen_sq * n_ind;
-    NumericVector full_gamma(n_gen_sq_times_n_ind * n_rf);
+    std::vector< std::vector<double> > sum_gamma(n_threads);
+    for(int thread=0; thread<n_threads; thread++)
+        sum_gamma[thread].resize(n_gen_sq * n_rf);
 
     // basic founder order
     const int n_founders = cross_info.rows();
     IntegerVector plain_founder_order(n_founders);
     for(int i=0; i<n_founders; i++) plain_founder_order[i] = i+1;
 
+    // for est_rec_frac: the sums go with the first individual, given the plain founder order
+    IntegerMatrix plain_cross_info = clone(cross_info);
+    plain_cross_info(_,0) = plain_founder_order;
+    IntegerVector one_unique_group(1);
+
     // pre-calculate stuff; need separate ones for each unique value of is_female/cross_info
     const int max_obsgeno = max(genotypes);
-    std::vector<NumericMatrix> emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno,
-                                                                    founder_geno,
-                                                                    is_X_chr, false, plain_founder_order);
+    EmitMatrices emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno,
+                                                      founder_geno,
+                                                      is_X_chr, false, plain_founder_order);
     NumericVector init_vector = cross->calc_initvector(is_X_chr, false, plain_founder_order);
     IntegerVector poss_gen = cross->possible_gen(is_X_chr, false, plain_founder_order);
     const int n_poss_gen = poss_gen.size();
     if(n_poss_gen != n_founders)
         throw std::range_error("no. possible genotypes != no. founders");
 
+    if(scaled_hmm) { // convert to probability scale
+        emit_matrix = exp_matrices(emit_matrix);
+        init_vector = exp(init_vector);
+    }
+
     // inverted index of founder orders
     IntegerMatrix founder_index(n_founders, n_ind);
     for(int ind=0; ind<n_ind; ind++)
         founder_index(_,ind) = invert_founder_index(cross_info(_,ind));
 
-    bool converged = false; // flag for convergence
-    for(int it=0; it<max_iterations; it++) {
-
-        // transition matrix for current rec fracs
-        std::vector<NumericMatrix> step_matrix = cross->calc_stepmatrix(prev_rec_frac, is_X_chr,
-                                                                        false, plain_founder_order);
+    // workspace for each thread: reordered step matrix, forward/backward equations, and gamma
+    std::vector< std::vector<NumericMatrix> > ind_step_matrix(n_threads);
+    std::vector< std::vector<double> > alpha(n_threads), beta(n_threads), gamma(n_threads);
+    std::vector< std::vector<double> > log_scale_alpha(n_threads), log_scale_beta(n_threads);
+    for(int thread=0; thread<n_threads; thread++) {
+        ind_step_matrix[thread].resize(n_rf);
+        for(int pos=0; pos<n_rf; pos++)
+            ind_step_matrix[thread][pos] = NumericMatrix(n_poss_gen, n_poss_gen);
+        alpha[thread].resize(n_poss_gen*n_mar);
+        beta[thread].resize(n_poss_gen*n_mar);
+        gamma[thread].resize(n_poss_gen*n_poss_gen);
+        log_scale_alpha[thread].resize(n_mar);
+        log_scale_beta[thread].resize(n_mar);
+    }
 
-        // zero the full_gamma array
-        full_gamma.fill(0.0);
+    // reorder step matrix for an individual, into a thread's workspace
+    auto reorder_step_matrix = [&](const std::vector<NumericMatrix>& step_matrix, const int ind, const int thread) {
+        for(int pos=0; pos<n_rf; pos++) {
+            NumericMatrix& this_step = ind_step_matrix[thread][pos];
+            for(int f1=0; f1<n_founders; f1++) {
+                this_step(f1,f1) = step_matrix[pos](f1,f1); // diagonal all the same
+                for(int f2=f1+1; f2<n_founders; f2++)
+                    this_step(f1,f2) = this_step(f2,f1) =
+                        step_matrix[pos](founder_index(f1,ind), founder_index(f2,ind));
+            }
+        }
+    };
 
-        for(int ind=0; ind < n_ind; ind++) {
+    // one EM step, from rf_in to rf_out; returns the log likelihood at rf_in
+    std::vector<double> thread_loglik(n_threads);
+    auto em_step = [&](const NumericVector& rf_in, NumericVector& rf_out) {
 
-            Rcpp::checkUserInterrupt();  // check for ^C from user
+        // transition matrix for current rec fracs
+        std::vector<NumericMatrix> step_matrix = cross->calc_stepmatrix(rf_in, is_X_chr,
+                                                                        false, plain_founder_order);
+        if(scaled_hmm) step_matrix = exp_matrices(step_matrix);
 
-            // reorder step matrix for this individual
-            std::vector<NumericMatrix> ind_step_matrix(n_rf);
-            for(int pos=0; pos<n_rf; pos++) {
-                NumericMatrix this_step(n_poss_gen, n_poss_gen);
-                for(int f1=0; f1<n_founders; f1++) {
-                    this_step(f1,f1) = step_matrix[pos](f1,f1); // diagonal all the same
-                    for(int f2=f1+1; f2<n_founders; f2++)
-                        this_step(f1,f2) = this_step(f2,f1) =
-                            step_matrix[pos](founder_index(f1,ind), founder_index(f2,ind));
+        // zero the sums of gamma and the log likelihood
+        for(int thread=0; thread<n_threads; thread++) {
+            std::fill(sum_gamma[thread].begin(), sum_gamma[thread].end(), 0.0);
+            thread_loglik[thread] = 0.0;
+        }
 
-                }
-                ind_step_matrix[pos] = this_step;
+        parallel_for(n_ind, n_threads, [&](const int ind, const int thread) {
+            const std::vector<NumericMatrix>& this_step_matrix = ind_step_matrix[thread];
+            reorder_step_matrix(step_matrix, ind, thread);
+
+            const int *geno = &(genotypes(0,ind));
+            double *a = alpha[thread].data();
+            double *b = beta[thread].data();
+            double *g = gamma[thread].data();
+
+            if(scaled_hmm) {
+                // forward and backward equations, on probability scale
+                forwardEquations2_scaled(geno, init_vector, emit_matrix, this_step_matrix,
+                                         marker_index, poss_gen, a, log_scale_alpha[thread].data());
+                backwardEquations2_scaled(geno, init_vector, emit_matrix, this_step_matrix,
+                                          marker_index, poss_gen, b, log_scale_beta[thread].data());
+
+                // log likelihood is the sum of the log scale factors
+                for(int pos=0; pos<n_mar; pos++)
+                    thread_loglik[thread] += log_scale_alpha[thread][pos];
+            }
+            else {
+                // forward and backward equations
+                forwardEquations2(geno, init_vector, emit_matrix, this_step_matrix,
+                                  marker_index, poss_gen, a);
+                backwardEquations2(geno, init_vector, emit_matrix, this_step_matrix,
+                                   marker_index, poss_gen, b);
+
+                double curloglik = a[n_rf*n_poss_gen];
+                for(int i=1; i<n_poss_gen; i++)
+                    curloglik = addlog(curloglik, a[n_rf*n_poss_gen + i]);
+                thread_loglik[thread] += curloglik;
             }
-
-            // forward and backward equations
-            NumericMatrix alpha = forwardEquations2(genotypes(_,ind), init_vector, emit_matrix, ind_step_matrix,
-                                                    marker_index, poss_gen);
-            NumericMatrix beta = backwardEquations2(genotypes(_,ind), init_vector, emit_matrix, ind_step_matrix,
-                                                    marker_index, poss_gen);
 
             for(int pos=0; pos<n_rf; pos++) {
-                // calculate gamma = log Pr(v1, v2, O)
-                NumericMatrix gamma(n_poss_gen, n_poss_gen);
-                double sum_gamma=0.0;
-                bool sum_gamma_undef = true;
-                for(int ir=0; ir<n_poss_gen; ir++) {
-                    for(int il=0; il<n_poss_gen; il++) {
-                        gamma(il,ir) = alpha(il,pos) + beta(ir,pos+1) +
-                            emit_matrix[pos+1](genotypes(pos+1,ind),ir) +
-                            ind_step_matrix[pos](il,ir);
-
-                        if(sum_gamma_undef) {
-                            sum_gamma_undef = false;
-                            sum_gamma = gamma(il,ir);
+                const double* this_emit = emit_matrix.row(pos+1, geno[pos+1]);
+                const double* alpha_left = a + pos*n_poss_gen;
+                const double* beta_right = b + (pos+1)*n_poss_gen;
+                double sum_gamma_pos=0.0;
+
+                if(scaled_hmm) {
+                    // calculate gamma, proportional to Pr(v1, v2, O)
+                    for(int ir=0; ir<n_poss_gen; ir++) {
+                        const double beta_emit = beta_right[ir] * this_emit[ir];
+                        for(int il=0; il<n_poss_gen; il++) {
+                            double val = g[ir*n_poss_gen + il] = alpha_left[il] * this_step_matrix[pos](il,ir) * beta_emit;
+                            sum_gamma_pos += val;
                         }
-                        else {
-                            sum_gamma = addlog(sum_gamma, gamma(il,ir));
+                    }
+                    for(int i=0; i<n_poss_gen*n_poss_gen; i++) g[i] /= sum_gamma_pos;
+                }
+                else {
+                    // calculate gamma = log Pr(v1, v2, O)
+                    bool sum_gamma_undef = true;
+                    for(int ir=0; ir<n_poss_gen; ir++) {
+                        for(int il=0; il<n_poss_gen; il++) {
+                            double val = g[ir*n_poss_gen + il] = alpha_left[il] + beta_right[ir] +
+                                this_emit[ir] + this_step_matrix[pos](il,ir);
+
+                            if(sum_gamma_undef) {
+                                sum_gamma_undef = false;
+                                sum_gamma_pos = val;
+                            }
+                            else {
+                                sum_gamma_pos = addlog(sum_gamma_pos, val);
+                            }
                         }
                     }
+                    for(int i=0; i<n_poss_gen*n_poss_gen; i++) g[i] = exp(g[i] - sum_gamma_pos);
                 }
 
-                // add to full_gamma array of dim n_rf x n_ind x n_gen x n_gen
-                const int offset = n_gen_sq_times_n_ind*pos + n_gen_sq*ind;
+                // add to sums for this interval, relabeled to the plain founder order
+                double *this_sum = sum_gamma[thread].data() + pos*n_gen_sq;
                 for(int ir=0; ir<n_poss_gen; ir++) {
-                    int gr_by_n_gen = (poss_gen[ir]-1)*n_gen;
+                    int gr_by_n_gen = founder_index(poss_gen[ir]-1, ind)*n_gen;
                     for(int il=0; il<n_poss_gen; il++) {
-                        int gl = poss_gen[il]-1;
-                        full_gamma[offset + gr_by_n_gen + gl] += exp(gamma(il,ir) - sum_gamma);
+                        int gl = founder_index(poss_gen[il]-1, ind);
+                        this_sum[gr_by_n_gen + gl] += g[ir*n_poss_gen + il];
                     }
                 }
             } // loop over marker intervals
+        }); // loop over individuals
 
-        } // loop over individuals
+        // combine the threads' sums
+        for(int thread=1; thread<n_threads; thread++) {
+            for(int i=0; i<n_gen_sq * n_rf; i++)
+                sum_gamma[0][i] += sum_gamma[thread][i];
+        }
 
         // re-estimate rec'n fractions
-
-        for(int pos=0; pos < n_rf; pos++) {
-            // pull out the part for that position
-            NumericVector sub_gamma(n_gen_sq_times_n_ind);
-            std::copy(full_gamma.begin()+(n_gen_sq_times_n_ind*pos),
-                      full_gamma.begin()+(n_gen_sq_times_n_ind*(pos+1)),
-                      sub_gamma.begin());
-            cur_rec_frac[pos] = cross->est_rec_frac(sub_gamma, is_X_chr, cross_info, n_gen);
-        }
+        est_rec_frac_grouped(cross, sum_gamma[0], is_X_chr, plain_cross_info,
+                             one_unique_group, n_gen, rf_out);
 
         // don't let rec fracs get too small
         for(int pos=0; pos<n_rf; pos++) {
-            if(cur_rec_frac[pos] < rf_tol) cur_rec_frac[pos] = rf_tol;
-            if(cur_rec_frac[pos] > rf_uptol) cur_rec_frac[pos] = rf_uptol;
-        }
-
-        if(verbose) {
-            double maxdif = max(abs(prev_rec_frac - cur_rec_frac));
-            Rprintf("%4d %.12f\n", it+1, maxdif);
-        }
-
-        // check convergence
-        converged = true;
-        for(int pos=0; pos<n_rf; pos++) {
-            if(fabs(prev_rec_frac[pos] - cur_rec_frac[pos]) > tol*(cur_rec_frac[pos]+tol*100.0)) {
-                converged = false;
-                break;
-            }
+            if(rf_out[pos] < rf_tol) rf_out[pos] = rf_tol;
+            if(rf_out[pos] > rf_uptol) rf_out[pos] = rf_uptol;
         }
 
-        if(converged) break;
-
-        prev_rec_frac = clone(cur_rec_frac);
-    } // end loop over iterations
+        double loglik = 0.0;
+        for(int thread=0; thread<n_threads; thread++) loglik += thread_loglik[thread];
+        return loglik;
+    };
 
+    int n_iter;
+    std::vector<double> loglik_trace;
+    bool converged = est_map2_em(em_step, rec_frac, cur_rec_frac, max_iterations, tol,
+                                 rf_tol, rf_uptol, accel_em, verbose, n_iter, loglik_trace);
 
     if(!converged)
         r_warning("est_map reaching maximum iterations without converging");
@@ -514,49 +861,47 @@ NumericVector est_map2_founderorder(const String crosstype,
     // transition matrix for current rec fracs
     std::vector<NumericMatrix> step_matrix = cross->calc_stepmatrix(cur_rec_frac, is_X_chr,
                                                                     false, plain_founder_order);
+    if(scaled_hmm) step_matrix = exp_matrices(step_matrix);
 
     // calculate log likelihood
-    double loglik = 0.0;
-    for(int ind=0; ind<n_ind; ind++) {
-        Rcpp::checkUserInterrupt();  // check for ^C from user
+    std::vector<double> ind_loglik(n_ind);
+    parallel_for(n_ind, n_threads, [&](const int ind, const int thread) {
+        const std::vector<NumericMatrix>& this_step_matrix = ind_step_matrix[thread];
+        reorder_step_matrix(step_matrix, ind, thread);
 
+        const int *geno = &(genotypes(0,ind));
+        double *a = alpha[thread].data();
         double curloglik=0.0;
 
-        // reorder step matrix for this individual
-        std::vector<NumericMatrix> ind_step_matrix(n_rf);
-        for(int pos=0; pos<n_rf; pos++) {
-            NumericMatrix this_step(n_poss_gen, n_poss_gen);
-            for(int f1=0; f1<n_founders; f1++) {
-                this_step(f1,f1) = step_matrix[pos](f1,f1); // diagonal all the same
-                for(int f2=f1+1; f2<n_founders; f2++)
-                    this_step(f1,f2) = this_step(f2,f1) =
-                        step_matrix[pos](founder_index(f1,ind), founder_index(f2,ind));
-            }
-            ind_step_matrix[pos] = this_step;
+        if(scaled_hmm) {
+            // forward, on probability scale; log likelihood is the sum of the log scale factors
+            double *log_scale = log_scale_alpha[thread].data();
+            forwardEquations2_scaled(geno, init_vector, emit_matrix, this_step_matrix,
+                                     marker_index, poss_gen, a, log_scale);
+            for(int pos=0; pos<n_mar; pos++) curloglik += log_scale[pos];
         }
-
-        // forward
-        NumericMatrix alpha = forwardEquations2(genotypes(_,ind), init_vector, emit_matrix, ind_step_matrix,
-                                                marker_index, poss_gen);
-
-        bool curloglik_undef = true;
-        for(int i=0; i<n_poss_gen; i++) {
-            if(curloglik_undef) {
-                curloglik_undef = false;
-                curloglik = alpha(i,n_rf);
-            }
-            else {
-                curloglik = addlog(curloglik, alpha(i, n_rf));
-            }
+        else {
+            // forward
+            forwardEquations2(geno, init_vector, emit_matrix, this_step_matrix,
+                              marker_index, poss_gen, a);
+
+            curloglik = a[n_rf*n_poss_gen];
+            for(int i=1; i<n_poss_gen; i++)
+                curloglik = addlog(curloglik, a[n_rf*n_poss_gen + i]);
         }
-        loglik += curloglik;
-    }
+        ind_loglik[ind] = curloglik;
+    });
+
+    double loglik = 0.0;
+    for(int ind=0; ind<n_ind; ind++) loglik += ind_loglik[ind];
 
     if(verbose) {
         Rprintf("loglik = %.3f\n", loglik);
     }
 
     cur_rec_frac.attr("loglik") = loglik;
+    cur_rec_frac.attr("n_iter") = n_iter;
+    cur_rec_frac.attr("loglik_trace") = wrap(loglik_trace);
     if(cross_pu != cross) delete cross_pu;
     delete cross;
     return cur_rec_frac;
@@ -20,6 +20,12 @@
 //                   values in {0, 1, ..., length(unique_cross_group)-1}
 //     unique_cross_group = vector of indexes to the first individual in each category, for grabbing is_female
 //                          and cross_info for the category
+//
+// accel_em = if true, accelerate EM with SQUAREM-type extrapolation (see est_map2_em())
+// n_threads = number of threads to use, for the E-step and the log likelihood
+//
+// The result has attributes "loglik" (final log likelihood), "n_iter" (number of EM steps),
+// and "loglik_trace" (log likelihood at the start of each iteration, or cycle with accel_em)
 Rcpp::NumericVector est_map2(const Rcpp::String& crosstype,
                              const Rcpp::IntegerMatrix& genotypes, // columns are individuals, rows are markers
                              const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
@@ -32,7 +38,10 @@ Rcpp::NumericVector est_map2(const Rcpp::String& crosstype,
                              const double error_prob,
                              const int max_iterations,
                              const double tol,
-                             const bool verbose);
+                             const bool verbose,
+                             const bool scaled_hmm,
+                             const bool accel_em,
+                             const int n_threads);
 
 
 // just use the low-mem approach
@@ -48,7 +57,10 @@ Rcpp::NumericVector est_map2_lowmem(const Rcpp::String crosstype,
                                     const double error_prob,
                                     const int max_iterations,
                                     const double tol,
-                                    const bool verbose);
+                                    const bool verbose,
+                                    const bool scaled_hmm,
+                                    const bool accel_em,
+                                    const int n_threads);
 
 // same init, emit, step for groups with common sex and cross_info
 Rcpp::NumericVector est_map2_grouped(const Rcpp::String crosstype,
@@ -63,7 +75,10 @@ Rcpp::NumericVector est_map2_grouped(const Rcpp::String crosstype,
                                      const double error_prob,
                                      const int max_iterations,
                                      const double tol,
-                                     const bool verbose);
+                                     const bool verbose,
+                                     const bool scaled_hmm,
+                                     const bool accel_em,
+                                     const int n_threads);
 
 // Need same set of possible genotypes for all individuals,
 // and same basic structure for transition matrix, but reorder transition matrix by founder order
@@ -80,6 +95,9 @@ Rcpp::NumericVector est_map2_founderorder(const Rcpp::String crosstype,
                                           const double error_prob,
                                           const int max_iterations,
                                           const double tol,
-                                          const bool verbose);
+                                          const bool verbose,
+                                          const bool scaled_hmm,
+                                          const bool accel_em,
+                                          const int n_threads);
 
 #endif // HMM_ESTMAP2_H
@@ -2,32 +2,120 @@
 #ifndef HMM_FORWBACK_H
 #define HMM_FORWBACK_H
 
+#include <vector>
+#include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
+#include "cross_dispatch.h"
+#include "hmm_util.h"
+
+// templated on the cross class and number of possible genotypes,
+// as QTLCross and 0 or one of the classes in cross_dispatch.h,
+// and so defined here, in the header
 
 // forward equations
-Rcpp::NumericMatrix forwardEquations(QTLCross* cross,
+template<class CrossT, int N>
+Rcpp::NumericMatrix forwardEquations(CrossT* cross,
                                      const Rcpp::IntegerVector& genotypes,
                                      const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
                                      const bool is_X_chr,
                                      const bool is_female,
                                      const Rcpp::IntegerVector& cross_info,
-                                     const Rcpp::NumericVector& rec_frac,
+                                     const std::vector<Rcpp::NumericMatrix>& step_matrix, // log transition matrices, one per interval
                                      const Rcpp::IntegerVector& marker_index,
                                      const double error_prob,
-                                     const Rcpp::IntegerVector& poss_gen);
+                                     const Rcpp::IntegerVector& poss_gen)
+{
+    int n_pos = marker_index.size();
+
+    // possible genotypes for this chromosome and individual
+    // (N, if > 0, is the number known at compile time; see cross_dispatch.h)
+    const int n_gen = kernel_n_poss_gen(N, poss_gen.size());
+
+    // to contain ln Pr(G_i = g | marker data)
+    Rcpp::NumericMatrix alpha(n_gen, n_pos);
+
+    // initialize alphas
+    Rcpp::IntegerVector fg;
+    if(marker_index[0] >= 0) fg = founder_geno(Rcpp::_, marker_index[0]);
+    for(int i=0; i<n_gen; i++) {
+        int g = poss_gen[i];
+        alpha(i,0) = cross->init(g, is_X_chr, is_female, cross_info);
+        if(marker_index[0] >= 0)
+            alpha(i,0) += cross->emit(genotypes[marker_index[0]], g, error_prob,
+                                      fg, is_X_chr, is_female, cross_info);
+    }
+
+    for(int pos=1; pos<n_pos; pos++) {
+        const Rcpp::NumericMatrix& step = step_matrix[pos-1];
+        if(marker_index[pos]>=0) fg = founder_geno(Rcpp::_, marker_index[pos]);
+
+        for(int ir=0; ir<n_gen; ir++) {
+            alpha(ir,pos) = alpha(0, pos-1) + step(0, ir);
+
+            for(int il=1; il<n_gen; il++)
+                alpha(ir,pos) = addlog(alpha(ir,pos), alpha(il,pos-1) + step(il, ir));
+
+            if(marker_index[pos]>=0)
+                alpha(ir,pos) += cross->emit(genotypes[marker_index[pos]], poss_gen[ir], error_prob,
+                                             fg, is_X_chr, is_female, cross_info);
+        }
+    }
+
+    return alpha;
+}
+
 
 
 // backward Equations
-Rcpp::NumericMatrix backwardEquations(QTLCross* cross,
+template<class CrossT, int N>
+Rcpp::NumericMatrix backwardEquations(CrossT* cross,
                                       const Rcpp::IntegerVector& genotypes,
                                       const Rcpp::IntegerMatrix& founder_geno, // columns are markers, rows are founder lines
                                       const bool is_X_chr,
                                       const bool is_female,
                                       const Rcpp::IntegerVector& cross_info,
-                                      const Rcpp::NumericVector& rec_frac,
+                                      const std::vector<Rcpp::NumericMatrix>& step_matrix, // log transition matrices, one per interval
                                       const Rcpp::IntegerVector& marker_index,
                                       const double error_prob,
-                                      const Rcpp::IntegerVector& poss_gen);
+                                      const Rcpp::IntegerVector& poss_gen)
+{
+    int n_pos = marker_index.size();
+
+    // possible genotypes for this chromosome and individual
+    // (N, if > 0, is the number known at compile time; see cross_dispatch.h)
+    const int n_gen = kernel_n_poss_gen(N, poss_gen.size());
+
+    // to contain ln Pr(G_i = g | marker data)
+    Rcpp::NumericMatrix beta(n_gen, n_pos);
+
+    // backward equations
+    for(int pos = n_pos-2; pos >= 0; pos--) {
+        const Rcpp::NumericMatrix& step = step_matrix[pos];
+
+        // beta + emission probabilities at right position
+        Rcpp::IntegerVector fg;
+        if(marker_index[pos+1] >=0) fg = founder_geno(Rcpp::_, marker_index[pos+1]);
+        NumericVector beta_emit(n_gen);
+        for(int ir=0; ir<n_gen; ir++) {
+            beta_emit[ir] = beta(ir,pos+1);
+            if(marker_index[pos+1] >=0)
+                beta_emit[ir] += cross->emit(genotypes[marker_index[pos+1]], poss_gen[ir], error_prob,
+                                             fg, is_X_chr, is_female, cross_info);
+        }
+
+        for(int il=0; il<n_gen; il++) {
+            for(int ir=0; ir<n_gen; ir++) {
+                double to_add = beta_emit[ir] + step(il, ir);
+
+                if(ir==0) beta(il,pos) = to_add;
+                else beta(il,pos) = addlog(beta(il,pos), to_add);
+            }
+        }
+    }
+
+    return beta;
+}
+
 
 #endif // HMM_FORWBACK_H
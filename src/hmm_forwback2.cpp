@@ -10,39 +10,60 @@
 // forward equations
 NumericMatrix forwardEquations2(const IntegerVector& genotypes,
                                 const Rcpp::NumericVector& init_vector,
-                                const std::vector<Rcpp::NumericMatrix>& emit_matrix,
+                                const EmitMatrices& emit_matrix,
                                 const std::vector<Rcpp::NumericMatrix>& step_matrix,
                                 const IntegerVector& marker_index,
                                 const IntegerVector& poss_gen)
+{
+    NumericMatrix alpha(poss_gen.size(), marker_index.size());
+
+    forwardEquations2(genotypes.begin(), init_vector, emit_matrix, step_matrix,
+                      marker_index, poss_gen, alpha.begin());
+
+    return alpha;
+}
+
+// forward equations, writing to pre-allocated alpha (n_gen x n_pos, by column)
+void forwardEquations2(const int* genotypes,
+                       const Rcpp::NumericVector& init_vector,
+                       const EmitMatrices& emit_matrix,
+                       const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                       const IntegerVector& marker_index,
+                       const IntegerVector& poss_gen,
+                       double* alpha)
 {
     int n_pos = marker_index.size();
 
     // possible genotypes for this chromosome and individual
     int n_gen = poss_gen.size();
 
-    // to contain ln Pr(G_i = g | marker data)
-    NumericMatrix alpha(n_gen, n_pos);
+    // alpha[i + pos*n_gen] contains ln Pr(G_pos = i, marker data up to pos)
 
     // initialize alphas
     for(int i=0; i<n_gen; i++) {
-        alpha(i,0) = init_vector[i];
+        alpha[i] = init_vector[i];
         if(marker_index[0] >= 0)
-            alpha(i,0) += emit_matrix[marker_index[0]](genotypes[marker_index[0]], i);
+            alpha[i] += emit_matrix(marker_index[0], genotypes[marker_index[0]], i);
     }
 
     for(int pos=1; pos<n_pos; pos++) {
+        const double *alpha_left = alpha + (pos-1)*n_gen;
+        double *alpha_here = alpha + pos*n_gen;
+
+        // emission probabilities at this position (NULL if no marker)
+        const double *emit = NULL;
+        if(marker_index[pos]>=0)
+            emit = emit_matrix.row(marker_index[pos], genotypes[marker_index[pos]]);
+
         for(int ir=0; ir<n_gen; ir++) {
-            alpha(ir,pos) = alpha(0, pos-1) + step_matrix[pos-1](0, ir);
+            alpha_here[ir] = alpha_left[0] + step_matrix[pos-1](0, ir);
 
             for(int il=1; il<n_gen; il++)
-                alpha(ir,pos) = addlog(alpha(ir,pos), alpha(il,pos-1) + step_matrix[pos-1](il, ir));
+                alpha_here[ir] = addlog(alpha_here[ir], alpha_left[il] + step_matrix[pos-1](il, ir));
 
-            if(marker_index[pos]>=0)
-                alpha(ir,pos) += emit_matrix[marker_index[pos]](genotypes[marker_index[pos]], ir);
+            if(emit) alpha_here[ir] += emit[ir];
         }
     }
-
-    return alpha;
 }
 
 
@@ -50,32 +71,378 @@ NumericMatrix forwardEquations2(const IntegerVector& genotypes,
 // backward Equations
 NumericMatrix backwardEquations2(const IntegerVector& genotypes,
                                  const Rcpp::NumericVector& init_vector,
-                                 const std::vector<Rcpp::NumericMatrix>& emit_matrix,
+                                 const EmitMatrices& emit_matrix,
                                  const std::vector<Rcpp::NumericMatrix>& step_matrix,
                                  const IntegerVector& marker_index,
                                  const IntegerVector& poss_gen)
+{
+    NumericMatrix beta(poss_gen.size(), marker_index.size());
+
+    backwardEquations2(genotypes.begin(), init_vector, emit_matrix, step_matrix,
+                       marker_index, poss_gen, beta.begin());
+
+    return beta;
+}
+
+// backward equations, writing to pre-allocated beta (n_gen x n_pos, by column)
+void backwardEquations2(const int* genotypes,
+                        const Rcpp::NumericVector& init_vector,
+                        const EmitMatrices& emit_matrix,
+                        const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                        const IntegerVector& marker_index,
+                        const IntegerVector& poss_gen,
+                        double* beta)
 {
     int n_pos = marker_index.size();
 
     // possible genotypes for this chromosome and individual
     int n_gen = poss_gen.size();
 
-    // to contain ln Pr(G_i = g | marker data)
-    NumericMatrix beta(n_gen, n_pos);
+    // beta[i + pos*n_gen] contains ln Pr(marker data after pos | G_pos = i)
+    double *beta_last = beta + (n_pos-1)*n_gen;
+    for(int i=0; i<n_gen; i++) beta_last[i] = 0.0;
 
     // backward equations
     for(int pos = n_pos-2; pos >= 0; pos--) {
+        const double *beta_right = beta + (pos+1)*n_gen;
+        double *beta_here = beta + pos*n_gen;
+
+        // emission probabilities at right position (NULL if no marker)
+        const double *emit = NULL;
+        if(marker_index[pos+1] >=0)
+            emit = emit_matrix.row(marker_index[pos+1], genotypes[marker_index[pos+1]]);
+
         for(int il=0; il<n_gen; il++) {
             for(int ir=0; ir<n_gen; ir++) {
-                double to_add = beta(ir,pos+1) + step_matrix[pos](il, ir);
-                if(marker_index[pos+1] >=0)
-                    to_add += emit_matrix[marker_index[pos+1]](genotypes[marker_index[pos+1]], ir);
+                double to_add = beta_right[ir] + step_matrix[pos](il, ir);
+                if(emit) to_add += emit[ir];
 
-                if(ir==0) beta(il,pos) = to_add;
-                else beta(il,pos) = addlog(beta(il,pos), to_add);
+                if(ir==0) beta_here[il] = to_add;
+                else beta_here[il] = addlog(beta_here[il], to_add);
             }
         }
     }
+}
+
+
+// forward equations, scaled version
+//
+// init_vector, emit_matrix, step_matrix contain probabilities rather than log probabilities
+//
+// alpha(,pos) is rescaled to sum to 1, and log_scale[pos] gets the log of the scale factor,
+// so that log Pr(O_1, ..., O_k) = sum(log_scale[0..k])
+NumericMatrix forwardEquations2_scaled(const IntegerVector& genotypes,
+                                       const NumericVector& init_vector,
+                                       const EmitMatrices& emit_matrix,
+                                       const std::vector<NumericMatrix>& step_matrix,
+                                       const IntegerVector& marker_index,
+                                       const IntegerVector& poss_gen,
+                                       NumericVector& log_scale)
+{
+    int n_pos = marker_index.size();
+
+    NumericMatrix alpha(poss_gen.size(), n_pos);
+    if(log_scale.size() != n_pos) log_scale = NumericVector(n_pos);
+
+    forwardEquations2_scaled(genotypes.begin(), init_vector, emit_matrix, step_matrix,
+                             marker_index, poss_gen, alpha.begin(), log_scale.begin());
+
+    return alpha;
+}
+
+// forward equations, scaled version, writing to pre-allocated alpha (n_gen x n_pos, by column)
+// and log_scale (length n_pos)
+void forwardEquations2_scaled(const int* genotypes,
+                              const NumericVector& init_vector,
+                              const EmitMatrices& emit_matrix,
+                              const std::vector<NumericMatrix>& step_matrix,
+                              const IntegerVector& marker_index,
+                              const IntegerVector& poss_gen,
+                              double* alpha,
+                              double* log_scale)
+{
+    int n_pos = marker_index.size();
+
+    // possible genotypes for this chromosome and individual
+    int n_gen = poss_gen.size();
+
+    // alpha[i + pos*n_gen] contains Pr(G_pos = i, marker data up to pos), rescaled at each position
+
+    // initialize alphas
+    double sum_at_pos = 0.0;
+    for(int i=0; i<n_gen; i++) {
+        alpha[i] = init_vector[i];
+        if(marker_index[0] >= 0)
+            alpha[i] *= emit_matrix(marker_index[0], genotypes[marker_index[0]], i);
+        sum_at_pos += alpha[i];
+    }
+    for(int i=0; i<n_gen; i++) alpha[i] /= sum_at_pos;
+    log_scale[0] = log(sum_at_pos);
+
+    for(int pos=1; pos<n_pos; pos++) {
+        const double *alpha_left = alpha + (pos-1)*n_gen;
+        double *alpha_here = alpha + pos*n_gen;
+        sum_at_pos = 0.0;
+
+        // emission probabilities at this position (NULL if no marker)
+        const double *emit = NULL;
+        if(marker_index[pos]>=0)
+            emit = emit_matrix.row(marker_index[pos], genotypes[marker_index[pos]]);
+
+        for(int ir=0; ir<n_gen; ir++) {
+            // column ir of the step matrix is contiguous
+            const double *step = &(step_matrix[pos-1](0,ir));
+            double val = 0.0;
+            for(int il=0; il<n_gen; il++)
+                val += alpha_left[il] * step[il];
+
+            if(emit) val *= emit[ir];
+
+            alpha_here[ir] = val;
+            sum_at_pos += val;
+        }
+
+        for(int ir=0; ir<n_gen; ir++) alpha_here[ir] /= sum_at_pos;
+        log_scale[pos] = log(sum_at_pos);
+    }
+}
+
+
+// backward equations, scaled version
+//
+// beta(,pos) is proportional to Pr(O_{k+1}, ..., O_n | g_k), rescaled to sum to 1
+// log_scale[pos] gets the log of the scale factor
+NumericMatrix backwardEquations2_scaled(const IntegerVector& genotypes,
+                                        const NumericVector& init_vector,
+                                        const EmitMatrices& emit_matrix,
+                                        const std::vector<NumericMatrix>& step_matrix,
+                                        const IntegerVector& marker_index,
+                                        const IntegerVector& poss_gen,
+                                        NumericVector& log_scale)
+{
+    int n_pos = marker_index.size();
+
+    NumericMatrix beta(poss_gen.size(), n_pos);
+    if(log_scale.size() != n_pos) log_scale = NumericVector(n_pos);
+
+    backwardEquations2_scaled(genotypes.begin(), init_vector, emit_matrix, step_matrix,
+                              marker_index, poss_gen, beta.begin(), log_scale.begin());
 
     return beta;
 }
+
+// backward equations, scaled version, writing to pre-allocated beta (n_gen x n_pos, by column)
+// and log_scale (length n_pos)
+void backwardEquations2_scaled(const int* genotypes,
+                               const NumericVector& init_vector,
+                               const EmitMatrices& emit_matrix,
+                               const std::vector<NumericMatrix>& step_matrix,
+                               const IntegerVector& marker_index,
+                               const IntegerVector& poss_gen,
+                               double* beta,
+                               double* log_scale)
+{
+    int n_pos = marker_index.size();
+
+    // possible genotypes for this chromosome and individual
+    int n_gen = poss_gen.size();
+
+    // beta[i + pos*n_gen] contains Pr(O_{k+1}, ..., O_n | G_k = i), rescaled at each position
+
+    // beta at last position: all equal
+    double *beta_last = beta + (n_pos-1)*n_gen;
+    for(int i=0; i<n_gen; i++) beta_last[i] = 1.0/(double)n_gen;
+    log_scale[n_pos-1] = log((double)n_gen);
+
+    std::vector<double> beta_emit(n_gen); // beta(ir,pos+1) * Pr(O_{pos+1} | ir)
+
+    // backward equations
+    for(int pos = n_pos-2; pos >= 0; pos--) {
+        const double *beta_right = beta + (pos+1)*n_gen;
+        if(marker_index[pos+1] >=0) {
+            const double *emit = emit_matrix.row(marker_index[pos+1], genotypes[marker_index[pos+1]]);
+            for(int ir=0; ir<n_gen; ir++) beta_emit[ir] = beta_right[ir] * emit[ir];
+        }
+        else {
+            for(int ir=0; ir<n_gen; ir++) beta_emit[ir] = beta_right[ir];
+        }
+
+        double *beta_here = beta + pos*n_gen;
+        for(int il=0; il<n_gen; il++) beta_here[il] = 0.0;
+
+        // go down columns of step matrix, which are contiguous
+        for(int ir=0; ir<n_gen; ir++) {
+            const double *step = &(step_matrix[pos](0,ir));
+            const double be = beta_emit[ir];
+            for(int il=0; il<n_gen; il++)
+                beta_here[il] += step[il] * be;
+        }
+
+        double sum_at_pos = 0.0;
+        for(int il=0; il<n_gen; il++) sum_at_pos += beta_here[il];
+        for(int il=0; il<n_gen; il++) beta_here[il] /= sum_at_pos;
+        log_scale[pos] = log(sum_at_pos);
+    }
+}
+
+
+// split individuals into batches for the batched HMM functions
+std::vector< std::vector<int> > hmm_batches(const IntegerVector& cross_group, const int n_cross_group)
+{
+    const int n_ind = cross_group.size();
+
+    // individuals in each cross group
+    std::vector< std::vector<int> > group_ind(n_cross_group);
+    for(int ind=0; ind<n_ind; ind++) group_ind[cross_group[ind]].push_back(ind);
+
+    std::vector< std::vector<int> > result;
+    for(int i=0; i<n_cross_group; i++) {
+        const int n = group_ind[i].size();
+        int j=0;
+        for(; j+HMM_BATCH_SIZE <= n; j += HMM_BATCH_SIZE) // full batches
+            result.push_back(std::vector<int>(group_ind[i].begin()+j, group_ind[i].begin()+j+HMM_BATCH_SIZE));
+        for(; j<n; j++) // the rest individually
+            result.push_back(std::vector<int>(1, group_ind[i][j]));
+    }
+
+    return result;
+}
+
+
+// forward equations, scaled version, for a batch of HMM_BATCH_SIZE individuals
+void forwardEquations2_scaled_batch(const int* const* genotypes,
+                                    const NumericVector& init_vector,
+                                    const EmitMatrices& emit_matrix,
+                                    const std::vector<NumericMatrix>& step_matrix,
+                                    const IntegerVector& marker_index,
+                                    const IntegerVector& poss_gen,
+                                    double* alpha,
+                                    double* log_scale)
+{
+    const int W = HMM_BATCH_SIZE;
+    int n_pos = marker_index.size();
+
+    // possible genotypes for this chromosome and individual
+    int n_gen = poss_gen.size();
+
+    // alpha[(pos*n_gen + i)*W + w] contains Pr(G_pos = i, marker data up to pos) for individual w,
+    // rescaled at each position
+
+    const double *emit[W]; // emission probabilities for each individual at current position
+    double sum_at_pos[W];
+
+    // initialize alphas
+    for(int w=0; w<W; w++) sum_at_pos[w] = 0.0;
+    if(marker_index[0] >= 0) {
+        for(int w=0; w<W; w++) emit[w] = emit_matrix.row(marker_index[0], genotypes[w][marker_index[0]]);
+    }
+    for(int i=0; i<n_gen; i++) {
+        double *alpha_i = alpha + i*W;
+        for(int w=0; w<W; w++) {
+            alpha_i[w] = init_vector[i];
+            if(marker_index[0] >= 0) alpha_i[w] *= emit[w][i];
+            sum_at_pos[w] += alpha_i[w];
+        }
+    }
+    for(int i=0; i<n_gen; i++)
+        for(int w=0; w<W; w++) alpha[i*W+w] /= sum_at_pos[w];
+    for(int w=0; w<W; w++) log_scale[w] = log(sum_at_pos[w]);
+
+    for(int pos=1; pos<n_pos; pos++) {
+        const double *alpha_left = alpha + (pos-1)*n_gen*W;
+        double *alpha_here = alpha + pos*n_gen*W;
+
+        const bool has_marker = (marker_index[pos] >= 0);
+        if(has_marker) {
+            for(int w=0; w<W; w++) emit[w] = emit_matrix.row(marker_index[pos], genotypes[w][marker_index[pos]]);
+        }
+        for(int w=0; w<W; w++) sum_at_pos[w] = 0.0;
+
+        for(int ir=0; ir<n_gen; ir++) {
+            // column ir of the step matrix is contiguous
+            const double *step = &(step_matrix[pos-1](0,ir));
+            double *val = alpha_here + ir*W;
+            for(int w=0; w<W; w++) val[w] = 0.0;
+
+            // (n_gen x W) += step[il] * alpha_left[il, ]; vectorizes over individuals
+            for(int il=0; il<n_gen; il++) {
+                const double s = step[il];
+                const double *a = alpha_left + il*W;
+                for(int w=0; w<W; w++) val[w] += a[w] * s;
+            }
+
+            if(has_marker) {
+                for(int w=0; w<W; w++) val[w] *= emit[w][ir];
+            }
+            for(int w=0; w<W; w++) sum_at_pos[w] += val[w];
+        }
+
+        for(int ir=0; ir<n_gen; ir++)
+            for(int w=0; w<W; w++) alpha_here[ir*W+w] /= sum_at_pos[w];
+        for(int w=0; w<W; w++) log_scale[pos*W+w] = log(sum_at_pos[w]);
+    }
+}
+
+
+// backward equations, scaled version, for a batch of HMM_BATCH_SIZE individuals
+void backwardEquations2_scaled_batch(const int* const* genotypes,
+                                     const NumericVector& init_vector,
+                                     const EmitMatrices& emit_matrix,
+                                     const std::vector<NumericMatrix>& step_matrix,
+                                     const IntegerVector& marker_index,
+                                     const IntegerVector& poss_gen,
+                                     double* beta,
+                                     double* log_scale)
+{
+    const int W = HMM_BATCH_SIZE;
+    int n_pos = marker_index.size();
+
+    // possible genotypes for this chromosome and individual
+    int n_gen = poss_gen.size();
+
+    // beta[(pos*n_gen + i)*W + w] contains Pr(O_{k+1}, ..., O_n | G_k = i) for individual w,
+    // rescaled at each position
+
+    // beta at last position: all equal
+    double *beta_last = beta + (n_pos-1)*n_gen*W;
+    for(int i=0; i<n_gen*W; i++) beta_last[i] = 1.0/(double)n_gen;
+    for(int w=0; w<W; w++) log_scale[(n_pos-1)*W+w] = log((double)n_gen);
+
+    std::vector<double> beta_emit(n_gen*W); // beta(ir,pos+1) * Pr(O_{pos+1} | ir)
+    const double *emit[W];
+    double sum_at_pos[W];
+
+    // backward equations
+    for(int pos = n_pos-2; pos >= 0; pos--) {
+        const double *beta_right = beta + (pos+1)*n_gen*W;
+        if(marker_index[pos+1] >= 0) {
+            for(int w=0; w<W; w++) emit[w] = emit_matrix.row(marker_index[pos+1], genotypes[w][marker_index[pos+1]]);
+            for(int ir=0; ir<n_gen; ir++)
+                for(int w=0; w<W; w++) beta_emit[ir*W+w] = beta_right[ir*W+w] * emit[w][ir];
+        }
+        else {
+            for(int i=0; i<n_gen*W; i++) beta_emit[i] = beta_right[i];
+        }
+
+        double *beta_here = beta + pos*n_gen*W;
+        for(int i=0; i<n_gen*W; i++) beta_here[i] = 0.0;
+
+        // go down columns of step matrix, which are contiguous
+        for(int ir=0; ir<n_gen; ir++) {
+            const double *step = &(step_matrix[pos](0,ir));
+            const double *be = &(beta_emit[ir*W]);
+            for(int il=0; il<n_gen; il++) {
+                const double s = step[il];
+                double *b = beta_here + il*W;
+                for(int w=0; w<W; w++) b[w] += s * be[w];
+            }
+        }
+
+        for(int w=0; w<W; w++) sum_at_pos[w] = 0.0;
+        for(int il=0; il<n_gen; il++)
+            for(int w=0; w<W; w++) sum_at_pos[w] += beta_here[il*W+w];
+        for(int il=0; il<n_gen; il++)
+            for(int w=0; w<W; w++) beta_here[il*W+w] /= sum_at_pos[w];
+        for(int w=0; w<W; w++) log_scale[pos*W+w] = log(sum_at_pos[w]);
+    }
+}
@@ -5,22 +5,130 @@
 
 #include <Rcpp.h>
 #include "cross.h"
+#include "hmm_emitmatrix.h"
 
 // forward equations
 Rcpp::NumericMatrix forwardEquations2(const Rcpp::IntegerVector& genotypes,
                                       const Rcpp::NumericVector& init_vector,
-                                      const std::vector<Rcpp::NumericMatrix>& emit_matrix,
+                                      const EmitMatrices& emit_matrix,
                                       const std::vector<Rcpp::NumericMatrix>& step_matrix,
                                       const Rcpp::IntegerVector& marker_index,
                                       const Rcpp::IntegerVector& poss_gen);
 
+// forward equations, writing to pre-allocated alpha (n_gen x n_pos, by column)
+// (doesn't allocate any R objects, so can be used within threads)
+void forwardEquations2(const int* genotypes,
+                       const Rcpp::NumericVector& init_vector,
+                       const EmitMatrices& emit_matrix,
+                       const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                       const Rcpp::IntegerVector& marker_index,
+                       const Rcpp::IntegerVector& poss_gen,
+                       double* alpha);
+
 
 // backward Equations
 Rcpp::NumericMatrix backwardEquations2(const Rcpp::IntegerVector& genotypes,
                                        const Rcpp::NumericVector& init_vector,
-                                      const std::vector<Rcpp::NumericMatrix>& emit_matrix,
+                                      const EmitMatrices& emit_matrix,
                                       const std::vector<Rcpp::NumericMatrix>& step_matrix,
                                       const Rcpp::IntegerVector& marker_index,
                                       const Rcpp::IntegerVector& poss_gen);
 
+// backward equations, writing to pre-allocated beta (n_gen x n_pos, by column)
+// (doesn't allocate any R objects, so can be used within threads)
+void backwardEquations2(const int* genotypes,
+                        const Rcpp::NumericVector& init_vector,
+                        const EmitMatrices& emit_matrix,
+                        const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                        const Rcpp::IntegerVector& marker_index,
+                        const Rcpp::IntegerVector& poss_gen,
+                        double* beta);
+
+
+// forward equations, scaled version
+//
+// init_vector, emit_matrix, step_matrix should contain probabilities rather than log probabilities
+// (see exp_matrices() in hmm_util.h)
+//
+// alpha(,pos) is rescaled to sum to 1, and log_scale[pos] gets the log of the scale factor,
+// so that log Pr(O_1, ..., O_k) = sum(log_scale[0..k])
+Rcpp::NumericMatrix forwardEquations2_scaled(const Rcpp::IntegerVector& genotypes,
+                                             const Rcpp::NumericVector& init_vector,
+                                             const EmitMatrices& emit_matrix,
+                                             const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                                             const Rcpp::IntegerVector& marker_index,
+                                             const Rcpp::IntegerVector& poss_gen,
+                                             Rcpp::NumericVector& log_scale);
+
+// forward equations, scaled version, writing to pre-allocated alpha (n_gen x n_pos, by column)
+// and log_scale (length n_pos)
+void forwardEquations2_scaled(const int* genotypes,
+                              const Rcpp::NumericVector& init_vector,
+                              const EmitMatrices& emit_matrix,
+                              const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                              const Rcpp::IntegerVector& marker_index,
+                              const Rcpp::IntegerVector& poss_gen,
+                              double* alpha,
+                              double* log_scale);
+
+
+// backward equations, scaled version
+//
+// beta(,pos) is proportional to Pr(O_{k+1}, ..., O_n | g_k), rescaled to sum to 1
+// log_scale[pos] gets the log of the scale factor
+Rcpp::NumericMatrix backwardEquations2_scaled(const Rcpp::IntegerVector& genotypes,
+                                              const Rcpp::NumericVector& init_vector,
+                                              const EmitMatrices& emit_matrix,
+                                              const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                                              const Rcpp::IntegerVector& marker_index,
+                                              const Rcpp::IntegerVector& poss_gen,
+                                              Rcpp::NumericVector& log_scale);
+
+// backward equations, scaled version, writing to pre-allocated beta (n_gen x n_pos, by column)
+// and log_scale (length n_pos)
+void backwardEquations2_scaled(const int* genotypes,
+                               const Rcpp::NumericVector& init_vector,
+                               const EmitMatrices& emit_matrix,
+                               const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                               const Rcpp::IntegerVector& marker_index,
+                               const Rcpp::IntegerVector& poss_gen,
+                               double* beta,
+                               double* log_scale);
+
+
+// batched versions of the scaled forward/backward equations
+//
+// These run HMM_BATCH_SIZE individuals at once, all with the same init_vector,
+// emit_matrix, and step_matrix (that is, in the same cross group).
+// The results are stored with the individuals as the fastest-moving index,
+// so that the inner loops vectorize over individuals:
+//     alpha[(pos*n_gen + i)*HMM_BATCH_SIZE + w], log_scale[pos*HMM_BATCH_SIZE + w]
+// genotypes[w] points to the genotypes for individual w.
+const int HMM_BATCH_SIZE = 8;
+
+// split individuals into batches: HMM_BATCH_SIZE individuals in the same cross group,
+// with the rest (that don't fill a batch) each on their own
+// (cross_group has values in {0, ..., n_cross_group-1})
+std::vector< std::vector<int> > hmm_batches(const Rcpp::IntegerVector& cross_group, const int n_cross_group);
+
+// forward equations, scaled version, for a batch of HMM_BATCH_SIZE individuals
+void forwardEquations2_scaled_batch(const int* const* genotypes,
+                                    const Rcpp::NumericVector& init_vector,
+                                    const EmitMatrices& emit_matrix,
+                                    const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                                    const Rcpp::IntegerVector& marker_index,
+                                    const Rcpp::IntegerVector& poss_gen,
+                                    double* alpha,
+                                    double* log_scale);
+
+// backward equations, scaled version, for a batch of HMM_BATCH_SIZE individuals
+void backwardEquations2_scaled_batch(const int* const* genotypes,
+                                     const Rcpp::NumericVector& init_vector,
+                                     const EmitMatrices& emit_matrix,
+                                     const std::vector<Rcpp::NumericMatrix>& step_matrix,
+                                     const Rcpp::IntegerVector& marker_index,
+                                     const Rcpp::IntegerVector& poss_gen,
+                                     double* beta,
+                                     double* log_scale);
+
 #endif // HMM_FORWBACK2_H
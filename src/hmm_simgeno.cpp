@@ -4,10 +4,122 @@
 #include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
+#include "cross_dispatch.h"
 #include "hmm_util.h"
 #include "hmm_forwback.h"
 #include "random.h"
 
+// loop over individuals, for a particular cross class
+// and number of possible genotypes (see cross_dispatch.h)
+template<class CrossT, int N>
+struct sim_geno_kernel {
+    static IntegerVector run(CrossT* cross,
+                             const bool is_X_chr,
+                             const IntegerMatrix& genotypes,
+                             const IntegerMatrix& founder_geno,
+                             const LogicalVector& is_female,
+                             const IntegerMatrix& cross_info,
+                             const NumericVector& rec_frac,
+                             const IntegerVector& marker_index,
+                             const double error_prob,
+                             const int n_draws)
+    {
+        const int n_ind = genotypes.cols();
+        const int n_pos = marker_index.size();
+
+        // founder genotypes at each marker
+        std::vector<IntegerVector> fg(founder_geno.cols());
+        for(int i=0; i<founder_geno.cols(); i++) fg[i] = founder_geno(_, i);
+
+        const int mat_size = n_pos*n_draws;
+        IntegerVector draws(mat_size*n_ind); // output object
+
+        // individuals with common is_female and cross_info share the transition matrices
+        // (calculated at the group's first individual; individuals are kept
+        //  in order so that the random draws are as before)
+        std::vector< std::vector<int> > groups = group_individuals(is_female, cross_info);
+        std::vector<int> ind_group(n_ind);
+        for(unsigned int group=0; group<groups.size(); group++)
+            for(unsigned int k=0; k<groups[group].size(); k++) ind_group[groups[group][k]] = group;
+        std::vector< std::vector<NumericMatrix> > step_matrix(groups.size());
+
+        for(int ind=0; ind<n_ind; ind++) {
+
+            Rcpp::checkUserInterrupt();  // check for ^C from user
+
+            IntegerVector ind_cross_info = cross_info(_,ind);
+
+            // transition matrices for this individual's group
+            const int group = ind_group[ind];
+            if(step_matrix[group].size() == 0)
+                step_matrix[group] = cross->calc_stepmatrix(rec_frac, is_X_chr, is_female[ind], ind_cross_info);
+            const std::vector<NumericMatrix>& ind_step_matrix = step_matrix[group];
+
+            // possible genotypes for this individual
+            IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female[ind], ind_cross_info);
+            const int n_poss_gen = kernel_n_poss_gen(N, poss_gen.size());
+            NumericVector probs(n_poss_gen);
+
+            // backward equations
+            NumericMatrix beta = backwardEquations<CrossT, N>(cross, genotypes(_,ind), founder_geno, is_X_chr, is_female[ind],
+                                                   ind_cross_info, ind_step_matrix, marker_index, error_prob,
+                                                   poss_gen);
+
+            // simulate genotypes
+            for(int draw=0; draw<n_draws; draw++) {
+                // first draw
+                // calculate first prob (on log scale)
+                probs[0] = cross->init(poss_gen[0], is_X_chr, is_female[ind], ind_cross_info) + beta(0,0);
+                if(marker_index[0] >= 0)
+                    probs[0] += cross->emit(genotypes(marker_index[0],ind), poss_gen[0], error_prob,
+                                            fg[marker_index[0]], is_X_chr, is_female[ind], ind_cross_info);
+                double sumprobs = probs[0]; // to contain log(sum(probs))
+
+                // calculate rest of probs
+                for(int g=1; g<n_poss_gen; g++) {
+                    probs[g] = cross->init(poss_gen[g], is_X_chr, is_female[ind], ind_cross_info) + beta(g,0);
+                    if(marker_index[0] >= 0)
+                        probs[g] += cross->emit(genotypes(marker_index[0],ind), poss_gen[g], error_prob,
+                                                fg[marker_index[0]], is_X_chr, is_female[ind], ind_cross_info);
+                    sumprobs = addlog(sumprobs, probs[g]);
+                }
+
+                // re-scale probs
+                for(int g=0; g<n_poss_gen; g++)
+                    probs[g] = exp(probs[g] - sumprobs);
+
+                // make draw, returns a value from 1, 2, ..., n_poss_gen
+                int curgeno = random_int(probs);
+                draws[draw*n_pos + ind*mat_size] = poss_gen[curgeno];
+
+                // move along chromosome
+                for(int pos=1; pos<n_pos; pos++) {
+
+                    // calculate probs
+                    for(int g=0; g<n_poss_gen; g++) {
+                        probs[g] = ind_step_matrix[pos-1](curgeno, g) +
+                            beta(g,pos) - beta(curgeno, pos-1);
+                        if(marker_index[pos] >= 0)
+                            probs[g] += cross->emit(genotypes(marker_index[pos],ind), poss_gen[g], error_prob,
+                                                    fg[marker_index[pos]], is_X_chr, is_female[ind], ind_cross_info);
+                        probs[g] = exp(probs[g]);
+                    }
+
+                    // make draw
+                    curgeno = random_int(probs);
+
+                    draws[pos + draw*n_pos + ind*mat_size] = poss_gen[curgeno];
+
+                } // loop over positions
+            } // loop over draws
+        } // loop over individuals
+
+        draws.attr("dim") = Dimension(n_pos, n_draws, n_ind);
+        return draws;
+    }
+};
+
+
 // simulate genotypes given observed marker data
 // [[Rcpp::export(".sim_geno")]]
 IntegerVector sim_geno(const String& crosstype,
@@ -46,74 +158,9 @@ IntegerVector sim_geno(const String& crosstype,
         throw std::range_error("founder_geno is not the right size");
     // end of checks
 
-    const int mat_size = n_pos*n_draws;
-    IntegerVector draws(mat_size*n_ind); // output object
-
-    for(int ind=0; ind<n_ind; ind++) {
-
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // possible genotypes for this individual
-        IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female[ind], cross_info(_,ind));
-        const int n_poss_gen = poss_gen.size();
-        NumericVector probs(n_poss_gen);
-
-        // backward equations
-        NumericMatrix beta = backwardEquations(cross, genotypes(_,ind), founder_geno, is_X_chr, is_female[ind],
-                                               cross_info(_,ind), rec_frac, marker_index, error_prob,
-                                               poss_gen);
-
-        // simulate genotypes
-        for(int draw=0; draw<n_draws; draw++) {
-            // first draw
-            // calculate first prob (on log scale)
-            probs[0] = cross->init(poss_gen[0], is_X_chr, is_female[ind], cross_info(_,ind)) + beta(0,0);
-            if(marker_index[0] >= 0)
-                probs[0] += cross->emit(genotypes(marker_index[0],ind), poss_gen[0], error_prob,
-                                        founder_geno(_, marker_index[0]), is_X_chr, is_female[ind], cross_info(_,ind));
-            double sumprobs = probs[0]; // to contain log(sum(probs))
-
-            // calculate rest of probs
-            for(int g=1; g<n_poss_gen; g++) {
-                probs[g] = cross->init(poss_gen[g], is_X_chr, is_female[ind], cross_info(_,ind)) + beta(g,0);
-                if(marker_index[0] >= 0)
-                    probs[g] += cross->emit(genotypes(marker_index[0],ind), poss_gen[g], error_prob,
-                                            founder_geno(_, marker_index[0]), is_X_chr, is_female[ind], cross_info(_,ind));
-                sumprobs = addlog(sumprobs, probs[g]);
-            }
-
-            // re-scale probs
-            for(int g=0; g<n_poss_gen; g++)
-                probs[g] = exp(probs[g] - sumprobs);
-
-            // make draw, returns a value from 1, 2, ..., n_poss_gen
-            int curgeno = random_int(probs);
-            draws[draw*n_pos + ind*mat_size] = poss_gen[curgeno];
-
-            // move along chromosome
-            for(int pos=1; pos<n_pos; pos++) {
-
-                // calculate probs
-                for(int g=0; g<n_poss_gen; g++) {
-                    probs[g] = cross->step(poss_gen[curgeno], poss_gen[g], rec_frac[pos-1],
-                                           is_X_chr, is_female[ind], cross_info(_,ind)) +
-                        beta(g,pos) - beta(curgeno, pos-1);
-                    if(marker_index[pos] >= 0)
-                        probs[g] += cross->emit(genotypes(marker_index[pos],ind), poss_gen[g], error_prob,
-                                                founder_geno(_, marker_index[pos]), is_X_chr, is_female[ind], cross_info(_,ind));
-                    probs[g] = exp(probs[g]);
-                }
-
-                // make draw
-                curgeno = random_int(probs);
-
-                draws[pos + draw*n_pos + ind*mat_size] = poss_gen[curgeno];
-
-            } // loop over positions
-        } // loop over draws
-    } // loop over individuals
-
-    draws.attr("dim") = Dimension(n_pos, n_draws, n_ind);
+    IntegerVector draws = dispatch_cross<sim_geno_kernel>(cross, is_X_chr, genotypes, founder_geno,
+                                                          is_female, cross_info, rec_frac,
+                                                          marker_index, error_prob, n_draws);
     delete cross;
     return draws;
 }
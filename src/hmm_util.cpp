@@ -2,6 +2,7 @@
 
 #include "hmm_util.h"
 #include <math.h>
+#include <map>
 #include <Rcpp.h>
 
 // Calculate addlog(a,b) = log[exp(a) + exp(b)]
@@ -28,3 +29,60 @@ double subtractlog(const double a, const double b)
     if(a > b + tol) return a;
     else return a + log1p(-exp(b-a));
 }
+
+// exponentiate a vector of matrices of log probabilities
+// (to use pre-calculated emit and step matrices in the scaled HMM)
+std::vector<Rcpp::NumericMatrix> exp_matrices(const std::vector<Rcpp::NumericMatrix>& log_matrices)
+{
+    const int n_matrices = log_matrices.size();
+
+    std::vector<Rcpp::NumericMatrix> result(n_matrices);
+    for(int i=0; i<n_matrices; i++) {
+        const int n_rows = log_matrices[i].rows();
+        const int n_cols = log_matrices[i].cols();
+        Rcpp::NumericMatrix this_matrix(n_rows, n_cols);
+        for(int j=0; j<n_rows*n_cols; j++)
+            this_matrix[j] = exp(log_matrices[i][j]);
+        result[i] = this_matrix;
+    }
+
+    return result;
+}
+
+EmitMatrices exp_matrices(const EmitMatrices& log_matrices)
+{
+    EmitMatrices result(log_matrices);
+    for(unsigned int j=0; j<result.values.size(); j++)
+        result.values[j] = exp(result.values[j]);
+
+    return result;
+}
+
+// group individuals with common is_female and cross_info
+// (so that the transition matrices can be calculated once per group)
+//
+// output = vector of groups, each a vector of individual indexes (in
+//          increasing order); groups ordered by their first individual
+std::vector< std::vector<int> > group_individuals(const Rcpp::LogicalVector& is_female,
+                                                  const Rcpp::IntegerMatrix& cross_info)
+{
+    const int n_ind = cross_info.cols();
+    const int n_info = cross_info.rows();
+
+    std::map< std::vector<int>, int > group_index;
+    std::vector< std::vector<int> > result;
+    for(int ind=0; ind<n_ind; ind++) {
+        std::vector<int> key(n_info+1);
+        key[0] = is_female[ind];
+        for(int i=0; i<n_info; i++) key[i+1] = cross_info(i,ind);
+
+        std::map< std::vector<int>, int >::iterator it = group_index.find(key);
+        if(it == group_index.end()) {
+            group_index[key] = result.size();
+            result.push_back(std::vector<int>(1, ind));
+        }
+        else result[it->second].push_back(ind);
+    }
+
+    return result;
+}
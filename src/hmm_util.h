@@ -2,10 +2,24 @@
 #ifndef HMM_UTIL_H
 #define HMM_UTIL_H
 
+#include <vector>
+#include <Rcpp.h>
+#include "hmm_emitmatrix.h"
+
 // Calculate addlog(a,b) = log[exp(a) + exp(b)]
 double addlog(const double a, const double b);
 
 // Calculate  subtractlog(a,b) = log[exp(a) - exp(b)]
 double subtractlog(const double a, const double b);
 
+// exponentiate a vector of matrices of log probabilities
+// (to use pre-calculated emit and step matrices in the scaled HMM)
+std::vector<Rcpp::NumericMatrix> exp_matrices(const std::vector<Rcpp::NumericMatrix>& log_matrices);
+EmitMatrices exp_matrices(const EmitMatrices& log_matrices);
+
+// group individuals with common is_female and cross_info
+// (so that the transition matrices can be calculated once per group)
+std::vector< std::vector<int> > group_individuals(const Rcpp::LogicalVector& is_female,
+                                                  const Rcpp::IntegerMatrix& cross_info);
+
 #endif // HMM_UTIL_H
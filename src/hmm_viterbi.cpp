@@ -5,9 +5,128 @@
 #include <math.h>
 #include <Rcpp.h>
 #include "cross.h"
+#include "cross_dispatch.h"
 #include "random.h"
 #define TOL 1e-6
 
+// loop over individuals, for a particular cross class
+// and number of possible genotypes (see cross_dispatch.h)
+template<class CrossT, int N>
+struct viterbi_kernel {
+    static IntegerMatrix run(CrossT* cross,
+                             const bool is_X_chr,
+                             const IntegerMatrix& genotypes,
+                             const IntegerMatrix& founder_geno,
+                             const LogicalVector& is_female,
+                             const IntegerMatrix& cross_info,
+                             const NumericVector& rec_frac,
+                             const IntegerVector& marker_index,
+                             const double error_prob)
+    {
+        const int n_ind = genotypes.cols();
+        const int n_pos = marker_index.size();
+
+        // founder genotypes at each marker
+        std::vector<IntegerVector> fg(founder_geno.cols());
+        for(int i=0; i<founder_geno.cols(); i++) fg[i] = founder_geno(_, i);
+
+        IntegerMatrix result(n_ind, n_pos); // output object
+
+        for(int ind=0; ind<n_ind; ind++) {
+
+            Rcpp::checkUserInterrupt();  // check for ^C from user
+
+            IntegerVector ind_cross_info = cross_info(_,ind);
+
+            // possible genotypes for this individual
+            IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female[ind], ind_cross_info);
+            const int n_poss_gen = kernel_n_poss_gen(N, poss_gen.size());
+
+            IntegerMatrix traceback(n_pos, n_poss_gen); // for tracing back through the genotypes
+
+            if(n_pos == 1) { // exactly one position
+                std::vector<int> best_genotypes;
+
+                // probability of first genotype
+                double s = cross->init(poss_gen[0], is_X_chr, is_female[ind], ind_cross_info);
+                if(marker_index[0] >= 0)
+                    s += cross->emit(genotypes(marker_index[0],ind), poss_gen[0], error_prob,
+                                     fg[marker_index[0]], is_X_chr, is_female[ind], ind_cross_info);
+                result(ind,0) = poss_gen[0];
+
+                // probability of other genotypes
+                for(int g=1; g<n_poss_gen; g++) {
+                    double t = cross->init(poss_gen[g], is_X_chr, is_female[ind], ind_cross_info);
+                    if(marker_index[0] >= 0)
+                        t += cross->emit(genotypes(marker_index[0],ind), poss_gen[g], error_prob,
+                                         fg[marker_index[0]], is_X_chr, is_female[ind], ind_cross_info);
+                    // bigger or same plus flip coin...bias towards later ones
+                    if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
+                        s = t;
+                        result(ind,0) = poss_gen[g];
+                    }
+                }
+            } // exactly one position
+            else { // multiple positions
+                NumericVector gamma(n_poss_gen);
+                NumericVector tempgamma1(n_poss_gen);
+                NumericVector tempgamma2(n_poss_gen);
+
+                for(int g=0; g<n_poss_gen; g++) {
+                    gamma[g] = cross->init(poss_gen[g], is_X_chr, is_female[ind], ind_cross_info);
+                    if(marker_index[0] >= 0)
+                        gamma[g] += cross->emit(genotypes(marker_index[0],ind), poss_gen[g], error_prob,
+                                                fg[marker_index[0]], is_X_chr, is_female[ind], ind_cross_info);
+                }
+
+                for(int pos=0; pos<n_pos-1; pos++) {
+                    for(int gright=0; gright<n_poss_gen; gright++) {
+                        double s = gamma[0] + cross->step(poss_gen[0], poss_gen[gright], rec_frac[pos],
+                                                          is_X_chr, is_female[ind], ind_cross_info);
+                        tempgamma1[gright] = s;
+                        traceback(pos,gright) = 0;
+
+                        for(int gleft=1; gleft<n_poss_gen; gleft++) {
+                            double t = gamma[gleft] + cross->step(poss_gen[gleft], poss_gen[gright], rec_frac[pos],
+                                                                  is_X_chr, is_female[ind], ind_cross_info);
+                            if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
+                                tempgamma1[gright] = s = t;
+                                traceback(pos,gright) = gleft;
+                            }
+                        }
+                        if(marker_index[pos+1] >= 0)
+                            tempgamma2[gright] = tempgamma1[gright] + cross->emit(genotypes(marker_index[pos+1],ind), poss_gen[gright], error_prob,
+                                                                                 fg[marker_index[pos+1]], is_X_chr, is_female[ind], ind_cross_info);
+                    }
+                    for(int g=0; g<n_poss_gen; g++) gamma[g] = tempgamma2[g];
+                } // loop over positions
+
+                // finish off viterbi and then trace back to get most likely sequence
+                result(ind, n_pos-1) = 0;
+                double s = gamma[0];
+                for(int g=1; g<n_poss_gen; g++) {
+                    double t = gamma[g];
+                    if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
+                        s = t;
+                        result(ind, n_pos-1) = g;
+                    }
+                }
+                for(int pos=n_pos-2; pos>=0; pos--)
+                    result(ind, pos) = traceback(pos, result(ind, pos+1));
+
+                // replace integers with possible genotypes
+                for(int pos=0; pos<n_pos; pos++)
+                    result(ind,pos) = poss_gen[result(ind,pos)];
+
+            } // if(multiple positions)
+
+        } // loop over individuals
+
+        return result;
+    }
+};
+
+
 // find most probable sequence of genotypes
 // [[Rcpp::export(".viterbi")]]
 IntegerMatrix viterbi(const String& crosstype,
@@ -45,96 +164,9 @@ IntegerMatrix viterbi(const String& crosstype,
         throw std::range_error("founder_geno is not the right size");
     // end of checks
 
-    IntegerMatrix result(n_ind, n_pos); // output object
-
-    for(int ind=0; ind<n_ind; ind++) {
-
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // possible genotypes for this individual
-        IntegerVector poss_gen = cross->possible_gen(is_X_chr, is_female[ind], cross_info(_,ind));
-        const int n_poss_gen = poss_gen.size();
-
-        IntegerMatrix traceback(n_pos, n_poss_gen); // for tracing back through the genotypes
-
-        if(n_pos == 1) { // exactly one position
-            std::vector<int> best_genotypes;
-
-            // probability of first genotype
-            double s = cross->init(poss_gen[0], is_X_chr, is_female[ind], cross_info(_,ind));
-            if(marker_index[0] >= 0)
-                s += cross->emit(genotypes(marker_index[0],ind), poss_gen[0], error_prob,
-                                 founder_geno(_, marker_index[0]), is_X_chr, is_female[ind], cross_info(_,ind));
-            result(ind,0) = poss_gen[0];
-
-            // probability of other genotypes
-            for(int g=1; g<n_poss_gen; g++) {
-                double t = cross->init(poss_gen[g], is_X_chr, is_female[ind], cross_info(_,ind));
-                if(marker_index[0] >= 0)
-                    t += cross->emit(genotypes(marker_index[0],ind), poss_gen[g], error_prob,
-                                     founder_geno(_, marker_index[0]), is_X_chr, is_female[ind], cross_info(_,ind));
-                // bigger or same plus flip coin...bias towards later ones
-                if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
-                    s = t;
-                    result(ind,0) = poss_gen[g];
-                }
-            }
-        } // exactly one position
-        else { // multiple positions
-            NumericVector gamma(n_poss_gen);
-            NumericVector tempgamma1(n_poss_gen);
-            NumericVector tempgamma2(n_poss_gen);
-
-            for(int g=0; g<n_poss_gen; g++) {
-                gamma[g] = cross->init(poss_gen[g], is_X_chr, is_female[ind], cross_info(_,ind));
-                if(marker_index[0] >= 0)
-                    gamma[g] += cross->emit(genotypes(marker_index[0],ind), poss_gen[g], error_prob,
-                                            founder_geno(_, marker_index[0]), is_X_chr, is_female[ind], cross_info(_,ind));
-            }
-
-            for(int pos=0; pos<n_pos-1; pos++) {
-                for(int gright=0; gright<n_poss_gen; gright++) {
-                    double s = gamma[0] + cross->step(poss_gen[0], poss_gen[gright], rec_frac[pos],
-                                                      is_X_chr, is_female[ind], cross_info(_,ind));
-                    tempgamma1[gright] = s;
-                    traceback(pos,gright) = 0;
-
-                    for(int gleft=1; gleft<n_poss_gen; gleft++) {
-                        double t = gamma[gleft] + cross->step(poss_gen[gleft], poss_gen[gright], rec_frac[pos],
-                                                              is_X_chr, is_female[ind], cross_info(_,ind));
-                        if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
-                            tempgamma1[gright] = s = t;
-                            traceback(pos,gright) = gleft;
-                        }
-                    }
-                    if(marker_index[pos+1] >= 0)
-                        tempgamma2[gright] = tempgamma1[gright] + cross->emit(genotypes(marker_index[pos+1],ind), poss_gen[gright], error_prob,
-                                                                             founder_geno(_, marker_index[pos+1]), is_X_chr, is_female[ind], cross_info(_,ind));
-                }
-                for(int g=0; g<n_poss_gen; g++) gamma[g] = tempgamma2[g];
-            } // loop over positions
-
-            // finish off viterbi and then trace back to get most likely sequence
-            result(ind, n_pos-1) = 0;
-            double s = gamma[0];
-            for(int g=1; g<n_poss_gen; g++) {
-                double t = gamma[g];
-                if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
-                    s = t;
-                    result(ind, n_pos-1) = g;
-                }
-            }
-            for(int pos=n_pos-2; pos>=0; pos--)
-                result(ind, pos) = traceback(pos, result(ind, pos+1));
-
-            // replace integers with possible genotypes
-            for(int pos=0; pos<n_pos; pos++)
-                result(ind,pos) = poss_gen[result(ind,pos)];
-
-        } // if(multiple positions)
-
-    } // loop over individuals
-
+    IntegerMatrix result = dispatch_cross<viterbi_kernel>(cross, is_X_chr, genotypes, founder_geno,
+                                                          is_female, cross_info, rec_frac,
+                                                          marker_index, error_prob);
     delete cross;
     return result;
 }
@@ -50,8 +50,8 @@ IntegerMatrix viterbi2(const String& crosstype,
 
     const int max_obsgeno = max(genotypes);
 
-    std::vector<NumericMatrix> emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno, founder_geno,
-                                                                    is_X_chr, is_female, cross_info);
+    EmitMatrices emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno, founder_geno,
+                                                      is_X_chr, is_female, cross_info);
 
     std::vector<NumericMatrix> step_matrix = cross->calc_stepmatrix(rec_frac, is_X_chr, is_female, cross_info);
 
@@ -71,14 +71,14 @@ IntegerMatrix viterbi2(const String& crosstype,
             // probability of first genotype
             double s = init_vector[0];
             if(marker_index[0] >= 0)
-                s += emit_matrix[marker_index[0]](genotypes(marker_index[0],ind), 0);
+                s += emit_matrix(marker_index[0], genotypes(marker_index[0],ind), 0);
             result(ind,0) = poss_gen[0];
 
             // probability of other genotypes
             for(int g=1; g<n_poss_gen; g++) {
                 double t = init_vector[g];
                 if(marker_index[0] >= 0)
-                    t += emit_matrix[marker_index[0]](genotypes(marker_index[0],ind), g);
+                    t += emit_matrix(marker_index[0], genotypes(marker_index[0],ind), g);
                 // bigger or same plus flip coin...bias towards later ones
                 if(t > s || (s-t < TOL && R::runif(0.0, 1.0)<0.5)) {
                     s = t;
@@ -94,7 +94,7 @@ IntegerMatrix viterbi2(const String& crosstype,
             for(int g=0; g<n_poss_gen; g++) {
                 gamma[g] = init_vector[g];
                 if(marker_index[0] >= 0)
-                    gamma[g] += emit_matrix[marker_index[0]](genotypes(marker_index[0],ind), g);
+                    gamma[g] += emit_matrix(marker_index[0], genotypes(marker_index[0],ind), g);
             }
 
             for(int pos=0; pos<n_pos-1; pos++) {
@@ -111,7 +111,7 @@ IntegerMatrix viterbi2(const String& crosstype,
                         }
                     }
                     if(marker_index[pos+1] >= 0)
-                        tempgamma2[gright] = tempgamma1[gright] + emit_matrix[marker_index[pos+1]](genotypes(marker_index[pos+1],ind), gright);
+                        tempgamma2[gright] = tempgamma1[gright] + emit_matrix(marker_index[pos+1], genotypes(marker_index[pos+1],ind), gright);
                 }
                 for(int g=0; g<n_poss_gen; g++) gamma[g] = tempgamma2[g];
             } // loop over positions
@@ -0,0 +1,71 @@
+// index of equivalent SNPs
+
+#include "index_snps.h"
+#include <unordered_map>
+#include <stdint.h>
+#include <Rcpp.h>
+
+using namespace Rcpp;
+
+#include "parallel_util.h"
+
+// index of equivalent SNPs, chromosome by chromosome
+//
+// chr_start = 0-based row at which each chromosome starts, plus the total
+//             number of SNPs at the end (so length n_chr+1)
+// interval  = map interval containing each snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// sdp       = strain distribution pattern for each snp
+// n_threads = number of threads to use (over chromosomes)
+//
+// output    = for each snp, the 1-based row (within its chromosome) of
+//             the first snp with the same interval, on_map, and sdp
+//
+// The SNPs are assumed to be sorted by position within each
+// chromosome, so the first SNP in each group is the left-most.
+//
+// [[Rcpp::export(".index_snps_bychr")]]
+IntegerVector index_snps_bychr(const IntegerVector& chr_start,
+                               const IntegerVector& interval,
+                               const LogicalVector& on_map,
+                               const IntegerVector& sdp,
+                               const int n_threads=1)
+{
+    const int n_chr = chr_start.size() - 1;
+    const int n_snp = interval.size();
+    if(n_chr < 0)
+        throw std::invalid_argument("chr_start should have length >= 1");
+    if(chr_start[0] != 0 || chr_start[n_chr] != n_snp)
+        throw std::invalid_argument("chr_start should start at 0 and end at length(interval)");
+    for(int chr=0; chr<n_chr; chr++) {
+        if(chr_start[chr+1] < chr_start[chr])
+            throw std::invalid_argument("chr_start should be non-decreasing");
+    }
+    if(on_map.size() != n_snp)
+        throw std::invalid_argument("length(on_map) != length(interval)");
+    if(sdp.size() != n_snp)
+        throw std::invalid_argument("length(sdp) != length(interval)");
+
+    IntegerVector result(n_snp);
+
+    const int *start = INTEGER(chr_start);
+    const int *intv = INTEGER(interval);
+    const int *onmap = LOGICAL(on_map);
+    const int *sdp_ptr = INTEGER(sdp);
+    int *res = INTEGER(result);
+
+    parallel_for(n_chr, n_threads, [&](const int chr, const int thread) {
+        // (interval, on_map, sdp) -> first row
+        std::unordered_map<uint64_t, int> first;
+        first.reserve(start[chr+1] - start[chr]);
+
+        for(int i=start[chr]; i<start[chr+1]; i++) {
+            const uint64_t key = ((uint64_t)(uint32_t)intv[i] << 33) |
+                ((uint64_t)(onmap[i] != 0) << 32) | (uint64_t)(uint32_t)sdp_ptr[i];
+            const int row = i - start[chr] + 1;
+            res[i] = first.emplace(key, row).first->second;
+        }
+    });
+
+    return result;
+}
@@ -0,0 +1,24 @@
+// index of equivalent SNPs
+#ifndef INDEX_SNPS_H
+#define INDEX_SNPS_H
+
+#include <Rcpp.h>
+
+// index of equivalent SNPs, chromosome by chromosome
+//
+// chr_start = 0-based row at which each chromosome starts, plus the total
+//             number of SNPs at the end (so length n_chr+1)
+// interval  = map interval containing each snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// sdp       = strain distribution pattern for each snp
+// n_threads = number of threads to use (over chromosomes)
+//
+// output    = for each snp, the 1-based row (within its chromosome) of
+//             the first snp with the same interval, on_map, and sdp
+Rcpp::IntegerVector index_snps_bychr(const Rcpp::IntegerVector& chr_start,
+                                     const Rcpp::IntegerVector& interval,
+                                     const Rcpp::LogicalVector& on_map,
+                                     const Rcpp::IntegerVector& sdp,
+                                     const int n_threads);
+
+#endif // INDEX_SNPS_H
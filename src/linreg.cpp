@@ -65,6 +65,50 @@ NumericVector calc_resid_linreg_3d(const NumericMatrix& X, const NumericVector&
     return result;
 }
 
+// Calculate matrix of RSS from linear regression of Y vs each slice of
+// a 3-dim array P (output is ncol(Y) x dim(P)[3]), using n_threads threads
+// [[Rcpp::export]]
+NumericMatrix calc_rss_linreg_3d(const NumericVector& P, const NumericMatrix& Y,
+                                 const double tol=1e-12, const int n_threads=1)
+{
+    const int nrowy = Y.rows();
+    if(Rf_isNull(P.attr("dim")))
+        throw std::invalid_argument("P should be a 3d array but has no dim attribute");
+    const Dimension d = P.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("P should be a 3d array");
+    if(d[0] != nrowy)
+        throw std::range_error("nrow(Y) != nrow(P)");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
+
+    return calc_mvrss_eigenqr_3d(P, Y, tol, n_threads);
+}
+
+// Calculate matrix of minimum RSS from linear regression of permuted
+// columns of Y vs each slice of a 3-dim array P
+// (perms is nrow(Y) x n_perm with 0-based indexes; output is n_perm x ncol(Y)),
+// using n_threads threads
+NumericMatrix calc_minrss_linreg_3d_perm(const NumericVector& P, const NumericMatrix& Y,
+                                         const IntegerMatrix& perms,
+                                         const double tol, const int n_threads)
+{
+    const int nrowy = Y.rows();
+    if(Rf_isNull(P.attr("dim")))
+        throw std::invalid_argument("P should be a 3d array but has no dim attribute");
+    const Dimension d = P.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("P should be a 3d array");
+    if(d[0] != nrowy)
+        throw std::range_error("nrow(Y) != nrow(P)");
+    if(perms.rows() != nrowy)
+        throw std::range_error("nrow(Y) != nrow(perms)");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
+
+    return calc_minrss_eigenqr_3d_perm(P, Y, perms, tol, n_threads);
+}
+
 // least squares, returning everything
 // output is list of (coef, fitted, resid, rss, sigma, rank, df, SE)
 //
@@ -29,6 +29,21 @@ Rcpp::NumericVector calc_resid_linreg_3d(const Rcpp::NumericMatrix& X,
                                          const Rcpp::NumericVector& P,
                                          const double tol);
 
+// Calculate matrix of RSS from linear regression of Y vs each slice of a 3-dim array
+// (using n_threads threads)
+Rcpp::NumericMatrix calc_rss_linreg_3d(const Rcpp::NumericVector& P,
+                                       const Rcpp::NumericMatrix& Y,
+                                       const double tol,
+                                       const int n_threads);
+
+// Calculate matrix of minimum RSS from linear regression of permuted
+// columns of Y vs each slice of a 3-dim array
+// (perms has 0-based indexes; output is ncol(perms) x ncol(Y); using n_threads threads)
+Rcpp::NumericMatrix calc_minrss_linreg_3d_perm(const Rcpp::NumericVector& P,
+                                               const Rcpp::NumericMatrix& Y,
+                                               const Rcpp::IntegerMatrix& perms,
+                                               const double tol,
+                                               const int n_threads);
 
 // least squares, returning everything
 // output is list of (coef, fitted, resid, rss, sigma, rank, df, SE, var)
@@ -3,8 +3,10 @@
 // [[Rcpp::depends(RcppEigen)]]
 
 #include "linreg_eigen.h"
+#include <limits>
 #include <RcppEigen.h>
 #include "r_message.h" // defines RQTL2_NODEBUG
+#include "parallel_util.h"
 
 using namespace Rcpp;
 using namespace Eigen;
@@ -424,14 +426,21 @@ NumericVector calc_fitted_linreg_eigenqr(const NumericMatrix& X, const NumericVe
     const MatrixXd XX(as<Map<MatrixXd> >(X));
     const VectorXd yy(as<Map<VectorXd> >(y));
 
+    return wrap(calc_fitted_linreg_eigenqr(XX, yy, tol));
+}
+
+// least squares by QR decomposition with column pivoting
+// return just the fitted values
+// (Eigen objects only, so may be called from worker threads)
+VectorXd calc_fitted_linreg_eigenqr(const MatrixXd& XX, const VectorXd& yy,
+                                    const double tol)
+{
     typedef Eigen::ColPivHouseholderQR<MatrixXd> CPivQR;
-    typedef CPivQR::PermutationType Permutation;
 
     const int n = XX.rows(), p = XX.cols();
 
     CPivQR PQR ( XX );
     PQR.setThreshold(tol); // set tolerance
-    Permutation Pmat = PQR.colsPermutation();
     const int r = PQR.rank();
 
     VectorXd fitted(n);
@@ -439,14 +448,12 @@ NumericVector calc_fitted_linreg_eigenqr(const NumericMatrix& X, const NumericVe
         VectorXd betahat = PQR.solve(yy);
         fitted = XX * betahat;
     } else {
-        MatrixXd Rinv = PQR.matrixQR().topLeftCorner(r,r)
-            .triangularView<Upper>().solve(MatrixXd::Identity(r,r));
         VectorXd effects = PQR.householderQ().adjoint() * yy;
         effects.tail(n - r).setZero();
         fitted = PQR.householderQ() * effects;
     }
 
-    return wrap(fitted);
+    return fitted;
 }
 
 
@@ -625,3 +632,191 @@ NumericMatrix calc_resid_eigenqr(const NumericMatrix& X, const NumericMatrix& Y,
 
     return result;
 }
+
+// least squares by QR decomposition with column pivoting, with matrix Y
+// and X a 3d array (n x p x n_slice); regress each column of Y on each slice
+// return matrix of RSS (ncol(Y) x n_slice)
+//
+// The QR decomposition of each slice doesn't depend on Y. With more
+// columns in Y than in X, we form the orthonormal basis Q1 of each
+// slice and get the projections for a block of slices with one matrix
+// product, with RSS = y'y - |Q1'y|^2 (recalculated directly where
+// there's substantial cancellation)
+//
+// blocks of slices x blocks of columns of Y are split across n_threads threads
+// [[Rcpp::export]]
+NumericMatrix calc_mvrss_eigenqr_3d(const NumericVector& X, const NumericMatrix& Y,
+                                    const double tol=1e-12, const int n_threads=1)
+{
+    const int n = Y.rows(), k = Y.cols();
+    const Dimension d = X.attr("dim");
+    const int p = d[1], n_slice = d[2];
+    #ifndef RQTL2_NODEBUG
+    if(d[0] != n)
+        throw std::invalid_argument("nrow(X) != nrow(Y)");
+    #endif
+
+    const Map<MatrixXd> YY(as<Map<MatrixXd> >(Y));
+    const double *x = X.begin();
+    const size_t x_size = (size_t)n * p;
+
+    typedef Eigen::ColPivHouseholderQR<MatrixXd> CPivQR;
+
+    NumericMatrix result(k, n_slice);
+    double *res = result.begin();
+
+    if(k <= p) { // few columns in Y: apply Q' directly
+        parallel_for(n_slice, n_threads, [&](const int s, const int thread) {
+            CPivQR PQR ( Map<const MatrixXd>(x + s*x_size, n, p) );
+            PQR.setThreshold(tol); // set tolerance
+            const int r = PQR.rank();
+
+            MatrixXd effects = PQR.householderQ().adjoint() * YY;
+            for(int j=0; j<k; j++)
+                res[j + (size_t)s*k] = effects.col(j).tail(n - r).squaredNorm();
+        });
+        return result;
+    }
+
+    const VectorXd yy = YY.colwise().squaredNorm().transpose();
+    const int block_size = std::max(1, 256 / p); // slices per block
+    const int y_block_size = 4096;               // columns of Y per product
+    const double cancel_tol = 1e-6;
+    const int n_sblock = (n_slice + block_size - 1) / block_size;
+    const int n_yblock = (k + y_block_size - 1) / y_block_size;
+
+    // workspace for each thread
+    const int nt = std::max(1, std::min(n_threads, n_sblock * n_yblock));
+    std::vector<MatrixXd> Q(nt, MatrixXd(n, block_size * p));
+    std::vector< std::vector<int> > rank(nt, std::vector<int>(block_size));
+
+    parallel_for(n_sblock * n_yblock, nt, [&](const int work, const int thread) {
+        const int s0 = (work / n_yblock) * block_size;
+        const int j0 = (work % n_yblock) * y_block_size;
+        const int n_block = std::min(block_size, n_slice - s0);
+        const int n_ycol = std::min(y_block_size, k - j0);
+        MatrixXd& QQ = Q[thread];
+        std::vector<int>& rk = rank[thread];
+
+        // orthonormal basis for each slice in the block
+        int n_col = 0;
+        for(int b=0; b<n_block; b++) {
+            CPivQR PQR ( Map<const MatrixXd>(x + (s0+b)*x_size, n, p) );
+            PQR.setThreshold(tol); // set tolerance
+            rk[b] = PQR.rank();
+
+            QQ.middleCols(n_col, rk[b]) = PQR.householderQ() * MatrixXd::Identity(n, rk[b]);
+            n_col += rk[b];
+        }
+
+        const MatrixXd QtY = QQ.leftCols(n_col).adjoint() * YY.middleCols(j0, n_ycol);
+
+        for(int b=0, col=0; b<n_block; col += rk[b], b++) {
+            for(int j=0; j<n_ycol; j++) {
+                double rss = yy[j0+j] - QtY.block(col, j, rk[b], 1).squaredNorm();
+                if(rss < cancel_tol * yy[j0+j])
+                    rss = (YY.col(j0+j) - QQ.middleCols(col, rk[b]) *
+                           QtY.block(col, j, rk[b], 1)).squaredNorm();
+                res[(j0+j) + (size_t)(s0+b)*k] = rss;
+            }
+        }
+    });
+
+    return result;
+}
+
+// least squares by QR decomposition with column pivoting, with X a 3d
+// array (n x p x n_slice) and the columns of Y permuted according to
+// the columns of perms (n x n_perm, 0-based indexes); regress each
+// permuted column of Y on each slice of X and keep the minimum RSS
+// return matrix of minimum RSS (n_perm x ncol(Y))
+//
+// The orthonormal basis of each slice is calculated once and reused for
+// all permutations, and the permuted columns of Y are formed a block at
+// a time, so the full set of RSS values is never stored.
+//
+// blocks of permuted columns of Y are split across n_threads threads
+NumericMatrix calc_minrss_eigenqr_3d_perm(const NumericVector& X, const NumericMatrix& Y,
+                                          const IntegerMatrix& perms,
+                                          const double tol, const int n_threads)
+{
+    const int n = Y.rows(), n_col_y = Y.cols(), n_perm = perms.cols();
+    const Dimension d = X.attr("dim");
+    const int p = d[1], n_slice = d[2];
+    #ifndef RQTL2_NODEBUG
+    if(d[0] != n)
+        throw std::invalid_argument("nrow(X) != nrow(Y)");
+    if(perms.rows() != n)
+        throw std::invalid_argument("nrow(perms) != nrow(Y)");
+    #endif
+    for(int i=0; i<perms.size(); i++) {
+        if(perms[i] < 0 || perms[i] >= n)
+            throw std::range_error("perms out of range");
+    }
+
+    const Map<MatrixXd> YY(as<Map<MatrixXd> >(Y));
+    const VectorXd yy = YY.colwise().squaredNorm().transpose(); // same for all permutations
+    const double *x = X.begin();
+    const int *perm = perms.begin();
+    const size_t x_size = (size_t)n * p;
+
+    typedef Eigen::ColPivHouseholderQR<MatrixXd> CPivQR;
+
+    // orthonormal basis for each slice, in columns s*p, ..., s*p + rank[s] - 1
+    MatrixXd Q = MatrixXd::Zero(n, (Eigen::Index)p * n_slice);
+    std::vector<int> rank(n_slice);
+    parallel_for(n_slice, n_threads, [&](const int s, const int thread) {
+        CPivQR PQR ( Map<const MatrixXd>(x + s*x_size, n, p) );
+        PQR.setThreshold(tol); // set tolerance
+        rank[s] = PQR.rank();
+
+        Q.middleCols((Eigen::Index)s*p, rank[s]) = PQR.householderQ() * MatrixXd::Identity(n, rank[s]);
+    });
+
+    const int k = n_perm * n_col_y;              // permuted columns, perm varying fastest
+    const int block_size = std::max(1, 256 / p); // slices per block
+    const int y_block_size = 512;                // permuted columns of Y per block
+    const double cancel_tol = 1e-6;
+    const int n_yblock = (k + y_block_size - 1) / y_block_size;
+
+    NumericMatrix result(n_perm, n_col_y);
+    double *res = result.begin();
+
+    parallel_for(n_yblock, n_threads, [&](const int yblock, const int thread) {
+        const int j0 = yblock * y_block_size;
+        const int n_ycol = std::min(y_block_size, k - j0);
+
+        // permuted columns of Y for this block
+        MatrixXd Yperm(n, n_ycol);
+        VectorXd yyperm(n_ycol);
+        for(int j=0; j<n_ycol; j++) {
+            const int i_perm = (j0+j) % n_perm, col = (j0+j) / n_perm;
+            const int *this_perm = perm + (size_t)i_perm*n;
+            for(int ind=0; ind<n; ind++)
+                Yperm(ind,j) = YY(this_perm[ind], col);
+            yyperm[j] = yy[col];
+        }
+
+        VectorXd minrss = VectorXd::Constant(n_ycol, std::numeric_limits<double>::infinity());
+        for(int s0=0; s0<n_slice; s0 += block_size) {
+            const int n_block = std::min(block_size, n_slice - s0);
+
+            const MatrixXd QtY = Q.middleCols((Eigen::Index)s0*p, n_block*p).adjoint() * Yperm;
+
+            for(int b=0; b<n_block; b++) {
+                const int r = rank[s0+b];
+                for(int j=0; j<n_ycol; j++) {
+                    double rss = yyperm[j] - QtY.block(b*p, j, r, 1).squaredNorm();
+                    if(rss < cancel_tol * yyperm[j])
+                        rss = (Yperm.col(j) - Q.middleCols((Eigen::Index)(s0+b)*p, r) *
+                               QtY.block(b*p, j, r, 1)).squaredNorm();
+                    if(rss < minrss[j]) minrss[j] = rss;
+                }
+            }
+        }
+
+        for(int j=0; j<n_ycol; j++) res[j0+j] = minrss[j];
+    });
+
+    return result;
+}
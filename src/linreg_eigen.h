@@ -66,6 +66,13 @@ Rcpp::NumericVector calc_fitted_linreg_eigenqr(const Rcpp::NumericMatrix& X,
                                                const Rcpp::NumericVector& y,
                                                const double tol);
 
+// least squares by QR decomposition with column pivoting
+// return just the fitted values
+// (Eigen objects only, so may be called from worker threads)
+Eigen::VectorXd calc_fitted_linreg_eigenqr(const Eigen::MatrixXd& X,
+                                           const Eigen::VectorXd& y,
+                                           const double tol);
+
 // least squares by "LLt" Cholesky decomposition, with matrix Y
 // return vector of RSS
 Rcpp::NumericVector calc_mvrss_eigenchol(const Rcpp::NumericMatrix& X,
@@ -88,4 +95,23 @@ Rcpp::NumericMatrix calc_resid_eigenqr(const Rcpp::NumericMatrix& X,
                                        const Rcpp::NumericMatrix& Y,
                                        const double tol);
 
+// least squares by QR decomposition with column pivoting, with matrix Y
+// and X a 3d array; regress Y on each slice of X, using n_threads threads
+// return matrix of RSS (ncol(Y) x n_slice)
+Rcpp::NumericMatrix calc_mvrss_eigenqr_3d(const Rcpp::NumericVector& X,
+                                          const Rcpp::NumericMatrix& Y,
+                                          const double tol,
+                                          const int n_threads);
+
+// least squares by QR decomposition with column pivoting, with X a 3d
+// array and the columns of Y permuted according to the columns of perms
+// (0-based indexes); regress each permuted column of Y on each slice of X,
+// using n_threads threads
+// return matrix of minimum RSS across slices (ncol(perms) x ncol(Y))
+Rcpp::NumericMatrix calc_minrss_eigenqr_3d_perm(const Rcpp::NumericVector& X,
+                                                const Rcpp::NumericMatrix& Y,
+                                                const Rcpp::IntegerMatrix& perms,
+                                                const double tol,
+                                                const int n_threads);
+
 #endif // LINREG_EIGEN_H
@@ -7,6 +7,8 @@
 
 #include "lmm.h"
 #include <math.h>
+#include <vector>
+#include <algorithm>
 #include <RcppEigen.h>
 
 using namespace Rcpp;
@@ -14,6 +16,7 @@ using namespace Eigen;
 
 #include "brent_fmin.h"
 #include "linreg_eigen.h" // contains calc_XpX
+#include "parallel_util.h"
 
 // eigen decomposition
 // returns eigenvalues and *transposed* eigenvectors
@@ -45,6 +48,94 @@ List Rcpp_eigen_decomp(const NumericMatrix& A)
     return result_list;
 }
 
+// truncated eigen decomposition, by randomized subspace iteration
+//    returns eigenvalues and transposed eigenvectors, as with eigen_decomp()
+//
+// A          = symmetric, positive semi-definite matrix (n x n)
+// Omega      = random matrix (n x l, with l >= rank), e.g. iid normal
+// rank       = number of eigenvalues to calculate
+// n_power    = number of power iterations
+//
+// The largest rank eigenvalues and their eigenvectors are approximated
+// (Halko, Martinsson and Tropp 2011). The remaining n-rank eigenvalues
+// are replaced by their average, from the trace of A, with an
+// orthonormal basis of the complement as eigenvectors. The result
+// has the same form as from eigen_decomp(), with the residual
+// eigenvalues first.
+std::pair<VectorXd, MatrixXd> eigen_decomp_randomized(const MatrixXd& A,
+                                                      const MatrixXd& Omega,
+                                                      const int rank,
+                                                      const int n_power)
+{
+    const int n = A.rows();
+    const int l = Omega.cols();
+    if(rank >= n) return eigen_decomp(A);
+    if(rank < 1 || rank > l)
+        throw std::invalid_argument("rank should be between 1 and ncol(Omega)");
+
+    // orthonormal basis for range of A Omega, with power iterations
+    MatrixXd Q = A * Omega;
+    for(int iter=0; ; iter++) {
+        HouseholderQR<MatrixXd> qr(Q);
+        Q = qr.householderQ() * MatrixXd::Identity(n, l);
+        if(iter == n_power) break;
+        Q = A * Q;
+    }
+
+    // eigen decomposition of projection of A (eigenvalues in increasing order)
+    const SelfAdjointEigenSolver<MatrixXd> VLV(Q.transpose() * A * Q);
+    const VectorXd evals = VLV.eigenvalues().tail(rank);
+    const MatrixXd evecs = Q * VLV.eigenvectors().rightCols(rank);
+
+    // residual eigenvalues: average of what's left of the trace
+    double resid = (A.trace() - evals.sum())/(double)(n - rank);
+    if(resid < 0.0) resid = 0.0;
+
+    // orthonormal basis for the complement of the eigenvectors
+    HouseholderQR<MatrixXd> qr(evecs);
+    const MatrixXd Qfull = qr.householderQ();
+
+    VectorXd values(n);
+    MatrixXd vectors(n, n);
+    values.head(n-rank).setConstant(resid);
+    values.tail(rank) = evals;
+    vectors.topRows(n-rank) = Qfull.rightCols(n-rank).transpose();
+    vectors.bottomRows(rank) = evecs.transpose();
+
+    return std::make_pair(values, vectors);
+}
+
+// truncated eigen decomposition (version to be called from R)
+// returns eigenvalues and *transposed* eigenvectors
+// [[Rcpp::export]]
+List Rcpp_eigen_decomp_randomized(const NumericMatrix& A, const int rank,
+                                  const int oversample=10, const int n_power=2)
+{
+    if(A.cols() != A.rows())
+        throw std::invalid_argument("A must be a square matrix");
+    const int n = A.rows();
+    const int l = std::min(rank + oversample, n);
+
+    // random starting matrix, with R's RNG
+    MatrixXd Omega(n, l);
+    for(int j=0; j<l; j++)
+        for(int i=0; i<n; i++)
+            Omega(i,j) = R::norm_rand();
+
+    const MatrixXd AA(as<Map<MatrixXd> >(A));
+    const std::pair<VectorXd,MatrixXd> result = eigen_decomp_randomized(AA, Omega, rank, n_power);
+
+    // set dimnames of eigenvector matrix
+    NumericMatrix eigenvec(wrap(result.second));
+    eigenvec.attr("dimnames") = A.attr("dimnames");
+
+    List result_list = List::create(Named("values") = result.first,
+                                    Named("vectors") = eigenvec);
+    result_list.attr("eigen_decomp") = true;
+
+    return result_list;
+}
+
 // eigen + rotation
 // perform eigen decomposition of kinship matrix
 // and rotate phenotype and covariate matrices by transpose of eigenvectors
@@ -260,6 +351,16 @@ double negLL(const double x, struct calcLL_args *args)
 struct lmm_fit fitLMM(const VectorXd& Kva, const VectorXd& y, const MatrixXd& X,
                       const bool reml=true, const bool check_boundary=true,
                       const double logdetXpX=NA_REAL, const double tol=1e-4)
+{
+    return fitLMM_interval(Kva, y, X, reml, check_boundary, logdetXpX, tol, 0.0, 1.0);
+}
+
+// fitLMM, with the optimization over hsq restricted to [lower, upper]
+// (the boundaries 0 and 1 are still checked if check_boundary=true)
+struct lmm_fit fitLMM_interval(const VectorXd& Kva, const VectorXd& y, const MatrixXd& X,
+                               const bool reml, const bool check_boundary,
+                               const double logdetXpX, const double tol,
+                               const double lower, const double upper)
 {
     struct lmm_fit result;
 
@@ -277,7 +378,7 @@ struct lmm_fit fitLMM(const VectorXd& Kva, const VectorXd& y, const MatrixXd& X,
     args.reml = reml;
     args.logdetXpX = logdetXpX_val;
 
-    const double hsq = lmm_Brent_fmin(0.0, 1.0, negLL, &args, tol);
+    const double hsq = lmm_Brent_fmin(lower, upper, negLL, &args, tol);
     result = calcLL(hsq, Kva, y, X, reml, logdetXpX_val);
     result.hsq = hsq;
 
@@ -321,12 +422,131 @@ List Rcpp_fitLMM(const NumericVector& Kva, const NumericVector& y, const Numeric
 }
 
 
+// fitLMM, starting from a previous estimate of hsq
+//
+// Brent's method is first applied within [hsq_start - width, hsq_start + width]
+// (truncated to [0,1]); if the optimum is at an end of that interval,
+// other than 0 or 1, the search is repeated over [0,1].
+struct lmm_fit fitLMM_warmstart(const VectorXd& Kva, const VectorXd& y, const MatrixXd& X,
+                                const bool reml, const bool check_boundary,
+                                const double logdetXpX, const double tol,
+                                const double hsq_start, const double width)
+{
+    const double lower = std::max(0.0, hsq_start - width);
+    const double upper = std::min(1.0, hsq_start + width);
+    const double edge = 0.01*width;
+
+    struct lmm_fit result = fitLMM_interval(Kva, y, X, reml, check_boundary,
+                                            logdetXpX, tol, lower, upper);
+
+    if((lower > 0.0 && result.hsq < lower + edge) ||
+       (upper < 1.0 && result.hsq > upper - edge))
+        result = fitLMM_interval(Kva, y, X, reml, check_boundary, logdetXpX, tol, 0.0, 1.0);
+
+    return result;
+}
+
+// fitLMM for a matrix of phenotypes, batched
+//
+// Kva       = eigenvalues of kinship matrix
+// Y         = rotated matrix of phenotypes
+// X         = rotated matrix of covariates
+// reml      = boolean indicating whether to use REML (vs ML)
+// check_boundary = if true, explicity check 0.0 and 1.0 boundaries
+// logdetXpX = log det X'X; if NA, it's calculated
+// tol       = tolerance for convergence
+// n_grid    = number of intervals in grid of hsq values on [0, 1] (>= 2)
+// n_threads = number of threads to use
+//
+// The log likelihood is first calculated for all phenotypes at the
+// interior grid points, with X'SX calculated once per grid point and
+// X'SY and Y'SY for all phenotypes as matrix products. For each
+// phenotype, hsq is then optimized by Brent's method within the pair of
+// grid intervals around its best grid point.
+std::vector<struct lmm_fit> fitLMM_batch(const VectorXd& Kva, const MatrixXd& Y,
+                                         const MatrixXd& X,
+                                         const bool reml, const bool check_boundary,
+                                         const double logdetXpX, const double tol,
+                                         const int n_grid, const int n_threads)
+{
+    if(n_grid < 2)
+        throw std::invalid_argument("n_grid should be >= 2");
+
+    const int n = Kva.size();
+    const int p = X.cols();
+    const int nphe = Y.cols();
+
+    double logdetXpX_val=logdetXpX;
+    if(reml && NumericVector::is_na(logdetXpX_val))
+        logdetXpX_val = calc_logdetXpX(X);
+
+    const MatrixXd Y2 = Y.cwiseAbs2();
+
+    // log likelihood at interior grid points (grid points x phenotypes)
+    MatrixXd gridLL(n_grid-1, nphe);
+    parallel_for(n_grid-1, n_threads, [&](const int k, const int thread) {
+        const double hsq = (double)(k+1)/(double)n_grid;
+
+        VectorXd S(n);
+        double logdetV = 0.0;
+        for(int i=0; i<n; i++) {
+            const double v = hsq*Kva[i] + 1.0-hsq;
+            S[i] = 1.0/v;
+            logdetV += log(v);
+        }
+
+        const MatrixXd XSt = X.transpose() * S.asDiagonal();
+        const MatrixXd XSX = XSt * X;
+        const MatrixXd XSY = XSt * Y;
+        const VectorXd ySy = Y2.transpose() * S;
+
+        // as in getMLsoln
+        const std::pair<VectorXd, MatrixXd>e = eigen_decomp(XSX);
+        double logdetXSX=0.0;
+        VectorXd inv_evals(p);
+        for(int i=0; i<p; i++) {
+            inv_evals[i] = 1.0/e.first[i];
+            logdetXSX += log(e.first[i]);
+        }
+        const MatrixXd beta = e.second.transpose() * inv_evals.asDiagonal() * e.second * XSY;
+        const VectorXd rss = ySy - XSY.cwiseProduct(beta).colwise().sum().transpose();
+
+        // as in calcLL
+        for(int j=0; j<nphe; j++) {
+            double loglik = -0.5*((double)n*log(rss[j]) + logdetV);
+            if(reml) {
+                const double sigmasq = rss[j]/(double)(n-p);
+                loglik += 0.5*(p*log(2.0 * M_PI * sigmasq) + logdetXpX_val - logdetXSX);
+            }
+            gridLL(k,j) = loglik;
+        }
+    });
+
+    // refine each phenotype's estimate, from its best grid point
+    std::vector<struct lmm_fit> result(nphe);
+    parallel_for(nphe, n_threads, [&](const int j, const int thread) {
+        int best;
+        gridLL.col(j).maxCoeff(&best);
+        const double lower = (double)best/(double)n_grid;
+        const double upper = (double)(best+2)/(double)n_grid;
+
+        result[j] = fitLMM_interval(Kva, Y.col(j), X, reml, check_boundary,
+                                    logdetXpX_val, tol, lower, upper);
+    });
+
+    return result;
+}
+
 // fitLMM with matrix of phenotypes (looping over phenotype columns)
+//
+// if n_grid > 0, use fitLMM_batch() with that many grid intervals
+//
 // [[Rcpp::export]]
 List Rcpp_fitLMM_mat(const NumericVector& Kva, const NumericMatrix& Y,
                      const NumericMatrix& X,
                      const bool reml=true, const bool check_boundary=true,
-                     const double logdetXpX=NA_REAL, const double tol=1e-4)
+                     const double logdetXpX=NA_REAL, const double tol=1e-4,
+                     const int n_grid=0, const int n_threads=1)
 {
     const MatrixXd eKva(as<Map<MatrixXd> >(Kva));
     const MatrixXd eY(as<Map<MatrixXd> >(Y));
@@ -338,12 +558,23 @@ List Rcpp_fitLMM_mat(const NumericVector& Kva, const NumericMatrix& Y,
     NumericVector loglik(nphe);
     NumericVector sigmasq(nphe);
 
-    for(int i=0; i<nphe; i++) {
-        const struct lmm_fit result = fitLMM(eKva, eY.col(i), eX, reml, check_boundary,
-                                             logdetXpX, tol);
-        hsq[i] = result.hsq;
-        loglik[i] = result.loglik;
-        sigmasq[i] = result.sigmasq;
+    if(n_grid > 0) {
+        const std::vector<struct lmm_fit> result = fitLMM_batch(eKva, eY, eX, reml, check_boundary,
+                                                                logdetXpX, tol, n_grid, n_threads);
+        for(int i=0; i<nphe; i++) {
+            hsq[i] = result[i].hsq;
+            loglik[i] = result[i].loglik;
+            sigmasq[i] = result[i].sigmasq;
+        }
+    }
+    else {
+        for(int i=0; i<nphe; i++) {
+            const struct lmm_fit result = fitLMM(eKva, eY.col(i), eX, reml, check_boundary,
+                                                 logdetXpX, tol);
+            hsq[i] = result.hsq;
+            loglik[i] = result.loglik;
+            sigmasq[i] = result.sigmasq;
+        }
     }
 
     return List::create(Named("hsq") = hsq,
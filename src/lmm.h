@@ -7,6 +7,7 @@
 #define LMM_H
 
 #include <math.h>
+#include <vector>
 #include <RcppEigen.h>
 
 struct lmm_fit {
@@ -41,6 +42,19 @@ std::pair<Eigen::VectorXd, Eigen::MatrixXd> eigen_decomp(const Eigen::MatrixXd&
 //    returns list with eigenvalues and transposed eigenvectors
 Rcpp::List Rcpp_eigen_decomp(const Rcpp::NumericMatrix &A);
 
+// truncated eigen decomposition, by randomized subspace iteration
+//    returns eigenvalues and transposed eigenvectors; the remaining
+//    eigenvalues are replaced by their average
+std::pair<Eigen::VectorXd, Eigen::MatrixXd> eigen_decomp_randomized(const Eigen::MatrixXd& A,
+                                                                    const Eigen::MatrixXd& Omega,
+                                                                    const int rank,
+                                                                    const int n_power);
+
+// truncated eigen decomposition
+//    returns list with eigenvalues and transposed eigenvectors
+Rcpp::List Rcpp_eigen_decomp_randomized(const Rcpp::NumericMatrix& A, const int rank,
+                                        const int oversample, const int n_power);
+
 // eigen + rotation
 // perform eigen decomposition of kinship matrix
 // and rotate phenotype and covariate matrices by transpose of eigenvectors
@@ -130,6 +144,46 @@ struct lmm_fit fitLMM(const Eigen::VectorXd& Kva,
                       const double logdetXpX,
                       const double tol);
 
+// fitLMM, with the optimization over hsq restricted to [lower, upper]
+// (the boundaries 0 and 1 are still checked if check_boundary=true)
+struct lmm_fit fitLMM_interval(const Eigen::VectorXd& Kva,
+                               const Eigen::VectorXd& y,
+                               const Eigen::MatrixXd& X,
+                               const bool reml,
+                               const bool check_boundary,
+                               const double logdetXpX,
+                               const double tol,
+                               const double lower,
+                               const double upper);
+
+// fitLMM, starting from a previous estimate of hsq
+// (first searching within hsq_start +/- width, and then over [0,1]
+// if the optimum is at the end of that interval)
+struct lmm_fit fitLMM_warmstart(const Eigen::VectorXd& Kva,
+                                const Eigen::VectorXd& y,
+                                const Eigen::MatrixXd& X,
+                                const bool reml,
+                                const bool check_boundary,
+                                const double logdetXpX,
+                                const double tol,
+                                const double hsq_start,
+                                const double width);
+
+// fitLMM for a matrix of phenotypes, batched
+//
+// log likelihood calculated for all phenotypes on a grid of n_grid
+// intervals for hsq, then refined for each phenotype by Brent's method
+// in the intervals around the best grid point
+std::vector<struct lmm_fit> fitLMM_batch(const Eigen::VectorXd& Kva,
+                                         const Eigen::MatrixXd& Y,
+                                         const Eigen::MatrixXd& X,
+                                         const bool reml,
+                                         const bool check_boundary,
+                                         const double logdetXpX,
+                                         const double tol,
+                                         const int n_grid,
+                                         const int n_threads);
+
 // fitLMM (version called from R)
 Rcpp::List Rcpp_fitLMM(const Rcpp::NumericVector& Kva,
                        const Rcpp::NumericVector& y,
@@ -140,9 +194,11 @@ Rcpp::List Rcpp_fitLMM(const Rcpp::NumericVector& Kva,
                        const double tol);
 
 // fitLMM with matrix of phenotypes (looping over phenotype columns)
+// if n_grid > 0, use fitLMM_batch() with that many grid intervals
 Rcpp::List Rcpp_fitLMM_mat(const Rcpp::NumericVector& Kva, const Rcpp::NumericMatrix& Y,
                            const Rcpp::NumericMatrix& X,
                            const bool reml, const bool check_boundary,
-                           const double logdetXpX, const double tol);
+                           const double logdetXpX, const double tol,
+                           const int n_grid, const int n_threads);
 
 #endif // LMM_H
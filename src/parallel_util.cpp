@@ -0,0 +1,79 @@
+// run a loop in parallel using native threads
+
+#include "parallel_util.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <Rcpp.h>
+
+static void check_interrupt_fn(void *dummy)
+{
+    R_CheckUserInterrupt();
+}
+
+// check for ^C from user, without jumping out of the current context
+static bool user_interrupt()
+{
+    return (R_ToplevelExec(check_interrupt_fn, NULL) == FALSE);
+}
+
+void parallel_for(const int n, const int n_threads,
+                  const std::function<void(int, int)>& f)
+{
+    if(n <= 0) return;
+
+    int nt = n_threads;
+    if(nt > n) nt = n;
+    if(nt <= 1) { // just run in this thread
+        for(int i=0; i<n; i++) {
+            Rcpp::checkUserInterrupt();  // check for ^C from user
+            f(i, 0);
+        }
+        return;
+    }
+
+    std::atomic<int> next_i(0);
+    std::atomic<bool> stop(false);
+    bool interrupted = false; // only touched by the calling thread
+    std::exception_ptr error = nullptr;
+    std::mutex error_mutex;
+
+    auto worker = [&](const int thread) {
+        while(!stop) {
+            const int i = next_i++;
+            if(i >= n) break;
+
+            try {
+                f(i, thread);
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if(!error) error = std::current_exception();
+                stop = true;
+            }
+
+            if(thread == 0 && user_interrupt()) {
+                interrupted = true;
+                stop = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int thread=1; thread<nt; thread++) {
+        try {
+            threads.emplace_back(worker, thread);
+        }
+        catch(const std::system_error&) { // couldn't start a thread; make do with those we have
+            break;
+        }
+    }
+    worker(0);
+    for(auto& th : threads) th.join();
+
+    if(interrupted) throw Rcpp::internal::InterruptedException();
+    if(error) std::rethrow_exception(error);
+}
@@ -0,0 +1,19 @@
+// run a loop in parallel using native threads
+#ifndef PARALLEL_UTIL_H
+#define PARALLEL_UTIL_H
+
+#include <functional>
+
+// Run f(i, thread) for i in {0, ..., n-1}, using up to n_threads threads
+//
+// thread is in {0, ..., n_threads-1}, for indexing into thread-local workspace.
+// f is called from worker threads, and so must not use the R API
+// (no allocation of R objects, no Rcpp::checkUserInterrupt()).
+//
+// The calling thread acts as thread 0 and checks for ^C from the user;
+// an interrupt or an exception thrown by f stops the loop and is
+// re-thrown in the calling thread after all threads have finished.
+void parallel_for(const int n, const int n_threads,
+                  const std::function<void(int, int)>& f);
+
+#endif // PARALLEL_UTIL_H
@@ -1,13 +1,158 @@
 // genome scan by logistic regression
 
 #include "scan1_binary.h"
-#include <Rcpp.h>
+#include <atomic>
+#include <vector>
+#include <RcppEigen.h>
 
 using namespace Rcpp;
 
 #include "binreg.h"
 #include "binreg_weighted.h"
+#include "binreg_eigen.h"
+#include "binreg_weighted_eigen.h"
+#include "linreg_eigen.h"
 #include "matrix.h"
+#include "parallel_util.h"
+#include "r_message.h"
+
+// columns of phenotype matrix, as Eigen vectors
+static std::vector<Eigen::VectorXd> pheno_columns(const NumericMatrix& pheno)
+{
+    const int n_ind = pheno.rows(), n_phe = pheno.cols();
+    std::vector<Eigen::VectorXd> result(n_phe);
+
+    for(int phe=0; phe<n_phe; phe++)
+        result[phe] = Eigen::Map<const Eigen::VectorXd>(pheno.begin() + phe*n_ind, n_ind);
+
+    return result;
+}
+
+// logistic regression, with or without weights (weights empty if none)
+static double calc_ll_binreg_eigen(const Eigen::MatrixXd& X, const Eigen::VectorXd& y,
+                                   const Eigen::VectorXd& weights,
+                                   const int maxit, const double tol,
+                                   const double qr_tol, const double eta_max,
+                                   bool& converged, Eigen::VectorXd& eta)
+{
+    if(weights.size() == 0)
+        return calc_ll_binreg_eigenqr(X, y, maxit, tol, qr_tol, eta_max, converged, eta);
+    else
+        return calc_ll_binreg_weighted_eigenqr(X, y, weights, maxit, tol, qr_tol, eta_max, converged, eta);
+}
+
+// the work for scan_binary_onechr() and scan_binary_onechr_weighted()
+//
+// weights       = vector of weights (empty if none)
+// warm_start    = if true, start each fit from the fitted linear predictor
+//                 at the previous position
+// prescreen_lod = if > 0, first calculate the score statistic at each
+//                 position, from the fit under the null; if the score statistic
+//                 converted to the LOD scale is < prescreen_lod/2, skip the full fit
+//                 and return NA
+//
+// Work is split across threads by phenotype x chunks of consecutive positions,
+// with the same chunks regardless of the number of threads.
+static NumericMatrix scan_binary_onechr_engine(const NumericVector& genoprobs,
+                                               const NumericMatrix& pheno,
+                                               const NumericMatrix& addcovar,
+                                               const Eigen::VectorXd& weights,
+                                               const int maxit, const double tol,
+                                               const double qr_tol, const double eta_max,
+                                               const bool warm_start,
+                                               const double prescreen_lod,
+                                               const int n_threads)
+{
+    const int n_ind = pheno.rows();
+    const int n_phe = pheno.cols();
+    const Dimension d = genoprobs.attr("dim");
+    const int n_pos = d[2];
+    const int n_gen = d[1];
+    const int n_add = addcovar.cols();
+    const size_t g_size = (size_t)n_ind * n_gen;
+    const bool prescreen = (prescreen_lod > 0.0);
+
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
+
+    NumericMatrix result(n_phe, n_pos);
+    double *res = result.begin();
+
+    // phenotypes and a copy of X for each thread, with covariates pasted in
+    const std::vector<Eigen::VectorXd> y = pheno_columns(pheno);
+    const Eigen::Map<Eigen::MatrixXd> X0(Rcpp::as<Eigen::Map<Eigen::MatrixXd> >(addcovar));
+    std::vector<Eigen::MatrixXd> X(std::max(1, n_threads), Eigen::MatrixXd(n_ind, n_gen+n_add));
+    for(auto& XX : X)
+        XX.rightCols(n_add) = X0;
+
+    std::atomic<int> n_notconverged(0);
+
+    // for the prescreen: fit under the null for each phenotype, giving
+    // the square-root of the IRLS weights (wt0), the "score residuals" (r0)
+    // with score = (wt0 X)' r0, and the null log likelihood
+    std::vector<Eigen::VectorXd> wt0, r0;
+    std::vector<double> llik0;
+    if(prescreen) {
+        wt0.resize(n_phe); r0.resize(n_phe); llik0.resize(n_phe);
+        const Eigen::MatrixXd XX0(X0);
+        parallel_for(n_phe, n_threads, [&](const int phe, const int thread) {
+            bool converged;
+            Eigen::VectorXd eta;
+            llik0[phe] = calc_ll_binreg_eigen(XX0, y[phe], weights, maxit, tol, qr_tol, eta_max, converged, eta);
+            if(!converged) n_notconverged++;
+
+            wt0[phe].resize(n_ind); r0[phe].resize(n_ind);
+            for(int ind=0; ind<n_ind; ind++) {
+                const double pi = exp(eta[ind])/(1.0 + exp(eta[ind]));
+                const double w = (weights.size() == 0) ? 1.0 : weights[ind];
+                wt0[phe][ind] = sqrt(pi*(1.0-pi)*w);
+                r0[phe][ind] = w*(y[phe][ind] - pi)/wt0[phe][ind];
+            }
+        });
+    }
+
+    // split phenotypes x chunks of positions across threads
+    const int chunk_size = warm_start ? 32 : 1;
+    const int n_chunk = (n_pos + chunk_size - 1) / chunk_size;
+    const double lod_factor = 2.0*log(10.0); // score statistic -> LOD
+    // the score statistic approximates the likelihood ratio statistic but
+    // isn't a bound on it, so skip a position only if it's well below the
+    // threshold, and then report NA rather than an approximate value
+    const double prescreen_margin = 0.5;
+
+    parallel_for(n_chunk*n_phe, n_threads, [&](const int i, const int thread) {
+        const int phe = i / n_chunk, chunk = i % n_chunk;
+        const int pos0 = chunk*chunk_size, pos1 = std::min(n_pos, pos0 + chunk_size);
+        Eigen::MatrixXd& XX = X[thread];
+        Eigen::VectorXd eta; // empty, so the first fit starts from y
+
+        for(int pos=pos0; pos<pos1; pos++) {
+            // copy genoprobs for this pos into the matrix
+            XX.leftCols(n_gen) = Eigen::Map<const Eigen::MatrixXd>(genoprobs.begin() + pos*g_size, n_ind, n_gen);
+
+            if(prescreen) {
+                const Eigen::MatrixXd XXw = wt0[phe].asDiagonal() * XX;
+                const Eigen::VectorXd fitted = calc_fitted_linreg_eigenqr(XXw, r0[phe], qr_tol);
+                const double score = r0[phe].squaredNorm() - (r0[phe] - fitted).squaredNorm();
+                if(score/lod_factor < prescreen_margin*prescreen_lod) {
+                    res[phe + (size_t)pos*n_phe] = NA_REAL;
+                    continue;
+                }
+            }
+
+            if(!warm_start) eta.resize(0);
+
+            bool converged;
+            res[phe + (size_t)pos*n_phe] = calc_ll_binreg_eigen(XX, y[phe], weights, maxit, tol, qr_tol,
+                                                                 eta_max, converged, eta);
+            if(!converged) n_notconverged++;
+        }
+    });
+
+    if(n_notconverged > 0) r_warning("binary trait regression didn't converge: increase maxit or tol");
+
+    return result;
+}
 
 
 // Scan a single chromosome with additive covariates
@@ -16,6 +161,11 @@ using namespace Rcpp;
 // pheno     = matrix of numeric phenotypes (individuals x phenotypes)
 //             (no missing data allowed, all must have values in [0,1])
 // addcovar  = additive covariates (an intercept, at least)
+// warm_start = if true, start each fit from the fit at the previous position
+// prescreen_lod = if > 0, skip the full fit at positions where the
+//             score statistic (on the LOD scale) is below half this value,
+//             with NA as the result
+// n_threads = number of threads to use (over positions x phenotypes)
 //
 // output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
 //
@@ -26,43 +176,26 @@ NumericMatrix scan_binary_onechr(const NumericVector& genoprobs,
                                  const int maxit=100,
                                  const double tol=1e-6,
                                  const double qr_tol=1e-12,
-                                 const double eta_max=30.0)
+                                 const double eta_max=30.0,
+                                 const bool warm_start=false,
+                                 const double prescreen_lod=0.0,
+                                 const int n_threads=1)
 {
     const int n_ind = pheno.rows();
-    const int n_phe = pheno.cols();
     if(Rf_isNull(genoprobs.attr("dim")))
         throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
     const Dimension d = genoprobs.attr("dim");
     if(d.size() != 3)
         throw std::invalid_argument("genoprobs should be a 3d array");
-    const int n_pos = d[2];
-    const int n_gen = d[1];
     if(n_ind != d[0])
         throw std::range_error("nrow(pheno) != nrow(genoprobs)");
     if(n_ind != addcovar.rows())
         throw std::range_error("nrow(pheno) != nrow(addcovar)");
-    const int n_add = addcovar.cols();
-    const int g_size = n_ind * n_gen;
-
-    NumericMatrix result(n_phe, n_pos);
-    NumericMatrix X(n_ind, n_gen+n_add);
-
-    if(n_add > 0) // paste in covariates, if present
-        std::copy(addcovar.begin(), addcovar.end(), X.begin() + g_size);
-
-    for(int pos=0, offset=0; pos<n_pos; pos++, offset += g_size) {
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // copy genoprobs for this pos into a matrix
-        std::copy(genoprobs.begin() + offset, genoprobs.begin() + offset + g_size, X.begin());
 
-        for(int phe=0; phe<n_phe; phe++) {
-            // calc rss and paste into ith column of result
-            result(phe,pos) = calc_ll_binreg(X, pheno(_,phe), maxit, tol, qr_tol, eta_max);
-        }
-    }
-
-    return result;
+    const Eigen::VectorXd no_weights;
+    return scan_binary_onechr_engine(genoprobs, pheno, addcovar, no_weights,
+                                     maxit, tol, qr_tol, eta_max,
+                                     warm_start, prescreen_lod, n_threads);
 }
 
 // Scan a single chromosome with additive covariates and weights
@@ -72,6 +205,11 @@ NumericMatrix scan_binary_onechr(const NumericVector& genoprobs,
 //             (no missing data allowed, values should be in [0,1])
 // addcovar  = additive covariates (an intercept, at least)
 // weights   = vector of weights
+// warm_start = if true, start each fit from the fit at the previous position
+// prescreen_lod = if > 0, skip the full fit at positions where the
+//             score statistic (on the LOD scale) is below half this value,
+//             with NA as the result
+// n_threads = number of threads to use (over positions x phenotypes)
 //
 // output    = matrix of (weighted) residual sums of squares (RSS) (phenotypes x positions)
 //
@@ -83,7 +221,10 @@ NumericMatrix scan_binary_onechr_weighted(const NumericVector& genoprobs,
                                           const int maxit=100,
                                           const double tol=1e-6,
                                           const double qr_tol=1e-12,
-                                          const double eta_max=30.0)
+                                          const double eta_max=30.0,
+                                          const bool warm_start=false,
+                                          const double prescreen_lod=0.0,
+                                          const int n_threads=1)
 {
     const int n_ind = pheno.rows();
     if(Rf_isNull(genoprobs.attr("dim")))
@@ -97,31 +238,11 @@ NumericMatrix scan_binary_onechr_weighted(const NumericVector& genoprobs,
         throw std::range_error("nrow(pheno) != nrow(addcovar)");
     if(n_ind != weights.size())
         throw std::range_error("nrow(pheno) != length(weights)");
-    const int n_pos = d[2];
-    const int n_gen = d[1];
-    const int n_add = addcovar.cols();
-    const int g_size = n_ind * n_gen;
-    const int n_phe = pheno.cols();
-
-    NumericMatrix result(n_phe, n_pos);
-    NumericMatrix X(n_ind, n_gen+n_add);
-
-    if(n_add > 0) // paste in covariates, if present
-        std::copy(addcovar.begin(), addcovar.end(), X.begin() + g_size);
-
-    for(int pos=0, offset=0; pos<n_pos; pos++, offset += g_size) {
-        Rcpp::checkUserInterrupt();  // check for ^C from user
 
-        // copy genoprobs for this pos into a matrix
-        std::copy(genoprobs.begin() + offset, genoprobs.begin() + offset + g_size, X.begin());
-
-        for(int phe=0; phe<n_phe; phe++) {
-            // calc rss and paste into ith column of result
-            result(phe,pos) = calc_ll_binreg_weighted(X, pheno(_,phe), weights, maxit, tol, qr_tol, eta_max);
-        }
-    }
-
-    return result;
+    const Eigen::VectorXd wts(Rcpp::as<Eigen::Map<Eigen::VectorXd> >(weights));
+    return scan_binary_onechr_engine(genoprobs, pheno, addcovar, wts,
+                                     maxit, tol, qr_tol, eta_max,
+                                     warm_start, prescreen_lod, n_threads);
 }
 
 // Scan a single chromosome with interactive covariates
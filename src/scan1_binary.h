@@ -10,6 +10,11 @@
 // pheno     = matrix of numeric phenotypes (individuals x phenotypes)
 //             (no missing data allowed, all must have values in [0,1])
 // addcovar  = additive covariates (an intercept, at least)
+// warm_start = if true, start each fit from the fit at the previous position
+// prescreen_lod = if > 0, skip the full fit at positions where the
+//             score statistic (on the LOD scale) is below half this value,
+//             with NA as the result
+// n_threads = number of threads to use (over positions x phenotypes)
 //
 // output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
 Rcpp::NumericMatrix scan_binary_onechr(const Rcpp::NumericVector& genoprobs,
@@ -18,7 +23,10 @@ Rcpp::NumericMatrix scan_binary_onechr(const Rcpp::NumericVector& genoprobs,
                                        const int maxit,
                                        const double tol,
                                        const double qr_tol,
-                                       const double eta_max);
+                                       const double eta_max,
+                                       const bool warm_start,
+                                       const double prescreen_lod,
+                                       const int n_threads);
 
 // Scan a single chromosome with additive covariates and weights
 //
@@ -27,6 +35,11 @@ Rcpp::NumericMatrix scan_binary_onechr(const Rcpp::NumericVector& genoprobs,
 //             (no missing data allowed, values should be in [0,1])
 // addcovar  = additive covariates (an intercept, at least)
 // weights   = vector of weights (really the SQUARE ROOT of the weights)
+// warm_start = if true, start each fit from the fit at the previous position
+// prescreen_lod = if > 0, skip the full fit at positions where the
+//             score statistic (on the LOD scale) is below half this value,
+//             with NA as the result
+// n_threads = number of threads to use (over positions x phenotypes)
 //
 // output    = matrix of (weighted) residual sums of squares (RSS) (phenotypes x positions)
 Rcpp::NumericMatrix scan_binary_onechr_weighted(const Rcpp::NumericVector& genoprobs,
@@ -36,7 +49,10 @@ Rcpp::NumericMatrix scan_binary_onechr_weighted(const Rcpp::NumericVector& genop
                                                 const int maxit,
                                                 const double tol,
                                                 const double qr_tol,
-                                                const double eta_max);
+                                                const double eta_max,
+                                                const bool warm_start,
+                                                const double prescreen_lod,
+                                                const int n_threads);
 
 // Scan a single chromosome with interactive covariates
 // this version should be fast but requires more memory
@@ -14,39 +14,26 @@ using namespace Rcpp;
 // pheno     = matrix of numeric phenotypes (individuals x phenotypes)
 //             (no missing data allowed)
 //
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
+//
 // output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
 //
 // [[Rcpp::export]]
 NumericMatrix scan_hk_onechr_nocovar(const NumericVector& genoprobs, const NumericMatrix& pheno,
-                                     const double tol=1e-12)
+                                     const double tol=1e-12, const int n_threads=1)
 {
     const int n_ind = pheno.rows();
-    const int n_phe = pheno.cols();
     if(Rf_isNull(genoprobs.attr("dim")))
         throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
     const Dimension d = genoprobs.attr("dim");
     if(d.size() != 3)
         throw std::invalid_argument("genoprobs should be a 3d array");
-    const int n_pos = d[2];
-    const int n_gen = d[1];
-    const int x_size = n_ind * n_gen;
     if(d[0] != n_ind)
         throw std::range_error("nrow(pheno) != nrow(genoprobs)");
 
-    NumericMatrix result(n_phe, n_pos);
-    NumericMatrix X(n_ind, n_gen);
-
-    for(int i=0, offset=0; i<n_pos; i++, offset += x_size) {
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // copy genoprobs for pos i into a matrix
-        std::copy(genoprobs.begin() + offset, genoprobs.begin() + offset + x_size, X.begin());
-
-        // calc rss and paste into ith column of result
-        result(_,i) = calc_rss_linreg(X, pheno, tol);
-    }
-
-    return result;
+    // QR of each position's genoprobs, with the projections of all
+    // phenotypes for a block of positions done as one matrix product
+    return calc_rss_linreg_3d(genoprobs, pheno, tol, n_threads);
 }
 
 
@@ -56,12 +43,14 @@ NumericMatrix scan_hk_onechr_nocovar(const NumericVector& genoprobs, const Numer
 // pheno     = matrix of numeric phenotypes (individuals x phenotypes)
 //             (no missing data allowed)
 // addcovar  = additive covariates (an intercept, at least)
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
 //
 // output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
 //
 // [[Rcpp::export]]
 NumericMatrix scan_hk_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno,
-                             const NumericMatrix& addcovar, const double tol=1e-12)
+                             const NumericMatrix& addcovar, const double tol=1e-12,
+                             const int n_threads=1)
 {
     const int n_ind = pheno.rows();
     if(Rf_isNull(genoprobs.attr("dim")))
@@ -77,7 +66,7 @@ NumericMatrix scan_hk_onechr(const NumericVector& genoprobs, const NumericMatrix
     NumericVector genoprobs_resid = calc_resid_linreg_3d(addcovar, genoprobs, tol);
     NumericMatrix pheno_resid = calc_resid_linreg(addcovar, pheno, tol);
 
-    return scan_hk_onechr_nocovar(genoprobs_resid, pheno_resid, tol);
+    return scan_hk_onechr_nocovar(genoprobs_resid, pheno_resid, tol, n_threads);
 }
 
 // Scan a single chromosome with additive covariates and weights
@@ -87,13 +76,14 @@ NumericMatrix scan_hk_onechr(const NumericVector& genoprobs, const NumericMatrix
 //             (no missing data allowed)
 // addcovar  = additive covariates (an intercept, at least)
 // weights   = vector of weights (really the SQUARE ROOT of the weights)
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
 //
 // output    = matrix of (weighted) residual sums of squares (RSS) (phenotypes x positions)
 //
 // [[Rcpp::export]]
 NumericMatrix scan_hk_onechr_weighted(const NumericVector& genoprobs, const NumericMatrix& pheno,
                                       const NumericMatrix& addcovar, const NumericVector& weights,
-                                      const double tol=1e-12)
+                                      const double tol=1e-12, const int n_threads=1)
 {
     const int n_ind = pheno.rows();
     if(Rf_isNull(genoprobs.attr("dim")))
@@ -119,7 +109,46 @@ NumericMatrix scan_hk_onechr_weighted(const NumericVector& genoprobs, const Nume
     pheno_wt = calc_resid_linreg(addcovar_wt, pheno_wt, tol);
 
     // now the scan
-    return scan_hk_onechr_nocovar(genoprobs_wt, pheno_wt, tol);
+    return scan_hk_onechr_nocovar(genoprobs_wt, pheno_wt, tol, n_threads);
+}
+
+// Permutation test for a single chromosome with no covariates (just the intercept)
+//
+// genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// perms     = matrix of permutations of the individuals (individuals x n_perm),
+//             with 0-based indexes
+// n_threads = number of threads to use (over blocks of permuted phenotypes)
+//
+// output    = matrix of minimum RSS across positions (permutations x phenotypes)
+//
+// [[Rcpp::export]]
+NumericMatrix scan_hk_onechr_perm(const NumericVector& genoprobs, const NumericMatrix& pheno,
+                                  const IntegerMatrix& perms, const double tol=1e-12,
+                                  const int n_threads=1)
+{
+    const int n_ind = pheno.rows();
+    if(Rf_isNull(genoprobs.attr("dim")))
+        throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
+    const Dimension d = genoprobs.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("genoprobs should be a 3d array");
+    if(n_ind != d[0])
+        throw std::range_error("nrow(pheno) != nrow(genoprobs)");
+    if(n_ind != perms.rows())
+        throw std::range_error("nrow(pheno) != nrow(perms)");
+
+    // regress out the intercept; permuting the residuals is the same
+    // as taking residuals of permuted phenotypes
+    NumericMatrix intercept(n_ind, 1);
+    std::fill(intercept.begin(), intercept.end(), 1.0);
+    NumericVector genoprobs_resid = calc_resid_linreg_3d(intercept, genoprobs, tol);
+    NumericMatrix pheno_resid = calc_resid_linreg(intercept, pheno, tol);
+
+    // QR of each position's genoprobs, reused for all permutations, keeping
+    // just the minimum RSS for each permuted phenotype
+    return calc_minrss_linreg_3d_perm(genoprobs_resid, pheno_resid, perms, tol, n_threads);
 }
 
 // Scan a single chromosome with interactive covariates
@@ -162,7 +191,7 @@ NumericMatrix scan_hk_onechr_intcovar_highmem(const NumericVector& genoprobs,
     NumericMatrix pheno_rev = calc_resid_linreg(addcovar, pheno, tol);
 
     // genotype can
-    return scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol);
+    return scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol, 1);
 }
 
 // Scan a single chromosome with interactive covariates
@@ -215,7 +244,7 @@ NumericMatrix scan_hk_onechr_intcovar_weighted_highmem(const NumericVector& geno
     pheno_rev = calc_resid_linreg(addcovar_rev, pheno_rev, tol);
 
     // genotype can
-    return scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol);
+    return scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol, 1);
 }
 
 // Scan a single chromosome with interactive covariates
@@ -10,11 +10,13 @@
 // pheno     = matrix of numeric phenotypes (individuals x phenotypes)
 //             (no missing data allowed)
 // tol       = tolerance value for QR decomposition for linear regression
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
 //
 // output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
 Rcpp::NumericMatrix scan_hk_onechr_nocovar(const Rcpp::NumericVector& genoprobs,
                                            const Rcpp::NumericMatrix& pheno,
-                                           const double tol);
+                                           const double tol,
+                                           const int n_threads);
 
 
 // Scan a single chromosome with additive covariates
@@ -23,12 +25,14 @@ Rcpp::NumericMatrix scan_hk_onechr_nocovar(const Rcpp::NumericVector& genoprobs,
 // pheno     = matrix of numeric phenotypes (individuals x phenotypes)
 //             (no missing data allowed)
 // addcovar  = additive covariates (an intercept, at least)
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
 //
 // output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
 Rcpp::NumericMatrix scan_hk_onechr(const Rcpp::NumericVector& genoprobs,
                                    const Rcpp::NumericMatrix& pheno,
                                    const Rcpp::NumericMatrix& addcovar,
-                                   const double tol);
+                                   const double tol,
+                                   const int n_threads);
 
 // Scan a single chromosome with additive covariates and weights
 //
@@ -37,13 +41,31 @@ Rcpp::NumericMatrix scan_hk_onechr(const Rcpp::NumericVector& genoprobs,
 //             (no missing data allowed)
 // addcovar  = additive covariates (an intercept, at least)
 // weights   = vector of weights (really the SQUARE ROOT of the weights)
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
 //
 // output    = matrix of (weighted) residual sums of squares (RSS) (phenotypes x positions)
 Rcpp::NumericMatrix scan_hk_onechr_weighted(const Rcpp::NumericVector& genoprobs,
                                             const Rcpp::NumericMatrix& pheno,
                                             const Rcpp::NumericMatrix& addcovar,
                                             const Rcpp::NumericVector& weights,
-                                            const double tol);
+                                            const double tol,
+                                            const int n_threads);
+
+// Permutation test for a single chromosome with no covariates (just the intercept)
+//
+// genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// perms     = matrix of permutations of the individuals (individuals x n_perm),
+//             with 0-based indexes
+// n_threads = number of threads to use (over blocks of permuted phenotypes)
+//
+// output    = matrix of minimum RSS across positions (permutations x phenotypes)
+Rcpp::NumericMatrix scan_hk_onechr_perm(const Rcpp::NumericVector& genoprobs,
+                                        const Rcpp::NumericMatrix& pheno,
+                                        const Rcpp::IntegerMatrix& perms,
+                                        const double tol,
+                                        const int n_threads);
 
 // Scan a single chromosome with interactive covariates
 // this version should be fast but requires more memory
@@ -5,13 +5,162 @@
 #include "scan1_pg.h"
 #include <RcppEigen.h>
 #include <math.h>
+#include <vector>
+#include <algorithm>
 #include "lmm.h"
 #include "scan1_hk.h"
 #include "matrix.h"
 #include "linreg.h"
+#include "parallel_util.h"
 
 using namespace Rcpp;
 
+// Pre-multiply genotype probabilities by the eigenvectors of the kinship matrix
+//
+// genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
+// eigenvec  = matrix of transposed eigenvectors of variance matrix
+// n_threads = number of threads to use (over blocks of positions)
+//
+// output    = 3d array of rotated genotype probabilities, same dimensions as genoprobs
+//
+// [[Rcpp::export]]
+NumericVector rotate_genoprobs(const NumericVector& genoprobs, const NumericMatrix& eigenvec,
+                               const int n_threads=1)
+{
+    if(Rf_isNull(genoprobs.attr("dim")))
+        throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
+    const Dimension d = genoprobs.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("genoprobs should be a 3d array");
+    const int n_ind = d[0];
+    const int n_gen = d[1];
+    const int n_pos = d[2];
+    if(n_ind != eigenvec.rows())
+        throw std::range_error("nrow(genoprobs) != nrow(eigenvec)");
+    if(n_ind != eigenvec.cols())
+        throw std::range_error("nrow(genoprobs) != ncol(eigenvec)");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
+
+    // genoprobs in blocks of positions, split across threads, without a copy of the input
+    NumericVector result(genoprobs.size());
+    result.attr("dim") = d;
+    const Eigen::Map<Eigen::MatrixXd> evec(Rcpp::as<Eigen::Map<Eigen::MatrixXd> >(eigenvec));
+    const int block_size = std::max(1, 256 / std::max(1, n_gen)); // positions per block
+    const int n_block = (n_pos + block_size - 1) / block_size;
+    const size_t g_size = (size_t)n_ind * n_gen;
+    const double *pr = genoprobs.begin();
+    double *pr_rev = result.begin();
+    parallel_for(n_block, n_threads, [&](const int block, const int thread) {
+        const int pos0 = block * block_size;
+        const int n_col = std::min(block_size, n_pos - pos0) * n_gen;
+
+        Eigen::Map<Eigen::MatrixXd>(pr_rev + pos0*g_size, n_ind, n_col).noalias() =
+            evec * Eigen::Map<const Eigen::MatrixXd>(pr + pos0*g_size, n_ind, n_col);
+    });
+
+    return result;
+}
+
+// LMM scan of a single chromosome with additive covariates and weights,
+// with genotype probabilities already pre-multiplied by the eigenvectors,
+// for multiple phenotypes with phenotype-specific weights
+//
+// genoprobs = 3d array of rotated genotype probabilities (individuals x genotypes x positions),
+//             from rotate_genoprobs()
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// eigenvec  = matrix of transposed eigenvectors of variance matrix
+// weights   = matrix of weights (individuals x phenotypes; really the SQUARE ROOT of the weights)
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
+//
+// output    = matrix of log likelihood values (positions x phenotypes)
+//
+// Phenotypes with identical weights (for example, the same heritability)
+// are scanned together, with the genotype probabilities weighted and
+// residualized just once.
+//
+// [[Rcpp::export]]
+NumericMatrix scan_pg_onechr_rotated(const NumericVector& genoprobs, const NumericMatrix& pheno,
+                                     const NumericMatrix& addcovar, const NumericMatrix& eigenvec,
+                                     const NumericMatrix& weights, const double tol=1e-12,
+                                     const int n_threads=1)
+{
+    const int n_ind = pheno.rows();
+    const int n_phe = pheno.cols();
+    if(Rf_isNull(genoprobs.attr("dim")))
+        throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
+    const Dimension d = genoprobs.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("genoprobs should be a 3d array");
+    const int n_pos = d[2];
+    if(n_ind != d[0])
+        throw std::range_error("nrow(pheno) != nrow(genoprobs)");
+    if(n_ind != addcovar.rows())
+        throw std::range_error("nrow(pheno) != nrow(addcovar)");
+    if(n_ind != weights.rows())
+        throw std::range_error("nrow(pheno) != nrow(weights)");
+    if(n_phe != weights.cols())
+        throw std::range_error("ncol(pheno) != ncol(weights)");
+    if(n_ind != eigenvec.rows())
+        throw std::range_error("nrow(pheno) != nrow(eigenvec)");
+    if(n_ind != eigenvec.cols())
+        throw std::range_error("nrow(pheno) != ncol(eigenvec)");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
+
+    // pre-multiply phenotypes and covariates by the eigenvectors
+    const NumericMatrix addcovar_rot = matrix_x_matrix(eigenvec, addcovar);
+    const NumericMatrix pheno_rot = matrix_x_matrix(eigenvec, pheno);
+
+    NumericMatrix result(n_pos, n_phe);
+    std::vector<bool> done(n_phe, false);
+
+    for(int phe=0; phe<n_phe; phe++) {
+        if(done[phe]) continue;
+
+        // phenotypes with the same weights as this one
+        const NumericVector wts = weights(_,phe);
+        std::vector<int> group;
+        for(int phe2=phe; phe2<n_phe; phe2++) {
+            if(!done[phe2] && std::equal(wts.begin(), wts.end(), weights.begin() + (size_t)phe2*n_ind)) {
+                group.push_back(phe2);
+                done[phe2] = true;
+            }
+        }
+        const int n_grp = group.size();
+
+        NumericMatrix pheno_rev(n_ind, n_grp);
+        for(int j=0; j<n_grp; j++)
+            std::copy(pheno_rot.begin() + (size_t)group[j]*n_ind, pheno_rot.begin() + (size_t)(group[j]+1)*n_ind,
+                      pheno_rev.begin() + (size_t)j*n_ind);
+
+        // multiply everything by the (square root) of the weights
+        // (weights should ALREADY be the square-root of the real weights)
+        NumericMatrix addcovar_rev = weighted_matrix(addcovar_rot, wts);
+        pheno_rev = weighted_matrix(pheno_rev, wts);
+        NumericVector genoprobs_rev = weighted_3darray(genoprobs, wts);
+
+        // now regress out the additive covariates
+        genoprobs_rev = calc_resid_linreg_3d(addcovar_rev, genoprobs_rev, tol);
+        pheno_rev = calc_resid_linreg(addcovar_rev, pheno_rev, tol);
+
+        // now the scan, return RSS (phenotypes x positions)
+        NumericMatrix rss = scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol, n_threads);
+
+        // 0.5*sum(log(weights)) [since these are sqrt(weights)]
+        double sum_logweights = sum(log(wts));
+
+        for(int j=0; j<n_grp; j++) {
+            for(int pos=0; pos<n_pos; pos++)
+                result(pos, group[j]) = -(double)n_ind/2.0*log(rss(j,pos)) + sum_logweights;
+        }
+    }
+
+    return result;
+}
+
 // LMM scan of a single chromosome with additive covariates and weights
 //
 // genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
@@ -20,13 +169,15 @@ using namespace Rcpp;
 // addcovar  = additive covariates (an intercept, at least)
 // eigenvec  = matrix of transposed eigenvectors of variance matrix
 // weights   = vector of weights (really the SQUARE ROOT of the weights)
+// n_threads = number of threads to use (over blocks of positions)
 //
 // output    = vector of log likelihood values
 //
 // [[Rcpp::export]]
 NumericVector scan_pg_onechr(const NumericVector& genoprobs, const NumericMatrix& pheno,
                              const NumericMatrix& addcovar, const NumericMatrix& eigenvec,
-                             const NumericVector& weights, const double tol=1e-12)
+                             const NumericVector& weights, const double tol=1e-12,
+                             const int n_threads=1)
 {
     const int n_ind = pheno.rows();
     if(pheno.cols() != 1)
@@ -34,7 +185,6 @@ NumericVector scan_pg_onechr(const NumericVector& genoprobs, const NumericMatrix
     const Dimension d = genoprobs.attr("dim");
     if(d.size() != 3)
         throw std::invalid_argument("genoprobs should be a 3d array");
-    const int n_pos = d[2];
     if(n_ind != d[0])
         throw std::range_error("ncol(pheno) != nrow(genoprobs)");
     if(n_ind != addcovar.rows())
@@ -46,33 +196,131 @@ NumericVector scan_pg_onechr(const NumericVector& genoprobs, const NumericMatrix
     if(n_ind != eigenvec.cols())
         throw std::range_error("ncol(pheno) != ncol(eigenvec)");
 
-    // pre-multiply everything by the eigenvectors
-    NumericVector genoprobs_copy(clone(genoprobs)); // FIX_ME: would be better not to copy
-    NumericVector genoprobs_rev = matrix_x_3darray(eigenvec, genoprobs_copy);
-    NumericMatrix addcovar_rev = matrix_x_matrix(eigenvec, addcovar);
-    NumericMatrix pheno_rev = matrix_x_matrix(eigenvec, pheno);
+    // pre-multiply genoprobs by the eigenvectors
+    NumericVector genoprobs_rot = rotate_genoprobs(genoprobs, eigenvec, n_threads);
 
-    // multiply everything by the (square root) of the weights
-    // (weights should ALREADY be the square-root of the real weights)
-    addcovar_rev = weighted_matrix(addcovar_rev, weights);
-    pheno_rev = weighted_matrix(pheno_rev, weights);
-    genoprobs_rev = weighted_3darray(genoprobs_rev, weights);
+    NumericMatrix weights_mat(n_ind, 1);
+    std::copy(weights.begin(), weights.end(), weights_mat.begin());
 
-    // now regress out the additive covariates
-    genoprobs_rev = calc_resid_linreg_3d(addcovar_rev, genoprobs_rev, tol);
-    pheno_rev = calc_resid_linreg(addcovar_rev, pheno_rev, tol);
+    NumericMatrix loglik = scan_pg_onechr_rotated(genoprobs_rot, pheno, addcovar, eigenvec,
+                                                  weights_mat, tol, n_threads);
 
-    // now the scan, return RSS
-    NumericMatrix rss = scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol);
+    NumericVector result = loglik(_,0);
+    return result;
+}
 
-    // 0.5*sum(log(weights)) [since these are sqrt(weights)]
-    double sum_logweights = sum(log(weights));
+// LMM scan of a single chromosome with additive covariates,
+// with the heritability re-estimated at each position
+//
+// genoprobs = 3d array of rotated genotype probabilities (individuals x genotypes x positions),
+//             from rotate_genoprobs()
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// eigenvec  = matrix of transposed eigenvectors of variance matrix
+// eigenval  = vector of eigenvalues of variance matrix
+// hsq       = heritabilities under the null (one per phenotype), used as starting values
+// reml      = If TRUE, use REML to estimate hsq; otherwise use maximum likelihood
+// check_boundary = if true, explicity check 0.0 and 1.0 boundaries
+// tol       = Numeric tolerance
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
+//
+// output    = list with matrices of log likelihood values (loglik) and
+//             estimated heritabilities (hsq), each positions x phenotypes
+//
+// At each position, the LMM is fit with the genotype probabilities added
+// to the covariates. The search for hsq starts from the estimate at the
+// previous position, within each block of positions.
+//
+// [[Rcpp::export]]
+List scan_pg_onechr_hsq(const NumericVector& genoprobs, const NumericMatrix& pheno,
+                        const NumericMatrix& addcovar, const NumericMatrix& eigenvec,
+                        const NumericVector& eigenval, const NumericVector& hsq,
+                        const bool reml=true, const bool check_boundary=true,
+                        const double tol=1e-12, const int n_threads=1)
+{
+    const int n_ind = pheno.rows();
+    const int n_phe = pheno.cols();
+    if(Rf_isNull(genoprobs.attr("dim")))
+        throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
+    const Dimension d = genoprobs.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("genoprobs should be a 3d array");
+    const int n_gen = d[1];
+    const int n_pos = d[2];
+    const int n_addcovar = addcovar.cols();
+    if(n_ind != d[0])
+        throw std::range_error("nrow(pheno) != nrow(genoprobs)");
+    if(n_ind != addcovar.rows())
+        throw std::range_error("nrow(pheno) != nrow(addcovar)");
+    if(n_ind != eigenvec.rows())
+        throw std::range_error("nrow(pheno) != nrow(eigenvec)");
+    if(n_ind != eigenvec.cols())
+        throw std::range_error("nrow(pheno) != ncol(eigenvec)");
+    if(n_ind != eigenval.size())
+        throw std::range_error("nrow(pheno) != length(eigenval)");
+    if(n_phe != hsq.size())
+        throw std::range_error("ncol(pheno) != length(hsq)");
+    if(n_threads < 1)
+        throw std::range_error("n_threads should be >= 1");
 
-    NumericVector result(n_pos);
-    for(int pos=0; pos<n_pos; pos++)
-        result[pos] = -(double)n_ind/2.0*log(rss[pos]) + sum_logweights;
+    // pre-multiply phenotypes and covariates by the eigenvectors
+    const Eigen::Map<Eigen::MatrixXd> evec(Rcpp::as<Eigen::Map<Eigen::MatrixXd> >(eigenvec));
+    const Eigen::MatrixXd pheno_rot = evec * Rcpp::as<Eigen::Map<Eigen::MatrixXd> >(pheno);
+    const Eigen::MatrixXd addcovar_rot = evec * Rcpp::as<Eigen::Map<Eigen::MatrixXd> >(addcovar);
+    const Eigen::VectorXd Kva(Rcpp::as<Eigen::Map<Eigen::VectorXd> >(eigenval));
 
-    return result;
+    NumericMatrix loglik(n_pos, n_phe);
+    NumericMatrix hsq_pos(n_pos, n_phe);
+    double *loglik_ptr = REAL(loglik);
+    double *hsq_ptr = REAL(hsq_pos);
+    const double *pr = REAL(genoprobs);
+    const double *hsq_null = REAL(hsq);
+
+    // work split into blocks of positions x phenotypes; warm starts within each block
+    const int block_size = 16;
+    const int n_block = (n_pos + block_size - 1) / block_size;
+    const double width = 0.1; // initial search for hsq is +/- width around previous estimate
+
+    parallel_for(n_block * n_phe, n_threads, [&](const int work, const int thread) {
+        const int phe = work / n_block;
+        const int pos0 = (work % n_block) * block_size;
+        const int pos1 = std::min(pos0 + block_size, n_pos);
+
+        const Eigen::VectorXd y = pheno_rot.col(phe);
+        Eigen::MatrixXd X(n_ind, n_addcovar + n_gen);
+        X.leftCols(n_addcovar) = addcovar_rot;
+        double this_hsq = hsq_null[phe];
+
+        for(int pos=pos0; pos<pos1; pos++) {
+            X.rightCols(n_gen) = Eigen::Map<const Eigen::MatrixXd>(pr + (size_t)pos*n_ind*n_gen, n_ind, n_gen);
+
+            // drop linearly dependent columns
+            Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(X);
+            qr.setThreshold(tol);
+            const int rank = qr.rank();
+            Eigen::MatrixXd Xr;
+            if(rank < X.cols()) {
+                std::vector<int> cols(qr.colsPermutation().indices().data(),
+                                      qr.colsPermutation().indices().data() + rank);
+                std::sort(cols.begin(), cols.end());
+                Xr.resize(n_ind, rank);
+                for(int j=0; j<rank; j++) Xr.col(j) = X.col(cols[j]);
+            }
+            else Xr = X;
+
+            const double logdetXpX = reml ? calc_logdetXpX(Xr) : 0.0;
+            const struct lmm_fit fit = fitLMM_warmstart(Kva, y, Xr, reml, check_boundary,
+                                                        logdetXpX, tol, this_hsq, width);
+
+            this_hsq = fit.hsq;
+            loglik_ptr[pos + (size_t)phe*n_pos] = fit.loglik;
+            hsq_ptr[pos + (size_t)phe*n_pos] = fit.hsq;
+        }
+    });
+
+    return List::create(Named("loglik") = loglik,
+                        Named("hsq") = hsq_pos);
 }
 
 // LMM scan of a single chromosome with interactive covariates
@@ -138,7 +386,7 @@ NumericVector scan_pg_onechr_intcovar_highmem(const NumericVector& genoprobs,
     pheno_rev = calc_resid_linreg(addcovar_rev, pheno_rev, tol);
 
     // now the scan, return RSS
-    NumericMatrix rss = scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol);
+    NumericMatrix rss = scan_hk_onechr_nocovar(genoprobs_rev, pheno_rev, tol, 1);
 
     // 0.5*sum(log(weights)) [since these are sqrt(weights)]
     double sum_logweights = sum(log(weights));
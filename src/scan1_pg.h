@@ -5,6 +5,39 @@
 
 #include <Rcpp.h>
 
+// Pre-multiply genotype probabilities by the eigenvectors of the kinship matrix
+//
+// genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
+// eigenvec  = matrix of transposed eigenvectors of variance matrix
+// n_threads = number of threads to use (over blocks of positions)
+//
+// output    = 3d array of rotated genotype probabilities, same dimensions as genoprobs
+Rcpp::NumericVector rotate_genoprobs(const Rcpp::NumericVector& genoprobs,
+                                     const Rcpp::NumericMatrix& eigenvec,
+                                     const int n_threads);
+
+// LMM scan of a single chromosome with additive covariates and weights,
+// with genotype probabilities already pre-multiplied by the eigenvectors,
+// for multiple phenotypes with phenotype-specific weights
+//
+// genoprobs = 3d array of rotated genotype probabilities (individuals x genotypes x positions),
+//             from rotate_genoprobs()
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// eigenvec  = matrix of transposed eigenvectors of variance matrix
+// weights   = matrix of weights (individuals x phenotypes; really the SQUARE ROOT of the weights)
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
+//
+// output    = matrix of log likelihood values (positions x phenotypes)
+Rcpp::NumericMatrix scan_pg_onechr_rotated(const Rcpp::NumericVector& genoprobs,
+                                           const Rcpp::NumericMatrix& pheno,
+                                           const Rcpp::NumericMatrix& addcovar,
+                                           const Rcpp::NumericMatrix& eigenvec,
+                                           const Rcpp::NumericMatrix& weights,
+                                           const double tol,
+                                           const int n_threads);
+
 // LMM scan of a single chromosome with additive covariates and weights
 //
 // genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
@@ -13,6 +46,7 @@
 // addcovar  = additive covariates (an intercept, at least)
 // eigenvec  = matrix of transposed eigenvectors of variance matrix
 // weights   = vector of weights (really the SQUARE ROOT of the weights)
+// n_threads = number of threads to use (over blocks of positions)
 //
 // output    = vector of log likelihood values
 Rcpp::NumericVector scan_pg_onechr(const Rcpp::NumericVector& genoprobs,
@@ -20,7 +54,37 @@ Rcpp::NumericVector scan_pg_onechr(const Rcpp::NumericVector& genoprobs,
                                    const Rcpp::NumericMatrix& addcovar,
                                    const Rcpp::NumericMatrix& eigenvec,
                                    const Rcpp::NumericVector& weights,
-                                   const double tol);
+                                   const double tol,
+                                   const int n_threads);
+
+// LMM scan of a single chromosome with additive covariates,
+// with the heritability re-estimated at each position
+//
+// genoprobs = 3d array of rotated genotype probabilities (individuals x genotypes x positions),
+//             from rotate_genoprobs()
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// eigenvec  = matrix of transposed eigenvectors of variance matrix
+// eigenval  = vector of eigenvalues of variance matrix
+// hsq       = heritabilities under the null (one per phenotype), used as starting values
+// reml      = If TRUE, use REML to estimate hsq; otherwise use maximum likelihood
+// check_boundary = if true, explicity check 0.0 and 1.0 boundaries
+// tol       = Numeric tolerance
+// n_threads = number of threads to use (over blocks of positions x phenotypes)
+//
+// output    = list with matrices of log likelihood values (loglik) and
+//             estimated heritabilities (hsq), each positions x phenotypes
+Rcpp::List scan_pg_onechr_hsq(const Rcpp::NumericVector& genoprobs,
+                              const Rcpp::NumericMatrix& pheno,
+                              const Rcpp::NumericMatrix& addcovar,
+                              const Rcpp::NumericMatrix& eigenvec,
+                              const Rcpp::NumericVector& eigenval,
+                              const Rcpp::NumericVector& hsq,
+                              const bool reml,
+                              const bool check_boundary,
+                              const double tol,
+                              const int n_threads);
 
 // LMM scan of a single chromosome with interactive covariates
 // this version should be fast but requires more memory
@@ -2,6 +2,8 @@
 
 #include "scan1blup.h"
 #include <RcppEigen.h>
+#include <math.h>
+#include <algorithm>
 
 using namespace Rcpp;
 using namespace Eigen;
@@ -10,6 +12,98 @@ using namespace Eigen;
 #include "linreg_eigen.h"  // contains calc_XpX()
 #include "lmm.h"
 #include "matrix.h"
+#include "parallel_util.h"
+
+// BLUPs of coefficients (and SEs) at a single position
+//
+// Z         = genotype probabilities at this position (individuals x genotypes)
+// y         = vector of phenotypes
+// X         = additive covariates (must include intercept)
+// XpX       = X'X
+// logdetXpX = log det X'X
+// se        = If TRUE, calculate SEs
+// reml      = If TRUE, use REML to estimate variance components
+// tol       = Numeric tolerance
+// coef      = on output, the coefficients (genotypes then covariates)
+// SE        = on output, the SEs (if se=TRUE)
+//
+// The non-zero eigenvalues of ZZ' and the corresponding eigenvectors
+// are obtained from the thin SVD of Z. The remaining eigenvalues are
+// all 0, and for the LMM fit we need only the cross-products of y and
+// X in that orthogonal complement, which are replaced by at most
+// (1 + no. covariates) rows that have the same cross-products. This
+// takes O(n_ind * n_gen^2) rather than O(n_ind^3).
+static void scanblup_onepos(const MatrixXd& Z, const VectorXd& y, const MatrixXd& X,
+                            const MatrixXd& XpX, const double logdetXpX,
+                            const bool se, const bool reml, const double tol,
+                            double *coef, double *SE)
+{
+    const int n_ind = Z.rows();
+    const int n_gen = Z.cols();
+    const int n_addcovar = X.cols();
+    const int n_coef = n_gen + n_addcovar;
+
+    // thin SVD of Z
+    JacobiSVD<MatrixXd> svd(Z, ComputeThinU | ComputeThinV);
+    svd.setThreshold(tol);
+    const int rank = svd.rank();
+    const MatrixXd U = svd.matrixU().leftCols(rank);
+    const MatrixXd V = svd.matrixV().leftCols(rank);
+    const VectorXd s = svd.singularValues().head(rank);
+
+    // phenotype and covariates, rotated into the column space of Z
+    MatrixXd yX(n_ind, n_addcovar+1);
+    yX.col(0) = y;
+    yX.rightCols(n_addcovar) = X;
+    const MatrixXd UpyX = U.transpose() * yX;
+
+    // cross-products in the orthogonal complement
+    const MatrixXd yX_resid = yX - U * UpyX;
+    const std::pair<VectorXd, MatrixXd> e = eigen_decomp(calc_XpX(yX_resid));
+    const int n_comp = std::min(n_ind - rank, n_addcovar+1);
+
+    // eigenvalues and rotated y and X, padded with 0's to n_ind rows
+    VectorXd Kva = VectorXd::Zero(n_ind);
+    MatrixXd yXrot = MatrixXd::Zero(n_ind, n_addcovar+1);
+    Kva.head(rank) = s.array().square().matrix();
+    yXrot.topRows(rank) = UpyX;
+    for(int i=0; i<n_comp; i++) { // eigenvalues in increasing order; take the largest
+        const int j = n_addcovar - i;
+        if(e.first[j] > 0.0) yXrot.row(rank+i) = sqrt(e.first[j]) * e.second.row(j);
+    }
+    const VectorXd yrot = yXrot.col(0);
+    const MatrixXd Xrot = yXrot.rightCols(n_addcovar);
+
+    // fit LMM
+    struct lmm_fit lmm_out = fitLMM(Kva, yrot, Xrot, reml, true, logdetXpX, tol);
+
+    // calculate BLUPs; only the column space of Z contributes
+    VectorXd resid = yrot.head(rank) - Xrot.topRows(rank) * lmm_out.beta;
+    for(int i=0; i<rank; i++) // multiply by weights
+        resid[i] *= lmm_out.hsq/(lmm_out.hsq * Kva[i] + (1.0-lmm_out.hsq));
+    const VectorXd blup = V * (s.cwiseProduct(resid)); // Z'U = V S
+
+    // insert estimated coefficients
+    for(int i=0; i<n_gen; i++) coef[i] = blup[i];
+    for(int i=0; i<n_addcovar; i++) coef[n_gen+i] = lmm_out.beta[i];
+
+    if(se) { // get SEs
+        // construct variance matrix, [Z X]'[Z X]/(1-hsq) + 1/hsq on Z diagonal
+        MatrixXd Vinv(n_coef, n_coef);
+        Vinv.topLeftCorner(n_gen, n_gen) = V * s.array().square().matrix().asDiagonal() * V.transpose();
+        Vinv.topRightCorner(n_gen, n_addcovar) = Z.transpose() * X;
+        Vinv.bottomLeftCorner(n_addcovar, n_gen) = Vinv.topRightCorner(n_gen, n_addcovar).transpose();
+        Vinv.bottomRightCorner(n_addcovar, n_addcovar) = XpX;
+        Vinv /= (1.0-lmm_out.hsq);
+        for(int i=0; i<n_gen; i++) Vinv(i,i) += 1.0/lmm_out.hsq;
+
+        // sigma^2 * (Vinv)^(-1)
+        const MatrixXd Vmat = Vinv.inverse()*lmm_out.sigmasq;
+
+        // insert estimated SEs
+        for(int i=0; i<n_coef; i++) SE[i] = sqrt(Vmat(i,i));
+    }
+}
 
 // Scan a single chromosome to get BLUPs of coefficients
 //
@@ -21,8 +115,9 @@ using namespace Eigen;
 // reml      = If TRUE, use REML to estimate variance components; otherwise use maximum
 //             likelihood
 // tol       = Numeric tolerance
+// n_threads = number of threads to use (over positions)
 //
-// output    = List with twomatrix of coefficients (genotypes x positions)
+// output    = List with two matrices, of coefficients and SEs (each coefficients x positions)
 //
 // [[Rcpp::export]]
 List scanblup(const NumericVector& genoprobs,
@@ -30,7 +125,8 @@ List scanblup(const NumericVector& genoprobs,
               const NumericMatrix& addcovar,
               const bool se,
               const bool reml,
-              const double tol=1e-12)
+              const double tol=1e-12,
+              const int n_threads=1)
 {
     const int n_ind = pheno.size();
     if(Rf_isNull(genoprobs.attr("dim")))
@@ -46,53 +142,23 @@ List scanblup(const NumericVector& genoprobs,
     NumericMatrix coef(n_coef, n_pos); // to contain the estimated coefficients
     NumericMatrix SE(n_coef, n_pos); // to contain the estimated SEs
 
-    for(int pos=0; pos < n_pos; pos++) { // loop over positions
-        Rcpp::checkUserInterrupt();  // check for ^C from user
-
-        // calculate ZZ' with Z = genoprobs for this position
-        MatrixXd Z(n_ind, n_gen);
-        std::copy(genoprobs.begin() + x_size*pos, genoprobs.begin() + x_size*(pos+1),
-                  Z.data());
-        MatrixXd ZZp = calc_XpX(Z.transpose());
-
-        // get eigen decomposition
-        std::pair<VectorXd, MatrixXd> ZZp_decomp = eigen_decomp(ZZp);
-
-        // rotate pheno and X
-        VectorXd ph(as <Map<VectorXd> >(pheno));
-        MatrixXd ac(as <Map<MatrixXd> >(addcovar));
-        VectorXd y = ZZp_decomp.second * ph; // D'y
-        MatrixXd X = ZZp_decomp.second * ac; // D'X
-
-        // fit LMM
-        struct lmm_fit lmm_out = fitLMM(ZZp_decomp.first, y, X, reml, true, NA_REAL, tol);
-
-        // calculate BLUPs
-        VectorXd resid = y - X * lmm_out.beta;
-        for(int i=0; i<n_ind; i++) // multiply by weights
-            resid[i] *= lmm_out.hsq/(lmm_out.hsq * ZZp_decomp.first[i] + (1.0-lmm_out.hsq));
-        Z = ZZp_decomp.second * Z;
-        VectorXd blup = Z.transpose() * resid;
-
-        // insert estimated coefficients
-        for(int i=0; i<n_gen; i++) coef(i,pos) = blup[i];
-        for(int i=0; i<n_addcovar; i++) coef(n_gen+i,pos) = lmm_out.beta[i];
-
-        if(se) { // get SEs
-            // construct variance matrix
-            MatrixXd ZX(n_ind, n_gen+n_addcovar);
-            for(int i=0; i<n_gen; i++) ZX.col(i) = Z.col(i);
-            for(int i=0; i<n_addcovar; i++) ZX.col(i+n_gen) = ac.col(i);
-            MatrixXd Vinv = calc_XpX(ZX)/(1.0-lmm_out.hsq);
-            for(int i=0; i<n_gen; i++) Vinv(i,i) += 1.0/lmm_out.hsq;
-
-            // sigma^2 * (Vinv)^(-1)
-            MatrixXd V = Vinv.inverse()*lmm_out.sigmasq;
-
-            // insert estimated SEs
-            for(int i=0; i<n_coef; i++) SE(i,pos) = sqrt(V(i,i));
-        }
-    }
+    const VectorXd ph(as <Map<VectorXd> >(pheno));
+    const MatrixXd ac(as <Map<MatrixXd> >(addcovar));
+
+    // X'X and log det X'X are the same at all positions
+    const MatrixXd XpX = calc_XpX(ac);
+    const double logdetXpX = calc_logdetXpX(ac);
+
+    const double *pr = REAL(genoprobs);
+    double *coef_ptr = REAL(coef);
+    double *SE_ptr = REAL(SE);
+
+    parallel_for(n_pos, n_threads, [&](const int pos, const int thread) {
+        const MatrixXd Z = Map<const MatrixXd>(pr + x_size*pos, n_ind, n_gen);
+
+        scanblup_onepos(Z, ph, ac, XpX, logdetXpX, se, reml, tol,
+                        coef_ptr + n_coef*pos, SE_ptr + n_coef*pos);
+    });
 
     return List::create(Named("coef") = coef,
                         Named("SE") = SE);
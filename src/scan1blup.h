@@ -14,6 +14,7 @@
 // reml      = If TRUE, use REML to estimate variance components; otherwise use maximum
 //             likelihood
 // tol       = Numeric tolerance
+// n_threads = number of threads to use (over positions)
 //
 // output    = List with two matrices, of coefficients and SEs (each coefficients x positions)
 Rcpp::List scanblup(const Rcpp::NumericVector& genoprobs,
@@ -21,6 +22,7 @@ Rcpp::List scanblup(const Rcpp::NumericVector& genoprobs,
                     const Rcpp::NumericMatrix& addcovar,
                     const bool se,
                     const bool reml,
-                    const double tol);
+                    const double tol,
+                    const int n_threads);
 
 #endif // SCAN1BLUP_H
@@ -0,0 +1,218 @@
+// precomputed QR decompositions of genotype probabilities + covariates,
+// for Haley-Knott regression with many phenotypes
+
+#include "scan1prep.h"
+#include <RcppEigen.h>
+#include <math.h>
+
+using namespace Rcpp;
+using namespace Eigen;
+
+#include "parallel_util.h"
+
+// QR decomposition at each position on a chromosome
+//
+// genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
+//             if weights, already multiplied by weights (really sqrt of original weights)
+// addcovar  = additive covariates (no intercept; the genotype columns span it)
+//             if weights, already multiplied by weights
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = list with Q (individuals x coefficients x positions; the
+//             columns beyond the rank are 0), R (coefficients x
+//             coefficients x positions; also 0 beyond the rank),
+//             pivot (coefficients x positions; 0-based column indices,
+//             in the order of the columns of Q), and rank (length positions)
+//
+// [[Rcpp::export]]
+List prep_hk_onechr(const NumericVector& genoprobs,
+                    const NumericMatrix& addcovar,
+                    const double tol=1e-12,
+                    const int n_threads=1)
+{
+    if(Rf_isNull(genoprobs.attr("dim")))
+        throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
+    const Dimension d = genoprobs.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("genoprobs should be a 3d array");
+    const int n_ind = d[0];
+    const int n_gen = d[1];
+    const int n_pos = d[2];
+    const int n_addcovar = addcovar.cols();
+    const int n_coef = n_gen + n_addcovar;
+    const size_t x_size = (size_t)n_ind * n_gen;
+    if(n_ind != addcovar.rows())
+        throw std::range_error("nrow(genoprobs) != nrow(addcovar)");
+    if(n_coef > n_ind)
+        throw std::invalid_argument("more coefficients than individuals");
+
+    NumericVector Q((size_t)n_ind * n_coef * n_pos);
+    Q.attr("dim") = Dimension(n_ind, n_coef, n_pos);
+    NumericVector R((size_t)n_coef * n_coef * n_pos);
+    R.attr("dim") = Dimension(n_coef, n_coef, n_pos);
+    IntegerMatrix pivot(n_coef, n_pos);
+    IntegerVector rank(n_pos);
+
+    const double *pr = REAL(genoprobs);
+    double *Q_ptr = REAL(Q);
+    double *R_ptr = REAL(R);
+    int *pivot_ptr = INTEGER(pivot);
+    int *rank_ptr = INTEGER(rank);
+    const Map<const MatrixXd> ac(REAL(addcovar), n_ind, n_addcovar);
+
+    parallel_for(n_pos, n_threads, [&](const int pos, const int thread) {
+        MatrixXd X(n_ind, n_coef);
+        X.leftCols(n_gen) = Map<const MatrixXd>(pr + x_size*pos, n_ind, n_gen);
+        X.rightCols(n_addcovar) = ac;
+
+        ColPivHouseholderQR<MatrixXd> PQR(X);
+        PQR.setThreshold(tol);
+        const int r = PQR.rank();
+
+        Map<MatrixXd> Qpos(Q_ptr + (size_t)n_ind*n_coef*pos, n_ind, n_coef);
+        Qpos.setZero();
+        Qpos.leftCols(r) = PQR.householderQ() * MatrixXd::Identity(n_ind, r);
+
+        Map<MatrixXd> Rpos(R_ptr + (size_t)n_coef*n_coef*pos, n_coef, n_coef);
+        Rpos.setZero();
+        Rpos.topLeftCorner(r, r) = PQR.matrixQR().topLeftCorner(r, r).triangularView<Upper>();
+
+        const VectorXi& ind = PQR.colsPermutation().indices();
+        for(int j=0; j<n_coef; j++) pivot_ptr[(size_t)n_coef*pos + j] = ind[j];
+        rank_ptr[pos] = r;
+    });
+
+    return List::create(Named("Q") = Q,
+                        Named("R") = R,
+                        Named("pivot") = pivot,
+                        Named("rank") = rank);
+}
+
+// Genome scan with precomputed QR decompositions
+//
+// Q         = 3d array (individuals x coefficients x positions) from prep_hk_onechr()
+// pheno     = matrix of phenotypes (individuals x phenotypes), already
+//             multiplied by weights and with covariates projected out
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (phenotypes x positions)
+//
+// Because the covariates are in the column space of Q, the RSS is
+// |y|^2 - |Q'y|^2 with y the residuals from the null model; if that
+// is small relative to |y|^2, it's recalculated directly as |y - QQ'y|^2
+//
+// [[Rcpp::export]]
+NumericMatrix scan_hk_prepped(const NumericVector& Q,
+                              const NumericMatrix& pheno,
+                              const int n_threads=1)
+{
+    if(Rf_isNull(Q.attr("dim")))
+        throw std::invalid_argument("Q should be a 3d array but has no dim attribute");
+    const Dimension d = Q.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("Q should be a 3d array");
+    const int n_ind = d[0];
+    const int n_coef = d[1];
+    const int n_pos = d[2];
+    const int n_phe = pheno.cols();
+    if(n_ind != pheno.rows())
+        throw std::range_error("nrow(pheno) != nrow(Q)");
+
+    NumericMatrix result(n_phe, n_pos);
+
+    const Map<const MatrixXd> Y(REAL(pheno), n_ind, n_phe);
+    const VectorXd yss = Y.colwise().squaredNorm().transpose();
+    const double *Q_ptr = REAL(Q);
+    double *result_ptr = REAL(result);
+    const double cancel_tol = 1e-6;
+
+    parallel_for(n_pos, n_threads, [&](const int pos, const int thread) {
+        const Map<const MatrixXd> Qpos(Q_ptr + (size_t)n_ind*n_coef*pos, n_ind, n_coef);
+        const MatrixXd QpY = Qpos.transpose() * Y;
+
+        double *rss = result_ptr + (size_t)n_phe*pos;
+        for(int j=0; j<n_phe; j++) {
+            rss[j] = yss[j] - QpY.col(j).squaredNorm();
+            if(rss[j] < cancel_tol * yss[j])
+                rss[j] = (Y.col(j) - Qpos * QpY.col(j)).squaredNorm();
+        }
+    });
+
+    return result;
+}
+
+// Coefficients (and optionally SEs) with precomputed QR decompositions
+//
+// Q         = 3d array (individuals x coefficients x positions) from prep_hk_onechr()
+// R         = 3d array (coefficients x coefficients x positions)
+// pivot     = matrix of 0-based column indices (coefficients x positions)
+// rank      = vector of ranks (length positions)
+// pheno     = vector of phenotypes, already multiplied by weights
+// se        = If TRUE, calculate SEs
+//
+// output    = list with matrices of coefficients and SEs (each coefficients x positions)
+//             (NA for linearly dependent columns)
+//
+// [[Rcpp::export]]
+List scancoef_hk_prepped(const NumericVector& Q,
+                         const NumericVector& R,
+                         const IntegerMatrix& pivot,
+                         const IntegerVector& rank,
+                         const NumericVector& pheno,
+                         const bool se=false)
+{
+    if(Rf_isNull(Q.attr("dim")))
+        throw std::invalid_argument("Q should be a 3d array but has no dim attribute");
+    const Dimension d = Q.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("Q should be a 3d array");
+    const int n_ind = d[0];
+    const int n_coef = d[1];
+    const int n_pos = d[2];
+    if(n_ind != pheno.size())
+        throw std::range_error("length(pheno) != nrow(Q)");
+    if((size_t)R.size() != (size_t)n_coef*n_coef*n_pos)
+        throw std::range_error("R and Q have incompatible dimensions");
+    if(pivot.rows() != n_coef || pivot.cols() != n_pos)
+        throw std::range_error("pivot and Q have incompatible dimensions");
+    if(rank.size() != n_pos)
+        throw std::range_error("length(rank) != number of positions");
+
+    NumericMatrix coef(n_coef, n_pos);
+    NumericMatrix SE(n_coef, n_pos);
+    std::fill(coef.begin(), coef.end(), NA_REAL);
+    std::fill(SE.begin(), SE.end(), NA_REAL);
+
+    const VectorXd y(as<Map<VectorXd> >(pheno));
+    const double yss = y.squaredNorm();
+
+    for(int pos=0; pos<n_pos; pos++) {
+        Rcpp::checkUserInterrupt();  // check for ^C from user
+
+        const int r = rank[pos];
+        const Map<const MatrixXd> Qpos(REAL(Q) + (size_t)n_ind*n_coef*pos, n_ind, r);
+        const Map<const MatrixXd> Rpos(REAL(R) + (size_t)n_coef*n_coef*pos, n_coef, n_coef);
+
+        const VectorXd effects = Qpos.transpose() * y;
+        const MatrixXd Rinv = Rpos.topLeftCorner(r, r).triangularView<Upper>().
+            solve(MatrixXd::Identity(r, r));
+        const VectorXd betahat = Rinv * effects;
+
+        double sigma = 0.0;
+        if(se) {
+            double rss = yss - effects.squaredNorm();
+            if(rss < 1e-6 * yss) rss = (y - Qpos * effects).squaredNorm();
+            sigma = sqrt( rss / (double)(n_ind - r) );
+        }
+
+        for(int j=0; j<r; j++) {
+            const int k = pivot(j, pos);
+            coef(k, pos) = betahat[j];
+            if(se) SE(k, pos) = sigma * Rinv.row(j).norm();
+        }
+    }
+
+    return List::create(Named("coef") = coef,
+                        Named("SE") = SE);
+}
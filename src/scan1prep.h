@@ -0,0 +1,57 @@
+// precomputed QR decompositions of genotype probabilities + covariates,
+// for Haley-Knott regression with many phenotypes
+#ifndef SCAN1PREP_H
+#define SCAN1PREP_H
+
+#include <Rcpp.h>
+
+// QR decomposition at each position on a chromosome
+//
+// genoprobs = 3d array of genotype probabilities (individuals x genotypes x positions)
+//             if weights, already multiplied by weights (really sqrt of original weights)
+// addcovar  = additive covariates (no intercept; the genotype columns span it)
+//             if weights, already multiplied by weights
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = list with Q (individuals x coefficients x positions; the
+//             columns beyond the rank are 0), R (coefficients x
+//             coefficients x positions; also 0 beyond the rank),
+//             pivot (coefficients x positions; 0-based column indices,
+//             in the order of the columns of Q), and rank (length positions)
+Rcpp::List prep_hk_onechr(const Rcpp::NumericVector& genoprobs,
+                          const Rcpp::NumericMatrix& addcovar,
+                          const double tol,
+                          const int n_threads);
+
+// Genome scan with precomputed QR decompositions
+//
+// Q         = 3d array (individuals x coefficients x positions) from prep_hk_onechr()
+// pheno     = matrix of phenotypes (individuals x phenotypes), already
+//             multiplied by weights and with covariates projected out
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (phenotypes x positions)
+Rcpp::NumericMatrix scan_hk_prepped(const Rcpp::NumericVector& Q,
+                                    const Rcpp::NumericMatrix& pheno,
+                                    const int n_threads);
+
+// Coefficients (and optionally SEs) with precomputed QR decompositions
+//
+// Q         = 3d array (individuals x coefficients x positions) from prep_hk_onechr()
+// R         = 3d array (coefficients x coefficients x positions)
+// pivot     = matrix of 0-based column indices (coefficients x positions)
+// rank      = vector of ranks (length positions)
+// pheno     = vector of phenotypes, already multiplied by weights
+// se        = If TRUE, calculate SEs
+//
+// output    = list with matrices of coefficients and SEs (each coefficients x positions)
+//             (NA for linearly dependent columns)
+Rcpp::List scancoef_hk_prepped(const Rcpp::NumericVector& Q,
+                               const Rcpp::NumericVector& R,
+                               const Rcpp::IntegerMatrix& pivot,
+                               const Rcpp::IntegerVector& rank,
+                               const Rcpp::NumericVector& pheno,
+                               const bool se);
+
+#endif // SCAN1PREP_H
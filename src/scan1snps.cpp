@@ -0,0 +1,105 @@
+// SNP association scan by Haley-Knott regression, forming the SNP probabilities on the fly
+
+#include "scan1snps.h"
+#include <RcppEigen.h>
+
+using namespace Rcpp;
+using namespace Eigen;
+
+#include "snpprobs.h"
+#include "parallel_util.h"
+
+// Scan a set of SNPs on a single chromosome
+//
+// genoprobs = 3d array of genotype or allele probabilities (individuals x genotypes x positions)
+//             with additive covariates already regressed out
+//             (and multiplied by weights, if any)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed), with additive covariates regressed out
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over SNPs)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x snps)
+//
+// The SNP genotype probabilities are sums of columns of genoprobs (or
+// averages across the two ends of an interval), so regressing out the
+// covariates from genoprobs is the same as regressing them out from
+// the SNP probabilities. Each SNP's probabilities are formed in a
+// small workspace and then dropped, rather than forming the whole
+// individuals x SNP genotypes x SNPs array as in genoprob_to_snpprob().
+// As in scan1(), the first SNP genotype column is omitted.
+//
+// [[Rcpp::export]]
+NumericMatrix scan_hk_snps(const NumericVector& genoprobs,
+                           const NumericMatrix& pheno,
+                           const IntegerVector& sdp,
+                           const IntegerVector& interval,
+                           const LogicalVector& on_map,
+                           const int prob_type,
+                           const double tol=1e-12,
+                           const int n_threads=1)
+{
+    if(Rf_isNull(genoprobs.attr("dim")))
+        throw std::invalid_argument("genoprobs should be a 3d array but has no dim attribute");
+    const Dimension d = genoprobs.attr("dim");
+    if(d.size() != 3)
+        throw std::invalid_argument("genoprobs should be a 3d array");
+    const int n_ind = d[0];
+    const int n_gen = d[1];
+    const int n_pos = d[2];
+    const int n_phe = pheno.cols();
+    const int n_snp = sdp.size();
+    if(n_ind != pheno.rows())
+        throw std::range_error("nrow(pheno) != nrow(genoprobs)");
+
+    int n_str, n_snpgen;
+    snpprob_dims(n_gen, n_pos, sdp, interval, on_map, prob_type, n_str, n_snpgen);
+
+    // genotype column -> SNP genotype column, for each SNP
+    // (formed here, as the worker threads can't allocate R objects)
+    const std::vector<int> snpcol = snpcol_table(n_gen, n_str, sdp, prob_type);
+
+    NumericMatrix result(n_phe, n_snp);
+
+    const Map<const MatrixXd> Y(REAL(pheno), n_ind, n_phe);
+    const VectorXd yy = Y.colwise().squaredNorm().transpose();
+    const double *pr = REAL(genoprobs);
+    const size_t x_size = (size_t)n_ind * n_gen;
+    const double cancel_tol = 1e-6;
+    double *res = REAL(result);
+
+    parallel_for(n_snp, n_threads, [&](const int snp, const int thread) {
+        // form the SNP genotype probabilities
+        MatrixXd X = MatrixXd::Zero(n_ind, n_snpgen);
+        const Map<const MatrixXd> P(pr + x_size*interval[snp], n_ind, n_gen);
+        const int *col = snpcol.data() + (size_t)snp*n_gen;
+        if(on_map[snp]) {
+            for(int g=0; g<n_gen; g++) X.col(col[g]) += P.col(g);
+        }
+        else {
+            const Map<const MatrixXd> Pnext(pr + x_size*(interval[snp]+1), n_ind, n_gen);
+            for(int g=0; g<n_gen; g++) X.col(col[g]) += (P.col(g) + Pnext.col(g))/2.0;
+        }
+
+        // orthonormal basis for all but the first column
+        ColPivHouseholderQR<MatrixXd> PQR(X.rightCols(n_snpgen-1));
+        PQR.setThreshold(tol);
+        const int r = PQR.rank();
+        const MatrixXd Q = PQR.householderQ() * MatrixXd::Identity(n_ind, r);
+
+        const MatrixXd QtY = Q.transpose() * Y;
+        for(int j=0; j<n_phe; j++) {
+            double rss = yy[j] - QtY.col(j).squaredNorm();
+            if(rss < cancel_tol * yy[j])
+                rss = (Y.col(j) - Q * QtY.col(j)).squaredNorm();
+            res[j + (size_t)snp*n_phe] = rss;
+        }
+    });
+
+    return result;
+}
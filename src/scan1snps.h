@@ -0,0 +1,32 @@
+// SNP association scan by Haley-Knott regression, forming the SNP probabilities on the fly
+#ifndef SCAN1SNPS_H
+#define SCAN1SNPS_H
+
+#include <Rcpp.h>
+
+// Scan a set of SNPs on a single chromosome
+//
+// genoprobs = 3d array of genotype or allele probabilities (individuals x genotypes x positions)
+//             with additive covariates already regressed out
+//             (and multiplied by weights, if any)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed), with additive covariates regressed out
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over SNPs)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x snps)
+Rcpp::NumericMatrix scan_hk_snps(const Rcpp::NumericVector& genoprobs,
+                                 const Rcpp::NumericMatrix& pheno,
+                                 const Rcpp::IntegerVector& sdp,
+                                 const Rcpp::IntegerVector& interval,
+                                 const Rcpp::LogicalVector& on_map,
+                                 const int prob_type,
+                                 const double tol,
+                                 const int n_threads);
+
+#endif // SCAN1SNPS_H
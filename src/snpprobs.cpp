@@ -2,6 +2,9 @@
 
 #include "snpprobs.h"
 #include <exception>
+#include <vector>
+#include <algorithm>
+#include <math.h>
 #include <Rcpp.h>
 using namespace Rcpp;
 
@@ -77,28 +80,14 @@ NumericVector alleleprob_to_snpprob(const NumericVector& alleleprob,
     if(d.size() != 3)
         throw std::invalid_argument("alleleprob should be a 3d array");
     const int n_ind = d[0];
-    const int n_str = d[1];
     const int n_pos = d[2];
     const int n_snp = sdp.size();
-    if(n_snp != interval.size())
-        throw std::invalid_argument("length(sdp) != length(interval)");
-    if(n_snp != on_map.size())
-        throw std::invalid_argument("length(sdp) != length(on_map)");
-    if(n_str < 3) // not meaningful for <3 strains
-        throw std::invalid_argument("meaningful only with >= 3 strains");
+    int n_str, n_snpgen;
+    snpprob_dims(d[1], n_pos, sdp, interval, on_map, 0, n_str, n_snpgen);
 
     NumericVector result(n_ind*2*n_snp);
     result.attr("dim") = Dimension(n_ind, 2, n_snp);
 
-    // check that the interval and SDP values are okay
-    for(int i=0; i<n_snp; i++) {
-        if(interval[i] < 0 || interval[i] > n_pos-1 ||
-           (interval[i] == n_pos-1 && !on_map[i]))
-            throw std::invalid_argument("snp outside of map range");
-        if(sdp[i] < 1 || sdp[i] > (1 << n_str)-1)
-            throw std::invalid_argument("SDP out of range");
-    }
-
     for(int snp=0; snp<n_snp; snp++) {
         for(int strain=0; strain < n_str; strain++) {
 
@@ -181,30 +170,14 @@ NumericVector genoprob_to_snpprob(const NumericVector& genoprob,
         throw std::invalid_argument("genoprob should be a 3d array");
     const int n_ind = d[0];
     const int n_gen = d[1];
-    const int n_str = (sqrt(8.0*(double)n_gen + 1.0) - 1.0)/2.0;
-    if(n_gen != n_str*(n_str+1)/2)
-        throw std::invalid_argument("n_gen must == n(n+1)/2 for some n");
     const int n_pos = d[2];
     const int n_snp = sdp.size();
-    if(n_snp != interval.size())
-        throw std::invalid_argument("length(sdp) != length(interval)");
-    if(n_snp != on_map.size())
-        throw std::invalid_argument("length(sdp) != length(on_map)");
-    if(n_str < 3) // not meaningful for <3 strains
-        throw std::invalid_argument("meaningful only with >= 3 strains");
+    int n_str, n_snpgen;
+    snpprob_dims(n_gen, n_pos, sdp, interval, on_map, 1, n_str, n_snpgen);
 
     NumericVector result(n_ind*3*n_snp); // 3 is the number of SNP genotypes (AA,AB,BB)
     result.attr("dim") = Dimension(n_ind, 3, n_snp);
 
-    // check that the interval and SDP values are okay
-    for(int i=0; i<n_snp; i++) {
-        if(interval[i] < 0 || interval[i] > n_pos-1 ||
-           (interval[i] == n_pos-1 && !on_map[i]))
-            throw std::invalid_argument("snp outside of map range");
-        if(sdp[i] < 1 || sdp[i] > (1 << n_str)-1)
-            throw std::invalid_argument("SDP out of range");
-    }
-
     for(int snp=0; snp<n_snp; snp++) {
         IntegerVector snpcol = genocol_to_snpcol(n_str, sdp[snp]);
 
@@ -293,30 +266,14 @@ NumericVector Xgenoprob_to_snpprob(const NumericVector& genoprob,
         throw std::invalid_argument("genoprob should be a 3d array");
     const int n_ind = d[0];
     const int n_gen = d[1];
-    const int n_str = (sqrt(8.0*(double)n_gen + 9.0) - 3.0)/2.0;
-    if(n_gen != n_str*(n_str+1)/2 + n_str)
-        throw std::invalid_argument("n_gen must == n + n(n+1)/2 for some n");
     const int n_pos = d[2];
     const int n_snp = sdp.size();
-    if(n_snp != interval.size())
-        throw std::invalid_argument("length(sdp) != length(interval)");
-    if(n_snp != on_map.size())
-        throw std::invalid_argument("length(sdp) != length(on_map)");
-    if(n_str < 3) // not meaningful for <3 strains
-        throw std::invalid_argument("meaningful only with >= 3 strains");
+    int n_str, n_snpgen;
+    snpprob_dims(n_gen, n_pos, sdp, interval, on_map, 2, n_str, n_snpgen);
 
     NumericVector result(n_ind*5*n_snp); // 5 is the number of SNP genotypes (AA,AB,BB,AY,BY)
     result.attr("dim") = Dimension(n_ind, 5, n_snp);
 
-    // check that the interval and SDP values are okay
-    for(int i=0; i<n_snp; i++) {
-        if(interval[i] < 0 || interval[i] > n_pos-1 ||
-           (interval[i] == n_pos-1 && !on_map[i]))
-            throw std::invalid_argument("snp outside of map range");
-        if(sdp[i] < 1 || sdp[i] > (1 << n_str)-1)
-            throw std::invalid_argument("SDP out of range");
-    }
-
     for(int snp=0; snp<n_snp; snp++) {
         IntegerVector snpcol = Xgenocol_to_snpcol(n_str, sdp[snp]);
 
@@ -338,3 +295,90 @@ NumericVector Xgenoprob_to_snpprob(const NumericVector& genoprob,
 
     return result;
 }
+
+// number of strains and SNP genotypes, for converting genotype or
+// allele probabilities to SNP probabilities, with checks of the
+// SNP information
+//
+// n_gen     = number of genotype (or allele) columns
+// n_pos     = number of positions
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = n_str (number of strains) and n_snpgen (number of SNP genotypes)
+void snpprob_dims(const int n_gen, const int n_pos,
+                  const IntegerVector& sdp,
+                  const IntegerVector& interval,
+                  const LogicalVector& on_map,
+                  const int prob_type,
+                  int& n_str, int& n_snpgen)
+{
+    const int n_snp = sdp.size();
+    if(n_snp != interval.size())
+        throw std::invalid_argument("length(sdp) != length(interval)");
+    if(n_snp != on_map.size())
+        throw std::invalid_argument("length(sdp) != length(on_map)");
+
+    if(prob_type == 0) {
+        n_str = n_gen;
+        n_snpgen = 2;
+    }
+    else if(prob_type == 1) {
+        n_str = (sqrt(8.0*(double)n_gen + 1.0) - 1.0)/2.0;
+        if(n_gen != n_str*(n_str+1)/2)
+            throw std::invalid_argument("n_gen must == n(n+1)/2 for some n");
+        n_snpgen = 3;
+    }
+    else if(prob_type == 2) {
+        n_str = (sqrt(8.0*(double)n_gen + 9.0) - 3.0)/2.0;
+        if(n_gen != n_str*(n_str+1)/2 + n_str)
+            throw std::invalid_argument("n_gen must == n + n(n+1)/2 for some n");
+        n_snpgen = 5;
+    }
+    else throw std::invalid_argument("prob_type should be 0, 1, or 2");
+    if(n_str < 3) // not meaningful for <3 strains
+        throw std::invalid_argument("meaningful only with >= 3 strains");
+
+    // check that the interval and SDP values are okay
+    for(int i=0; i<n_snp; i++) {
+        if(interval[i] < 0 || interval[i] > n_pos-1 ||
+           (interval[i] == n_pos-1 && !on_map[i]))
+            throw std::invalid_argument("snp outside of map range");
+        if(sdp[i] < 1 || sdp[i] > (1 << n_str)-1)
+            throw std::invalid_argument("SDP out of range");
+    }
+}
+
+// genotype column -> SNP genotype column, for each SNP
+//
+// n_gen     = number of genotype (or allele) columns
+// n_str     = number of strains
+// sdp       = vector of strain distribution patterns
+// prob_type = as in snpprob_dims()
+//
+// output    = vector of length n_gen*length(sdp); the columns for SNP i
+//             are at i*n_gen, ..., (i+1)*n_gen - 1
+std::vector<int> snpcol_table(const int n_gen, const int n_str,
+                              const IntegerVector& sdp,
+                              const int prob_type)
+{
+    const int n_snp = sdp.size();
+    std::vector<int> snpcol((size_t)n_gen * n_snp);
+
+    for(int snp=0; snp<n_snp; snp++) {
+        if(prob_type == 0) {
+            for(int g=0; g<n_gen; g++)
+                snpcol[g + (size_t)snp*n_gen] = ((sdp[snp] & (1 << g)) != 0);
+        }
+        else {
+            IntegerVector col = (prob_type==1) ? genocol_to_snpcol(n_str, sdp[snp]) :
+                Xgenocol_to_snpcol(n_str, sdp[snp]);
+            std::copy(col.begin(), col.end(), snpcol.begin() + (size_t)snp*n_gen);
+        }
+    }
+
+    return snpcol;
+}
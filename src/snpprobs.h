@@ -3,6 +3,7 @@
 #define SNPPROBS_H
 
 #include <Rcpp.h>
+#include <vector>
 
 // calculate strain distribution pattern (SDP) from
 // SNP genotypes for a set of strains
@@ -57,7 +58,7 @@ Rcpp::NumericVector genoprob_to_snpprob(const Rcpp::NumericVector& genoprob,
 // n_str     Number of strains
 //    (so n_str + n_str*(n_str+1)/2 columns)
 // sdp       Strain distribution pattern for SNP
-Rcpp::IntegerVector genocol_to_snpcol(const int n_str, const int sdp);
+Rcpp::IntegerVector Xgenocol_to_snpcol(const int n_str, const int sdp);
 
 // convert X chr genotype probabilities into SNP probabilities
 //
@@ -72,4 +73,32 @@ Rcpp::NumericVector Xgenoprob_to_snpprob(const Rcpp::NumericVector& genoprob,
                                          const Rcpp::IntegerVector& interval,
                                          const Rcpp::LogicalVector& on_map);
 
+// number of strains and SNP genotypes, for converting genotype or
+// allele probabilities to SNP probabilities, with checks of the
+// SNP information
+//
+// n_gen     = number of genotype (or allele) columns
+// n_pos     = number of positions
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = n_str (number of strains) and n_snpgen (number of SNP genotypes)
+void snpprob_dims(const int n_gen, const int n_pos,
+                  const Rcpp::IntegerVector& sdp,
+                  const Rcpp::IntegerVector& interval,
+                  const Rcpp::LogicalVector& on_map,
+                  const int prob_type,
+                  int& n_str, int& n_snpgen);
+
+// genotype column -> SNP genotype column, for each SNP
+//
+// output = vector of length n_gen*length(sdp); the columns for SNP i
+//          are at i*n_gen, ..., (i+1)*n_gen - 1
+std::vector<int> snpcol_table(const int n_gen, const int n_str,
+                              const Rcpp::IntegerVector& sdp,
+                              const int prob_type);
+
 #endif // SNPPROBS_H
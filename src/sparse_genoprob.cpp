@@ -0,0 +1,354 @@
+// sparse genotype probabilities (just the non-zero values at each individual x position)
+
+#include "sparse_genoprob.h"
+#include <RcppEigen.h>
+#include <math.h>
+#include <limits.h>
+#include <vector>
+#include <utility>
+
+using namespace Rcpp;
+using namespace Eigen;
+
+#include "cross.h"
+#include "parallel_util.h"
+#include "genoprob_kernels.h"
+
+// pointers into the sparse probabilities for one chromosome
+// (the list keeps the vectors alive, so they must not be coerced)
+SparseGenoprob::SparseGenoprob(const List& probs)
+{
+    if(!probs.containsElementNamed("p") || !probs.containsElementNamed("gen") ||
+       !probs.containsElementNamed("prob") || !probs.containsElementNamed("dim"))
+        throw std::invalid_argument("sparse probs should contain p, gen, prob, and dim");
+
+    SEXP p_sexp = probs["p"];
+    SEXP gen_sexp = probs["gen"];
+    SEXP prob_sexp = probs["prob"];
+    if(TYPEOF(p_sexp) != INTSXP || TYPEOF(gen_sexp) != INTSXP || TYPEOF(prob_sexp) != REALSXP)
+        throw std::invalid_argument("sparse probs should have integer p and gen and numeric prob");
+
+    const IntegerVector dim = probs["dim"];
+    if(dim.size() != 3)
+        throw std::invalid_argument("sparse probs dim should have length 3");
+    n_ind = dim[0];
+    n_gen = dim[1];
+    n_pos = dim[2];
+
+    if(Rf_xlength(p_sexp) != (R_xlen_t)n_ind*n_pos + 1)
+        throw std::invalid_argument("length(p) != n_ind*n_pos + 1");
+    if(Rf_xlength(gen_sexp) != Rf_xlength(prob_sexp))
+        throw std::invalid_argument("length(gen) != length(prob)");
+
+    p = INTEGER(p_sexp);
+    gen = INTEGER(gen_sexp);
+    prob = REAL(prob_sexp);
+
+    if(p[(size_t)n_ind*n_pos] != Rf_xlength(prob_sexp))
+        throw std::invalid_argument("p doesn't match length(prob)");
+}
+
+// sparse object as list
+static List sparse_list(const IntegerVector& p, const std::vector<int>& gen,
+                        const std::vector<double>& prob,
+                        const int n_ind, const int n_gen, const int n_pos)
+{
+    IntegerVector gen_r(gen.begin(), gen.end());
+    NumericVector prob_r(prob.begin(), prob.end());
+
+    return List::create(Named("p") = p,
+                        Named("gen") = gen_r,
+                        Named("prob") = prob_r,
+                        Named("dim") = IntegerVector::create(n_ind, n_gen, n_pos));
+}
+
+// convert dense genotype probabilities to sparse form,
+// dropping small values as in clean_genoprob()
+//
+// prob_array      = 3d array of genotype probabilities (individuals x genotypes x positions)
+// value_threshold = values below this are set to 0
+// column_threshold = genotype columns whose maximum (at a position) is below this are set to 0
+//
+// output          = list with p, gen, prob, and dim
+//
+// [[Rcpp::export(".sparsify_genoprob")]]
+List sparsify_genoprob(const NumericVector& prob_array,
+                       double value_threshold=1e-6,
+                       double column_threshold=0.01)
+{
+    if(Rf_isNull(prob_array.attr("dim")))
+        throw std::invalid_argument("prob_array should be a 3d array but has no dimension attribute");
+    const IntegerVector& dim = prob_array.attr("dim");
+    if(dim.size() != 3)
+        throw std::invalid_argument("prob_array should be a 3d array of probabilities");
+    const int n_ind = dim[0];
+    const int n_gen = dim[1];
+    const int n_pos = dim[2];
+
+    // ensure that we don't set all values in a row to 0
+    if(column_threshold > 1.0/(double)n_gen)
+        column_threshold = 0.5/(double)n_gen;
+    if(value_threshold > 1.0/(double)n_gen)
+        value_threshold = 0.5/(double)n_gen;
+
+    IntegerVector p((size_t)n_ind*n_pos + 1);
+    std::vector<int> gen;
+    std::vector<double> prob;
+    std::vector<bool> zero_column(n_gen);
+    std::vector<double> value(n_gen);
+
+    for(int pos=0; pos<n_pos; pos++) {
+        Rcpp::checkUserInterrupt();  // check for ^C from user
+
+        const double *pr = REAL(prob_array) + (size_t)n_ind*n_gen*pos;
+
+        // genotype columns whose largest value is < column_threshold
+        for(int g=0; g<n_gen; g++) {
+            zero_column[g] = true;
+            for(int ind=0; ind<n_ind; ind++) {
+                if(pr[ind + g*n_ind] >= column_threshold) {
+                    zero_column[g] = false;
+                    break;
+                }
+            }
+        }
+
+        for(int ind=0; ind<n_ind; ind++) {
+            double sum = 0.0;
+            for(int g=0; g<n_gen; g++) {
+                double v = pr[ind + g*n_ind];
+                if(zero_column[g] || v < value_threshold) v = 0.0;
+                sum += (value[g] = v);
+            }
+
+            for(int g=0; g<n_gen; g++) {
+                if(value[g] > 0.0) {
+                    gen.push_back(g);
+                    prob.push_back(value[g]/sum);
+                }
+            }
+            if(prob.size() > (size_t)INT_MAX)
+                throw std::range_error("too many non-zero probabilities; split the chromosome");
+            p[ind + (size_t)pos*n_ind + 1] = prob.size();
+        }
+    }
+
+    return sparse_list(p, gen, prob, n_ind, n_gen, n_pos);
+}
+
+// convert sparse genotype probabilities to a dense array (individuals x genotypes x positions)
+//
+// [[Rcpp::export(".densify_genoprob")]]
+NumericVector densify_genoprob(const List& probs)
+{
+    const SparseGenoprob pr(probs);
+    const int n_ind = pr.n_ind;
+    const int n_gen = pr.n_gen;
+    const int n_pos = pr.n_pos;
+
+    NumericVector result((size_t)n_ind*n_gen*n_pos);
+    result.attr("dim") = Dimension(n_ind, n_gen, n_pos);
+    double *res = REAL(result);
+
+    for(int pos=0; pos<n_pos; pos++) {
+        for(int ind=0; ind<n_ind; ind++) {
+            const size_t cell = ind + (size_t)pos*n_ind;
+            for(int k=pr.p[cell]; k<pr.p[cell+1]; k++)
+                res[ind + (size_t)pr.gen[k]*n_ind + (size_t)pos*n_ind*n_gen] = pr.prob[k];
+        }
+    }
+
+    return result;
+}
+
+// convert sparse genotype probabilities to sparse allele probabilities
+//
+// [[Rcpp::export(".sparse_genoprob_to_alleleprob")]]
+List sparse_genoprob_to_alleleprob(const String& crosstype,
+                                   const List& probs,
+                                   const bool is_x_chr)
+{
+    const SparseGenoprob pr(probs);
+    const int n_ind = pr.n_ind;
+    const int n_gen = pr.n_gen;
+    const int n_pos = pr.n_pos;
+
+    QTLCross* cross = QTLCross::Create(crosstype);
+    const NumericMatrix transform = cross->geno2allele_matrix(is_x_chr);
+    delete cross;
+
+    if(transform.cols() == 0) return probs; // no conversion needed
+    if((int)transform.rows() != n_gen)
+        throw std::invalid_argument("no. genotypes in probs doesn't match no. rows in transform matrix");
+    const int n_allele = transform.cols();
+
+    IntegerVector p((size_t)n_ind*n_pos + 1);
+    std::vector<int> gen;
+    std::vector<double> prob;
+    std::vector<double> value(n_allele);
+
+    for(int pos=0; pos<n_pos; pos++) {
+        Rcpp::checkUserInterrupt();  // check for ^C from user
+
+        for(int ind=0; ind<n_ind; ind++) {
+            const size_t cell = ind + (size_t)pos*n_ind;
+
+            std::fill(value.begin(), value.end(), 0.0);
+            for(int k=pr.p[cell]; k<pr.p[cell+1]; k++) {
+                for(int a=0; a<n_allele; a++)
+                    value[a] += pr.prob[k] * transform(pr.gen[k], a);
+            }
+
+            for(int a=0; a<n_allele; a++) {
+                if(value[a] > 0.0) {
+                    gen.push_back(a);
+                    prob.push_back(value[a]);
+                }
+            }
+            if(prob.size() > (size_t)INT_MAX)
+                throw std::range_error("too many non-zero probabilities; split the chromosome");
+            p[cell+1] = prob.size();
+        }
+    }
+
+    return sparse_list(p, gen, prob, n_ind, n_allele, n_pos);
+}
+
+// convert sparse genotype or allele probabilities to (dense) SNP probabilities
+//
+// probs     = sparse genotype or allele probabilities for one chromosome
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = 3d array individuals x SNP genotypes x SNPs
+//
+// [[Rcpp::export(".sparse_genoprob_to_snpprob")]]
+NumericVector sparse_genoprob_to_snpprob(const List& probs,
+                                         const IntegerVector& sdp,
+                                         const IntegerVector& interval,
+                                         const LogicalVector& on_map,
+                                         const int prob_type)
+{
+    const SparseGenoprob pr(probs);
+    return genoprob_to_snpprob_kernel(pr, sdp, interval, on_map, prob_type);
+}
+
+// calculate kinship matrix (unscaled) for each chromosome and their sum,
+// from sparse probabilities
+//
+// probs     = list of sparse probabilities, one per chromosome
+// bychr     = if false, just calculate the sum over chromosomes
+// n_threads = number of threads to use (over positions)
+//
+// output    = list with total (n_ind x n_ind) and bychr (list of n_ind x n_ind
+//             matrices, one per chromosome, or empty if bychr=false)
+//
+// At each position, the individuals are grouped by genotype, and each
+// pair of individuals with non-zero probability for a genotype
+// contributes the product of their probabilities. Each thread
+// accumulates the lower triangle in its own n_ind x n_ind workspace.
+//
+// [[Rcpp::export(".calc_kinship_sparse_bychr")]]
+List calc_kinship_sparse_bychr(const List& probs, const bool bychr=true, const int n_threads=1)
+{
+    const int n_chr = probs.size();
+    if(n_chr == 0)
+        throw std::invalid_argument("probs has length 0");
+
+    std::vector<SparseGenoprob> pr;
+    for(int chr=0; chr<n_chr; chr++) {
+        pr.push_back(SparseGenoprob(as<List>(probs[chr])));
+        if(pr[chr].n_ind != pr[0].n_ind)
+            throw std::invalid_argument("probs[[i]] should all have the same number of individuals");
+    }
+    const int n_ind = pr[0].n_ind;
+
+    NumericMatrix total(n_ind, n_ind);
+    List result_bychr(bychr ? n_chr : 0);
+
+    // workspace for each thread
+    std::vector< std::vector<double> > K(n_threads);
+    std::vector< std::vector< std::vector< std::pair<int,double> > > > by_gen(n_threads);
+    for(int thread=0; thread<n_threads; thread++)
+        K[thread].resize((size_t)n_ind*n_ind);
+
+    for(int chr=0; chr<n_chr; chr++) {
+        const SparseGenoprob& P = pr[chr];
+        for(int thread=0; thread<n_threads; thread++) {
+            std::fill(K[thread].begin(), K[thread].end(), 0.0);
+            by_gen[thread].resize(P.n_gen);
+        }
+
+        parallel_for(P.n_pos, n_threads, [&](const int pos, const int thread) {
+            std::vector< std::vector< std::pair<int,double> > >& bg = by_gen[thread];
+            for(int g=0; g<P.n_gen; g++) bg[g].clear();
+
+            const size_t cell0 = (size_t)pos*n_ind;
+            for(int ind=0; ind<n_ind; ind++) {
+                for(int k=P.p[cell0 + ind]; k<P.p[cell0 + ind + 1]; k++)
+                    bg[P.gen[k]].push_back(std::make_pair(ind, P.prob[k]));
+            }
+
+            // individuals are in increasing order, so this is the lower triangle
+            double *Kt = K[thread].data();
+            for(int g=0; g<P.n_gen; g++) {
+                const int n = bg[g].size();
+                for(int a=0; a<n; a++) {
+                    const int i = bg[g][a].first;
+                    const double pi = bg[g][a].second;
+                    for(int b=a; b<n; b++)
+                        Kt[bg[g][b].first + (size_t)i*n_ind] += pi * bg[g][b].second;
+                }
+            }
+        });
+
+        NumericMatrix Kchr(n_ind, n_ind);
+        for(int thread=0; thread<n_threads; thread++) {
+            for(int j=0; j<n_ind; j++)
+                for(int i=j; i<n_ind; i++)
+                    Kchr(i,j) += K[thread][i + (size_t)j*n_ind];
+        }
+        for(int j=0; j<n_ind; j++) {
+            for(int i=j; i<n_ind; i++) {
+                Kchr(j,i) = Kchr(i,j);
+                total(i,j) += Kchr(i,j);
+                if(i != j) total(j,i) = total(i,j);
+            }
+        }
+
+        if(bychr) result_bychr[chr] = Kchr;
+    }
+
+    return List::create(Named("total") = total,
+                        Named("bychr") = result_bychr);
+}
+
+// Scan a single chromosome with additive covariates, with sparse genotype probabilities
+//
+// genoprobs = sparse genotype probabilities for one chromosome
+//             (already subset to the individuals and genotype columns to use)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// weights   = vector of weights (really the SQUARE ROOT of the weights), or length 0
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
+//
+// See scan_hk_onechr_kernel() in genoprob_kernels.h.
+//
+// [[Rcpp::export]]
+NumericMatrix scan_hk_onechr_sparse(const List& genoprobs,
+                                    const NumericMatrix& pheno,
+                                    const NumericMatrix& addcovar,
+                                    const NumericVector& weights,
+                                    const double tol=1e-12,
+                                    const int n_threads=1)
+{
+    const SparseGenoprob pr(genoprobs);
+    return scan_hk_onechr_kernel(pr, pheno, addcovar, weights, tol, n_threads);
+}
@@ -0,0 +1,93 @@
+// sparse genotype probabilities (just the non-zero values at each individual x position)
+#ifndef SPARSE_GENOPROB_H
+#define SPARSE_GENOPROB_H
+
+#include <Rcpp.h>
+
+// pointers into the sparse probabilities for one chromosome
+// (a list with p, gen, prob, and dim; see R/sparse_genoprob.R)
+//
+// the entries for individual ind at position pos are
+// p[ind + pos*n_ind] ... p[ind + pos*n_ind + 1]-1
+// with 0-based genotype gen[] and probability prob[]
+struct SparseGenoprob {
+    int n_ind;
+    int n_gen;
+    int n_pos;
+    const int *p;
+    const int *gen;
+    const double *prob;
+
+    SparseGenoprob(const Rcpp::List& probs);
+
+    // call f(ind, gen, prob) for each non-zero probability at position pos
+    template<class F>
+    void visit(const int pos, F f) const
+    {
+        const int *pp = p + (size_t)pos*n_ind;
+        for(int ind=0; ind<n_ind; ind++)
+            for(int k=pp[ind]; k<pp[ind+1]; k++)
+                f(ind, gen[k], prob[k]);
+    }
+};
+
+// convert dense genotype probabilities to sparse form,
+// dropping small values as in clean_genoprob()
+//
+// prob_array      = 3d array of genotype probabilities (individuals x genotypes x positions)
+// value_threshold = values below this are set to 0
+// column_threshold = genotype columns whose maximum (at a position) is below this are set to 0
+//
+// output          = list with p, gen, prob, and dim
+Rcpp::List sparsify_genoprob(const Rcpp::NumericVector& prob_array,
+                             double value_threshold,
+                             double column_threshold);
+
+// convert sparse genotype probabilities to a dense array (individuals x genotypes x positions)
+Rcpp::NumericVector densify_genoprob(const Rcpp::List& probs);
+
+// convert sparse genotype probabilities to sparse allele probabilities
+Rcpp::List sparse_genoprob_to_alleleprob(const Rcpp::String& crosstype,
+                                         const Rcpp::List& probs,
+                                         const bool is_x_chr);
+
+// convert sparse genotype or allele probabilities to (dense) SNP probabilities
+//
+// probs     = sparse genotype or allele probabilities for one chromosome
+// sdp       = vector of strain distribution patterns
+// interval  = map interval containing snp
+// on_map    = logical vector indicating snp is at left endpoint of interval
+// prob_type = 0 for allele probabilities, 1 for autosomal genotype
+//             probabilities, 2 for X chromosome genotype probabilities
+//
+// output    = 3d array individuals x SNP genotypes x SNPs
+Rcpp::NumericVector sparse_genoprob_to_snpprob(const Rcpp::List& probs,
+                                               const Rcpp::IntegerVector& sdp,
+                                               const Rcpp::IntegerVector& interval,
+                                               const Rcpp::LogicalVector& on_map,
+                                               const int prob_type);
+
+// calculate kinship matrix (unscaled) for each chromosome and their sum,
+// from sparse probabilities (probs is a list of sparse probabilities, one per chromosome)
+Rcpp::List calc_kinship_sparse_bychr(const Rcpp::List& probs, const bool bychr, const int n_threads);
+
+// Scan a single chromosome with additive covariates, with sparse genotype probabilities
+//
+// genoprobs = sparse genotype probabilities for one chromosome
+//             (already subset to the individuals and genotype columns to use)
+// pheno     = matrix of numeric phenotypes (individuals x phenotypes)
+//             (no missing data allowed)
+// addcovar  = additive covariates (an intercept, at least)
+// weights   = vector of weights (really the SQUARE ROOT of the weights), or length 0
+// tol       = tolerance for determining linearly dependent columns
+// n_threads = number of threads to use (over positions)
+//
+// output    = matrix of residual sums of squares (RSS) (phenotypes x positions)
+Rcpp::NumericMatrix scan_hk_onechr_sparse(const Rcpp::List& genoprobs,
+                                          const Rcpp::NumericMatrix& pheno,
+                                          const Rcpp::NumericMatrix& addcovar,
+                                          const Rcpp::NumericVector& weights,
+                                          const double tol,
+                                          const int n_threads);
+
+#endif // SPARSE_GENOPROB_H
@@ -3,6 +3,7 @@
 #include "test_hmm.h"
 #include <Rcpp.h>
 #include "cross.h"
+#include "cross_dispatch.h"
 
 using namespace Rcpp;
 
@@ -134,8 +135,12 @@ std::vector<NumericMatrix> test_emitmatrix(const String& crosstype,
 {
     QTLCross* cross = QTLCross::Create(crosstype);
 
-    std::vector<Rcpp::NumericMatrix> result = cross->calc_emitmatrix(error_prob, max_obsgeno, founder_geno, is_x_chr, is_female, cross_info);
+    EmitMatrices emit_matrix = cross->calc_emitmatrix(error_prob, max_obsgeno, founder_geno, is_x_chr, is_female, cross_info);
     delete cross;
+
+    const int n_markers = emit_matrix.n_markers();
+    std::vector<Rcpp::NumericMatrix> result(n_markers);
+    for(int i=0; i<n_markers; i++) result[i] = emit_matrix.matrix(i);
     return result;
 }
 
@@ -165,3 +170,13 @@ NumericVector test_initvector(const String& crosstype,
     delete cross;
     return result;
 }
+
+// use the generic HMM kernels (with virtual calls), in place of those
+// specialized on the cross class; returns the previous setting
+// [[Rcpp::export]]
+bool test_generic_kernels(const bool use_generic)
+{
+    bool result = qtlcross_generic_kernels;
+    qtlcross_generic_kernels = use_generic;
+    return result;
+}
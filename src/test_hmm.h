@@ -55,4 +55,7 @@ std::vector<Rcpp::NumericMatrix> test_stepmatrix(const Rcpp::String& crosstype,
 Rcpp::NumericVector test_initvector(const Rcpp::String& crosstype,
                                     const bool is_x_chr, const bool is_female, const Rcpp::IntegerVector& cross_info);
 
+// use the generic HMM kernels, in place of those specialized on the cross class
+bool test_generic_kernels(const bool use_generic);
+
 #endif // TEST_HMM_H